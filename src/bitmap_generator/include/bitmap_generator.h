@@ -2,7 +2,9 @@
 #include <map>
 #include <unordered_map>
 #include <array>
+#include <cstdint>
 #include <ostream>
+#include "netz_bitmap.hpp"
 
 namespace bitmap_generator {
 
@@ -10,7 +12,8 @@ constexpr int SAMPLE_COUNT = 128;
 constexpr int SAMPLE_RES_WIDTH = 7;
 constexpr int SAMPLE_RES_HEIGHT = 7;
 
-using Bitmap = std::array<bool, SAMPLE_RES_WIDTH * SAMPLE_RES_HEIGHT>;
+// Картинка 7x7 целиком помещается в одно 64-битное слово
+using Bitmap = netz::PackedBitmap;
 
 extern const Bitmap base_circle;
 extern const Bitmap base_square;
@@ -29,6 +32,35 @@ extern const std::array<Bitmap, SAMPLE_COUNT> triangle_bitmaps;
 /// @return	Новая, "зашумленная" картинка.
 Bitmap GenerateNoisyBitmap(Bitmap base_bitmap, double noise_percent);
 
+/// @brief	Счетчиковый генератор случайных чисел: результат зависит только
+/// 		от seed и counter, так что любое число последовательности
+/// 		вычисляется без предыдущих, в любом потоке и в любом порядке.
+/// @return	Равномерно распределенное 64-битное число.
+uint64_t CounterRandom(uint64_t seed, uint64_t counter);
+
+/// @brief	То же, что GenerateNoisyBitmap выше, но шум образца номер
+/// 		sample определяется только seed и sample (см. CounterRandom).
+Bitmap GenerateNoisyBitmap(const Bitmap& base_bitmap, double noise_percent,
+        uint64_t seed, uint64_t sample);
+
+/// @brief	Пишет amount зашумленных картинок упакованной выборкой (см.
+/// 		netz_dataset_file.hpp). Классы идут вперемешку: образец i -
+/// 		круг, квадрат или треугольник при i % 3, равном 0, 1 или 2,
+/// 		как выходы netz. Картинки генерируются блоками в threads
+/// 		потоков, а пишутся по порядку, так что файл при том же seed
+/// 		не зависит от числа потоков.
+/// @param	out - поток вывода выборки.
+/// @param	amount - число образцов.
+/// @param	noise_percent - вероятность инверсии каждого бита.
+/// @param	seed - зерно генератора.
+/// @param	threads - число потоков.
+/// @param	width, height - размер картинок. Эталонные фигуры 7x7
+/// 		растягиваются до него (см. netz::shapes::Resize).
+/// @return	Число записанных образцов.
+size_t GenerateDataset(std::ostream& out, size_t amount,
+        double noise_percent, uint64_t seed, size_t threads,
+        size_t width = SAMPLE_RES_WIDTH, size_t height = SAMPLE_RES_HEIGHT);
+
 /// @brief	Генерирует исходный код массива с битовыми картами для обучения
 /// 		нейросети.
 /// @param	out - поток вывода исходного кода.
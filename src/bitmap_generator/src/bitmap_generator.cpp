@@ -1,7 +1,12 @@
 #include "bitmap_generator.h"
+#include <algorithm>
 #include <ostream>
 #include <random>
 #include <iostream>
+#include <thread>
+#include <vector>
+#include "netz_dataset_file.hpp"
+#include "netz_shapes.hpp"
 
 namespace bitmap_generator {
 
@@ -11,35 +16,14 @@ std::uniform_real_distribution<double> distribution(0.0, 1.0);
 
 constexpr double EPSYLON = 10e-6;
 
-const Bitmap base_circle = {
-    0, 0, 0, 0, 0, 0, 0,
-    0, 0, 1, 1, 1, 0, 0,
-    0, 1, 0, 0, 0, 1, 0,
-    0, 1, 0, 0, 0, 1, 0,
-    0, 1, 0, 0, 0, 1, 0,
-    0, 0, 1, 1, 1, 0, 0,
-    0, 0, 0, 0, 0, 0, 0,
-};
-
-const Bitmap base_square = {
-    0, 0, 0, 0, 0, 0, 0,
-    0, 1, 1, 1, 1, 1, 0,
-    0, 1, 0, 0, 0, 1, 0,
-    0, 1, 0, 0, 0, 1, 0,
-    0, 1, 0, 0, 0, 1, 0,
-    0, 1, 1, 1, 1, 1, 0,
-    0, 0, 0, 0, 0, 0, 0,
-};
-
-const Bitmap base_triangle = {
-    0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 1, 0, 0, 0,
-    0, 0, 1, 0, 1, 0, 0,
-    0, 1, 0, 0, 0, 1, 0,
-    1, 0, 0, 0, 0, 0, 1,
-    1, 1, 1, 1, 1, 1, 1,
-    0, 0, 0, 0, 0, 0, 0,
-};
+constexpr size_t CLASS_COUNT = 3;
+// Образцов на поток за раз: блок из 64K картинок генерируется дольше,
+// чем создается поток
+constexpr size_t DATASET_BLOCK = 64 * 1024;
+
+const Bitmap base_circle = netz::shapes::Circle();
+const Bitmap base_square = netz::shapes::Square();
+const Bitmap base_triangle = netz::shapes::Triangle();
 
 template<typename FloatingPointType>
 bool IsLess(const FloatingPointType lhs, const FloatingPointType rhs) {
@@ -50,14 +34,90 @@ Bitmap GenerateNoisyBitmap(Bitmap base_bitmap, double noise_percent) {
     for (size_t y = 0; y < SAMPLE_RES_HEIGHT; y++) {
         for (size_t x = 0; x < SAMPLE_RES_WIDTH; x++) {
             if (IsLess(distribution(mt_gen), noise_percent))
-                base_bitmap[x + y + SAMPLE_RES_WIDTH]
-                    = !base_bitmap[x + y * SAMPLE_RES_WIDTH];
+                base_bitmap.Flip(x + y * SAMPLE_RES_WIDTH);
         }
     }
 
     return base_bitmap;
 }
 
+// Финализатор SplitMix64 - биекция, перемешивающая все биты
+uint64_t Mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t CounterRandom(uint64_t seed, uint64_t counter) {
+    return Mix(Mix(seed) + (counter + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+Bitmap GenerateNoisyBitmap(const Bitmap& base_bitmap, double noise_percent,
+        uint64_t seed, uint64_t sample) {
+    const size_t pixels = base_bitmap.Size();
+    Bitmap bitmap = base_bitmap;
+
+    for (size_t i = 0; i < pixels; i++) {
+        // Старшие 53 бита - равномерное число из [0, 1)
+        const double r = (CounterRandom(seed, sample * pixels + i) >> 11)
+            * 0x1.0p-53;
+
+        if (r < noise_percent)
+            bitmap.Flip(i);
+    }
+
+    return bitmap;
+}
+
+size_t GenerateDataset(std::ostream& out, size_t amount,
+        double noise_percent, uint64_t seed, size_t threads,
+        size_t width, size_t height) {
+    const Bitmap base_bitmaps[CLASS_COUNT] = {
+        netz::shapes::Resize(base_circle, SAMPLE_RES_WIDTH, width, height),
+        netz::shapes::Resize(base_square, SAMPLE_RES_WIDTH, width, height),
+        netz::shapes::Resize(base_triangle, SAMPLE_RES_WIDTH, width, height),
+    };
+
+    netz::dataset::Writer writer(out, width * height, CLASS_COUNT);
+
+    threads = std::max<size_t>(threads, 1);
+    std::vector<std::vector<Bitmap>> blocks(threads);
+
+    for (size_t round = 0; round < amount; round += threads * DATASET_BLOCK) {
+        std::vector<std::thread> workers;
+
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                const size_t begin = std::min(amount,
+                    round + t * DATASET_BLOCK);
+                const size_t end = std::min(amount, begin + DATASET_BLOCK);
+
+                blocks[t].resize(end - begin);
+
+                for (size_t i = begin; i < end; i++) {
+                    blocks[t][i - begin] = GenerateNoisyBitmap(
+                        base_bitmaps[i % CLASS_COUNT], noise_percent,
+                        seed, i);
+                }
+            });
+        }
+
+        for (std::thread& worker : workers)
+            worker.join();
+
+        // Блоки пишутся в порядке номеров образцов
+        size_t i = round;
+        for (const std::vector<Bitmap>& block : blocks) {
+            for (const Bitmap& bitmap : block) {
+                writer.Add(bitmap, i % CLASS_COUNT);
+                i++;
+            }
+        }
+    }
+
+    return writer.Count();
+}
+
 std::ostream& GenerateBitmapArraySourceCode(std::ostream& out,
         const std::string& array_def,
         Bitmap base_bitmap,
@@ -86,7 +146,7 @@ std::ostream& GenerateBitmapArraySourceCode(std::ostream& out,
                 is_first_comma = false;
 
                 out << static_cast<int>(
-                    bitmap.at(x + y * SAMPLE_RES_WIDTH));
+                    bitmap.Get(x + y * SAMPLE_RES_WIDTH));
             }
 
             out << ',';
@@ -103,14 +163,14 @@ std::ostream& GenerateBitmapArraySourceCode(std::ostream& out,
 
 std::ostream& operator<<(std::ostream& out, const Bitmap& bitmap) {
     bool is_first = true;
-    for (size_t y = 0; y < bitmap.size(); y++) {
+    for (size_t y = 0; y < SAMPLE_RES_HEIGHT; y++) {
         if (!is_first)
             out << std::endl;
 
         is_first = false;
 
         for (size_t x = 0; x < SAMPLE_RES_WIDTH; x++) {
-            out << (bitmap.at(y * SAMPLE_RES_WIDTH + x) ? '#' : ' ');
+            out << (bitmap.Get(y * SAMPLE_RES_WIDTH + x) ? '#' : ' ');
         }
     }
     return out;
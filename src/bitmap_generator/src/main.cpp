@@ -1,8 +1,14 @@
 #include "bitmap_generator.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <fstream>
+#include <limits>
 #include <ostream>
+#include <thread>
 
 const std::string circle_vector_name =
     "const std::vector<std::vector<int>> circle_bitmaps";
@@ -100,7 +106,7 @@ void GenerateFiguresIntoFiles(FigureType type, const std::string& output_path,
 
         for (size_t h = 0; h < SAMPLE_RES_HEIGHT; h++) {
             for (size_t w = 0; w < SAMPLE_RES_WIDTH; w++) {
-                fout << (bm.at(w + h * SAMPLE_RES_WIDTH) ? 1
+                fout << (bm.Get(w + h * SAMPLE_RES_WIDTH) ? 1
                         : 0);
             }
             fout << '\n';
@@ -128,10 +134,106 @@ int GenerateIntoFilesMain(int argc, char **argv) {
     return 0;
 }
 
+constexpr size_t ARGV_DATASET_PATH	= 2;
+constexpr size_t ARGV_DATASET_AMOUNT	= 3;
+constexpr size_t ARGV_DATASET_SEED	= 4;
+constexpr size_t ARGV_DATASET_THREADS	= 5;
+constexpr size_t ARGV_DATASET_WIDTH	= 6;
+constexpr size_t ARGV_DATASET_HEIGHT	= 7;
+
+// Разбирает аргумент argv[index], если он есть: целое число не меньше
+// min_value, только цифры. std::stoull бросил бы на "abc" исключение, а
+// из "1e" взял бы единицу. Об ошибке сообщает сам.
+bool ParseArgument(int argc, char **argv, size_t index, uint64_t min_value,
+        uint64_t& value) {
+    if (argc <= int(index)) {
+        return true;
+    }
+
+    const char *text = argv[index];
+    const size_t length = std::strlen(text);
+    const bool digits = length != 0
+            && std::all_of(text, text + length, [](unsigned char c) {
+                return std::isdigit(c);
+            });
+
+    errno = 0;
+    const unsigned long long parsed = digits
+            ? std::strtoull(text, nullptr, 10) : 0;
+
+    if (!digits || errno == ERANGE || parsed < min_value) {
+        std::cerr << "Invalid argument: " << text << std::endl;
+        return false;
+    }
+
+    value = parsed;
+    return true;
+}
+
+int GenerateDatasetMain(int argc, char **argv) {
+    using namespace bitmap_generator;
+
+    if (argc < 4) {
+        std::cout << "Usage: ./bitmapgen dataset [output.bin] [amount] "
+                "[seed] [threads] [width] [height]\n";
+        return 0;
+    }
+
+    // Аргументы проверяются до открытия файла, чтобы ошибка в них не
+    // затерла существующую выборку
+    uint64_t amount = 0;
+    uint64_t seed = 0;
+    uint64_t threads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t width = SAMPLE_RES_WIDTH;
+
+    if (!ParseArgument(argc, argv, ARGV_DATASET_AMOUNT, 0, amount)
+            || !ParseArgument(argc, argv, ARGV_DATASET_SEED, 0, seed)
+            || !ParseArgument(argc, argv, ARGV_DATASET_THREADS, 1, threads)
+            || !ParseArgument(argc, argv, ARGV_DATASET_WIDTH, 1, width)) {
+        return 1;
+    }
+
+    uint64_t height = width;
+
+    if (!ParseArgument(argc, argv, ARGV_DATASET_HEIGHT, 1, height)) {
+        return 1;
+    }
+
+    // Число пикселей хранится в заголовке выборки 32-битным
+    if (width > std::numeric_limits<uint32_t>::max() / height) {
+        std::cerr << "Bitmap size is too large.\n";
+        return 1;
+    }
+
+    std::ofstream fout(argv[ARGV_DATASET_PATH], std::ios::binary);
+
+    if (!fout) {
+        std::cerr << "Could not create file "
+                << argv[ARGV_DATASET_PATH] << std::endl;
+        return 1;
+    }
+
+    GenerateDataset(fout, amount, NOISINESS_COEFF, seed, threads,
+            width, height);
+
+    if (!fout) {
+        std::cerr << "Could not write file "
+                << argv[ARGV_DATASET_PATH] << std::endl;
+        return 1;
+    }
+
+    std::cout << amount << " samples written to "
+            << argv[ARGV_DATASET_PATH] << ".\n";
+
+    return 0;
+}
+
 int main(int argc, char **argv) {
     if (argc < 2) {
         std::cout << "Usage:\t\t./bitmapgen files [output_path] [amount]\n";
         std::cout << "Or:\t\t./bitmapgen cpp [output.cpp] [output.hpp]\n";
+        std::cout << "Or:\t\t./bitmapgen dataset [output.bin] [amount] "
+                "[seed] [threads] [width] [height]\n";
         return 0;
     }
 
@@ -139,6 +241,8 @@ int main(int argc, char **argv) {
         return GenerateIntoFilesMain(argc, argv);
     } else if (std::strcmp(argv[ARGV_CMD], "cpp") == 0) {
         return GenerateCppFilesMain(argc, argv);
+    } else if (std::strcmp(argv[ARGV_CMD], "dataset") == 0) {
+        return GenerateDatasetMain(argc, argv);
     }
 
     std::cout << "Unknown command.\n";
@@ -0,0 +1,135 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "netz_model_parser.hpp"
+
+// Скорость разбора текстового дампа: прежний построчный разбор через
+// getline/stod против netz::parser::ParseModel. Дамп сети
+// 784-512-512-10 (около 14 МБ) генерируется в памяти, каждый способ
+// запускается RUNS раз, выводится лучшее время.
+//
+// ./model_parser_bench [input_count] [layer_size]...
+
+namespace {
+
+constexpr int RUNS = 5;
+
+std::string MakeDump(const std::vector<size_t>& topology) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<> dis(-1.0, 1.0);
+    std::ostringstream out;
+
+    out.precision(17);
+    out << ">" << topology[0] << '\n';
+
+    for (size_t k = 1; k < topology.size(); k++) {
+        for (size_t i = 0; i < topology[k]; i++) {
+            out << "@" << k - 1 << "/" << i << '\n';
+
+            for (size_t j = 0; j < topology[k - 1]; j++) {
+                out << "#" << dis(gen) << '\n';
+            }
+        }
+    }
+
+    return out.str();
+}
+
+// Разбор в том виде, в каком он был в ReadStructure и ParseNetwork
+size_t ParseLegacy(std::istream& in) {
+    std::string line;
+    std::vector<std::vector<std::vector<double>>> weights;
+    int layer = 0;
+    int neuron = 0;
+    size_t count = 0;
+
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+
+        if (line[0] == '@') {
+            std::string indices = line.substr(1);
+            size_t delimiter = indices.find('/');
+
+            layer  = std::stoi(indices.substr(0, delimiter));
+            neuron = std::stoi(indices.substr(delimiter + 1));
+
+            if (layer >= weights.size()) {
+                weights.resize(layer + 1);
+            }
+
+            if (neuron >= weights[layer].size()) {
+                weights[layer].resize(neuron + 1);
+            }
+        } else if (line[0] == '#') {
+            weights[layer][neuron].push_back(std::stod(line.substr(1)));
+            count++;
+        }
+    }
+
+    return count;
+}
+
+struct Collector {
+    std::vector<double> weights;
+    size_t neurons = 0;
+
+    void OnInputCount(size_t) {}
+    void OnConvolution(size_t, const netz::parser::Convolution&) {}
+    void OnActivation(size_t, std::string_view) {}
+    void OnNeuron(size_t, size_t) { neurons++; }
+    void OnWeight(double weight) { weights.push_back(weight); }
+};
+
+size_t ParseShared(std::istream& in) {
+    Collector collector;
+    netz::parser::ParseModel(in, collector);
+    return collector.weights.size();
+}
+
+template<typename Func>
+void Measure(const char *name, const std::string& dump, Func parse) {
+    double best = 0.0;
+    size_t weights = 0;
+
+    for (int run = 0; run < RUNS; run++) {
+        std::istringstream in(dump);
+
+        const auto start = std::chrono::steady_clock::now();
+        weights = parse(in);
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        if (run == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+
+    std::printf("%-8s %10.3f ms %10.1f MB/s %12.0f weights/s\n", name,
+        best * 1e3, dump.size() / best / 1e6, weights / best);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<size_t> topology = { 784, 512, 512, 10 };
+
+    if (argc > 2) {
+        topology.clear();
+        for (int i = 1; i < argc; i++) {
+            topology.push_back(std::strtoul(argv[i], nullptr, 10));
+        }
+    }
+
+    const std::string dump = MakeDump(topology);
+    std::printf("dump: %.1f MB\n", dump.size() / 1e6);
+
+    Measure("legacy", dump, ParseLegacy);
+    Measure("shared", dump, ParseShared);
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <initializer_list>
+#include <utility>
+
+namespace netz {
+
+// Черно-белая картинка по биту на пиксель: пиксель i - бит i % 64 слова
+// i / 64, биты за последним пикселем всегда нулевые. Картинка до 64
+// пикселей, например 7x7, хранится в единственном слове внутри объекта
+// и копируется без выделения памяти. Для больших слова лежат в куче.
+//
+// Get, Set и Flip не проверяют индекс.
+class PackedBitmap {
+public:
+    static constexpr size_t WORD_BITS = 64;
+
+    PackedBitmap() = default;
+
+    explicit PackedBitmap(size_t size) : size__(size) {
+        if (!IsInline()) {
+            storage__.heap = new uint64_t[WordCount()]();
+        }
+    }
+
+    PackedBitmap(const PackedBitmap& other)
+            : size__(other.size__), storage__(other.storage__) {
+        if (!IsInline()) {
+            storage__.heap = new uint64_t[WordCount()];
+            std::copy(other.Words(), other.Words() + WordCount(),
+                storage__.heap);
+        }
+    }
+
+    PackedBitmap(PackedBitmap&& other) noexcept
+            : size__(other.size__), storage__(other.storage__) {
+        other.size__ = 0;
+        other.storage__ = Storage();
+    }
+
+    PackedBitmap& operator=(PackedBitmap other) noexcept {
+        std::swap(size__, other.size__);
+        std::swap(storage__, other.storage__);
+        return *this;
+    }
+
+    ~PackedBitmap() {
+        if (!IsInline()) {
+            delete[] storage__.heap;
+        }
+    }
+
+    // Пиксели построчно, ненулевое значение - черный пиксель
+    PackedBitmap(std::initializer_list<int> pixels)
+            : PackedBitmap(pixels.size()) {
+        size_t i = 0;
+        for (int pixel : pixels) {
+            Set(i++, pixel != 0);
+        }
+    }
+
+    template<typename T>
+    static PackedBitmap FromPixels(const T *pixels, size_t size) {
+        PackedBitmap bitmap(size);
+
+        for (size_t i = 0; i < size; i++) {
+            bitmap.Set(i, pixels[i] != T(0));
+        }
+
+        return bitmap;
+    }
+
+    size_t Size() const {
+        return size__;
+    }
+
+    size_t WordCount() const {
+        return (size__ + WORD_BITS - 1) / WORD_BITS;
+    }
+
+    const uint64_t *Words() const {
+        return IsInline() ? &storage__.word : storage__.heap;
+    }
+
+    bool Get(size_t i) const {
+        return (Words()[i / WORD_BITS] >> (i % WORD_BITS)) & 1;
+    }
+
+    PackedBitmap& Set(size_t i, bool value) {
+        const uint64_t bit = uint64_t(1) << (i % WORD_BITS);
+
+        if (value) {
+            MutableWords()[i / WORD_BITS] |= bit;
+        } else {
+            MutableWords()[i / WORD_BITS] &= ~bit;
+        }
+
+        return *this;
+    }
+
+    PackedBitmap& Flip(size_t i) {
+        MutableWords()[i / WORD_BITS] ^= uint64_t(1) << (i % WORD_BITS);
+        return *this;
+    }
+
+    // Число черных пикселей
+    size_t Count() const {
+        size_t count = 0;
+
+        for (size_t w = 0; w < WordCount(); w++) {
+            count += __builtin_popcountll(Words()[w]);
+        }
+
+        return count;
+    }
+
+    // Распаковывает пиксели в Size() чисел 0 и 1
+    template<typename T>
+    void Unpack(T *out) const {
+        for (size_t i = 0; i < size__; i++) {
+            out[i] = Get(i) ? T(1) : T(0);
+        }
+    }
+
+    bool operator==(const PackedBitmap& other) const {
+        return size__ == other.size__
+            && std::equal(Words(), Words() + WordCount(), other.Words());
+    }
+
+    bool operator!=(const PackedBitmap& other) const {
+        return !(*this == other);
+    }
+private:
+    bool IsInline() const {
+        return size__ <= WORD_BITS;
+    }
+
+    uint64_t *MutableWords() {
+        return IsInline() ? &storage__.word : storage__.heap;
+    }
+
+    // Единственное слово маленькой картинки или слова большой в куче
+    union Storage {
+        uint64_t    word = 0;
+        uint64_t   *heap;
+    };
+
+    size_t          size__ = 0;
+    Storage         storage__;
+};
+
+} // namespace netz
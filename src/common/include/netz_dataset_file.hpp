@@ -0,0 +1,237 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "netz_bitmap.hpp"
+
+// Упакованная обучающая выборка из черно-белых картинок:
+//
+// [Header, 32 байта]
+// [запись 0] [запись 1] ...
+//
+// Запись - RowBytes(input_count) байт пикселей, по биту на пиксель
+// (пиксель i - бит i % 8 байта i / 8, лишние биты последнего байта
+// нулевые), и байт метки - номер класса от 0 до class_count - 1.
+// Картинка 7x7 занимает 8 байт против 196 байт в std::vector<int>.
+//
+// Число записей в заголовке не хранится, оно следует из размера файла,
+// так что Writer может писать и в неперематываемый поток (например, в
+// канал).
+namespace netz::dataset {
+
+constexpr char      MAGIC[8] = { 'N', 'E', 'T', 'Z', 'D', 'S', 'E', 'T' };
+constexpr uint32_t  VERSION  = 1;
+
+// Метка хранится в одном байте
+constexpr size_t    MAX_CLASS_COUNT = 256;
+
+struct Header {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    input_count;
+    uint32_t    class_count;
+    uint8_t     reserved[12];
+};
+
+static_assert(sizeof(Header) == 32, "Header must be packed");
+
+inline size_t RowBytes(size_t input_count) {
+    return (input_count + 7) / 8;
+}
+
+inline size_t RecordSize(size_t input_count) {
+    return RowBytes(input_count) + 1;
+}
+
+// Пишет заголовок при создании и по записи на каждый Add. Пиксель
+// считается черным, если он не равен нулю.
+class Writer {
+public:
+    Writer(std::ostream& out, size_t input_count, size_t class_count)
+            : out__(out), input_count__(input_count),
+              class_count__(class_count),
+              record__(RecordSize(input_count)) {
+        if (class_count == 0 || class_count > MAX_CLASS_COUNT) {
+            throw std::invalid_argument("Dataset class count must be "
+                "from 1 to 256.");
+        }
+
+        Header header = Header();
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.input_count = input_count;
+        header.class_count = class_count;
+
+        out__.write(reinterpret_cast<const char *>(&header),
+            sizeof(header));
+    }
+
+    template<typename T>
+    Writer& Add(const T *pixels, size_t label) {
+        if (label >= class_count__) {
+            throw std::invalid_argument("Dataset label out of range.");
+        }
+
+        std::fill(record__.begin(), record__.end(), 0);
+
+        for (size_t i = 0; i < input_count__; i++) {
+            if (pixels[i] != T(0)) {
+                record__[i / 8] |= uint8_t(1u << (i % 8));
+            }
+        }
+
+        record__.back() = static_cast<uint8_t>(label);
+        out__.write(reinterpret_cast<const char *>(record__.data()),
+            record__.size());
+        count__++;
+
+        return *this;
+    }
+
+    // Слова картинки уже лежат по биту на пиксель, они только
+    // раскладываются по байтам
+    Writer& Add(const PackedBitmap& bitmap, size_t label) {
+        if (bitmap.Size() != input_count__) {
+            throw std::invalid_argument("Dataset bitmap size differs.");
+        }
+
+        if (label >= class_count__) {
+            throw std::invalid_argument("Dataset label out of range.");
+        }
+
+        const uint64_t *words = bitmap.Words();
+
+        for (size_t b = 0; b + 1 < record__.size(); b++) {
+            record__[b] = uint8_t(words[b / 8] >> (b % 8 * 8));
+        }
+
+        record__.back() = static_cast<uint8_t>(label);
+        out__.write(reinterpret_cast<const char *>(record__.data()),
+            record__.size());
+        count__++;
+
+        return *this;
+    }
+
+    size_t Count() const {
+        return count__;
+    }
+private:
+    std::ostream&           out__;
+    size_t                  input_count__;
+    size_t                  class_count__;
+    std::vector<uint8_t>    record__;
+    size_t                  count__ = 0;
+};
+
+// Выборка, отображенная в память. Записи читаются прямо из файла, в
+// памяти процесса держатся только те страницы, к которым обращались.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        const int fd = open(path.c_str(), O_RDONLY);
+
+        if (fd < 0) {
+            throw std::runtime_error("Could not open dataset " + path);
+        }
+
+        struct stat info;
+
+        if (fstat(fd, &info) != 0
+                || size_t(info.st_size) < sizeof(Header)) {
+            close(fd);
+            throw std::runtime_error("Not a dataset file: " + path);
+        }
+
+        size__ = info.st_size;
+        data__ = mmap(nullptr, size__, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (data__ == MAP_FAILED) {
+            data__ = nullptr;
+            throw std::runtime_error("Could not map dataset " + path);
+        }
+
+        // Записи читаются подряд, так что ядру стоит читать вперед
+        madvise(data__, size__, MADV_SEQUENTIAL);
+
+        Header header;
+        std::memcpy(&header, data__, sizeof(header));
+
+        input_count__ = header.input_count;
+        class_count__ = header.class_count;
+        record_size__ = RecordSize(input_count__);
+
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+                || header.version != VERSION || input_count__ == 0
+                || class_count__ == 0 || class_count__ > MAX_CLASS_COUNT
+                || (size__ - sizeof(Header)) % record_size__ != 0) {
+            munmap(data__, size__);
+            throw std::runtime_error("Not a dataset file: " + path);
+        }
+
+        records__ = static_cast<const uint8_t *>(data__) + sizeof(Header);
+        count__ = (size__ - sizeof(Header)) / record_size__;
+    }
+
+    ~MappedFile() {
+        if (data__) {
+            munmap(data__, size__);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    size_t Size() const {
+        return count__;
+    }
+
+    size_t InputCount() const {
+        return input_count__;
+    }
+
+    size_t ClassCount() const {
+        return class_count__;
+    }
+
+    // Упакованные пиксели записи i, RowBytes(InputCount()) байт
+    const uint8_t *Pixels(size_t i) const {
+        return records__ + i * record_size__;
+    }
+
+    size_t Label(size_t i) const {
+        return Pixels(i)[record_size__ - 1];
+    }
+
+    // Распаковывает пиксели записи i в InputCount() чисел 0 и 1
+    template<typename T>
+    void Unpack(size_t i, T *out) const {
+        const uint8_t *pixels = Pixels(i);
+
+        for (size_t j = 0; j < input_count__; j++) {
+            out[j] = (pixels[j / 8] >> (j % 8)) & 1 ? T(1) : T(0);
+        }
+    }
+private:
+    void           *data__ = nullptr;
+    size_t          size__ = 0;
+    const uint8_t  *records__ = nullptr;
+    size_t          record_size__ = 0;
+    size_t          input_count__ = 0;
+    size_t          class_count__ = 0;
+    size_t          count__ = 0;
+};
+
+} // namespace netz::dataset
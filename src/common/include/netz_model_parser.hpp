@@ -0,0 +1,198 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+// Разбор текстового дампа сети, общий для netzwerk и netzp:
+//
+// >49          число входов
+// %0/1x7x7/4/3/1/relu
+//              сверточный слой 0 (идут до полносвязных): входные карты
+//              каналы x высота x ширина, число фильтров, размер ядра,
+//              размер пулинга и функция активации, далее веса ядер
+// !0/relu      функция активации слоя 0 (если не сигмоида)
+// @0/1         далее веса нейрона 1 слоя 0
+// #0.25        очередной вес текущего нейрона
+//
+// Поток читается кусками по CHUNK_SIZE байт, строки разбираются прямо в
+// буфере через std::from_chars, без std::string на строку. Результат
+// передается обработчику по событиям, так что структуры данных строит
+// вызывающий:
+//
+// struct Handler {
+//     void OnInputCount(size_t count);
+//     void OnConvolution(size_t layer, const Convolution& conv);
+//     void OnActivation(size_t layer, std::string_view name);
+//     void OnNeuron(size_t layer, size_t neuron);
+//     void OnWeight(double weight);
+// };
+//
+// Пустые строки и строки с другими префиксами пропускаются.
+namespace netz::parser {
+
+constexpr size_t CHUNK_SIZE = 1 << 20;
+
+struct Convolution {
+    size_t              channels = 0;
+    size_t              height = 0;
+    size_t              width = 0;
+    size_t              filters = 0;
+    size_t              kernel = 0;
+    size_t              pool = 0;
+    std::string_view    activation;
+};
+
+namespace detail {
+
+inline const char *SkipSpaces(const char *first, const char *last) {
+    while (first != last && (*first == ' ' || *first == '\t')) {
+        first++;
+    }
+
+    return first;
+}
+
+template<typename T>
+const char *ParseNumber(const char *first, const char *last, T& value,
+        const char *error) {
+    first = SkipSpaces(first, last);
+    const std::from_chars_result result = std::from_chars(first, last, value);
+
+    if (result.ec != std::errc()) {
+        throw std::runtime_error(error);
+    }
+
+    return result.ptr;
+}
+
+// Разбирает "layer/" и возвращает указатель на то, что идет за '/'
+inline const char *ParseLayer(const char *first, const char *last,
+        size_t& layer, const char *error) {
+    first = ParseNumber(first, last, layer, error);
+
+    if (first == last || *first != '/') {
+        throw std::runtime_error(error);
+    }
+
+    return first + 1;
+}
+
+// Разбирает число и следующий за ним разделитель
+inline const char *ParseField(const char *first, const char *last,
+        size_t& value, char separator, const char *error) {
+    first = ParseNumber(first, last, value, error);
+
+    if (first == last || *first != separator) {
+        throw std::runtime_error(error);
+    }
+
+    return first + 1;
+}
+
+template<typename Handler>
+void ParseLine(const char *first, const char *last, Handler& handler,
+        bool& in_neuron) {
+    if (first != last && last[-1] == '\r') {
+        last--;
+    }
+
+    if (first == last) return;
+
+    switch (*first) {
+        case '>': {
+            size_t count;
+            ParseNumber(first + 1, last, count, "Invalid input count.");
+            handler.OnInputCount(count);
+            break;
+        }
+        case '@': {
+            size_t layer, neuron;
+            const char *p = ParseLayer(first + 1, last, layer,
+                "Invalid index format.");
+            ParseNumber(p, last, neuron, "Invalid index format.");
+            handler.OnNeuron(layer, neuron);
+            in_neuron = true;
+            break;
+        }
+        case '%': {
+            constexpr char error[] = "Invalid convolution format.";
+            size_t layer;
+            Convolution conv;
+            const char *p = ParseLayer(first + 1, last, layer, error);
+            p = ParseField(p, last, conv.channels, 'x', error);
+            p = ParseField(p, last, conv.height, 'x', error);
+            p = ParseField(p, last, conv.width, '/', error);
+            p = ParseField(p, last, conv.filters, '/', error);
+            p = ParseField(p, last, conv.kernel, '/', error);
+            p = ParseField(p, last, conv.pool, '/', error);
+            conv.activation = std::string_view(p, last - p);
+            handler.OnConvolution(layer, conv);
+            in_neuron = true;
+            break;
+        }
+        case '#': {
+            if (!in_neuron) {
+                throw std::runtime_error("Weight outside of a neuron.");
+            }
+
+            double weight;
+            ParseNumber(first + 1, last, weight, "Invalid weight format.");
+            handler.OnWeight(weight);
+            break;
+        }
+        case '!': {
+            size_t layer;
+            const char *p = ParseLayer(first + 1, last, layer,
+                "Invalid activation format.");
+            handler.OnActivation(layer, std::string_view(p, last - p));
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+} // namespace detail
+
+template<typename Handler>
+void ParseModel(std::istream& in, Handler& handler) {
+    std::vector<char> buffer(CHUNK_SIZE);
+    size_t carry = 0;
+    bool in_neuron = false;
+
+    while (in) {
+        if (carry == buffer.size()) {
+            // Строка длиннее буфера
+            buffer.resize(buffer.size() * 2);
+        }
+
+        in.read(buffer.data() + carry, buffer.size() - carry);
+        const size_t filled = carry + in.gcount();
+
+        const char *first = buffer.data();
+        const char *last = buffer.data() + filled;
+
+        for (const char *eol;
+                (eol = std::char_traits<char>::find(first, last - first, '\n'));
+                first = eol + 1) {
+            detail::ParseLine(first, eol, handler, in_neuron);
+        }
+
+        if (!in) {
+            // Последняя строка может быть без перевода строки
+            detail::ParseLine(first, last, handler, in_neuron);
+            break;
+        }
+
+        carry = last - first;
+        std::copy(first, last, buffer.data());
+    }
+}
+
+} // namespace netz::parser
@@ -0,0 +1,145 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include "netz_bitmap.hpp"
+
+// Эталонные фигуры 7x7, из которых шумом и сдвигами получаются
+// обучающие картинки, и преобразования картинок. Картинки хранятся
+// построчно: пиксель (x, y) - бит x + y * width, высота - Size() / width.
+namespace netz::shapes {
+
+constexpr size_t WIDTH  = 7;
+constexpr size_t HEIGHT = 7;
+
+inline PackedBitmap Circle() {
+    return {
+        0, 0, 0, 0, 0, 0, 0,
+        0, 0, 1, 1, 1, 0, 0,
+        0, 1, 0, 0, 0, 1, 0,
+        0, 1, 0, 0, 0, 1, 0,
+        0, 1, 0, 0, 0, 1, 0,
+        0, 0, 1, 1, 1, 0, 0,
+        0, 0, 0, 0, 0, 0, 0,
+    };
+}
+
+inline PackedBitmap Square() {
+    return {
+        0, 0, 0, 0, 0, 0, 0,
+        0, 1, 1, 1, 1, 1, 0,
+        0, 1, 0, 0, 0, 1, 0,
+        0, 1, 0, 0, 0, 1, 0,
+        0, 1, 0, 0, 0, 1, 0,
+        0, 1, 1, 1, 1, 1, 0,
+        0, 0, 0, 0, 0, 0, 0,
+    };
+}
+
+inline PackedBitmap Triangle() {
+    return {
+        0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 1, 0, 0, 0,
+        0, 0, 1, 0, 1, 0, 0,
+        0, 1, 0, 0, 0, 1, 0,
+        1, 0, 0, 0, 0, 0, 1,
+        1, 1, 1, 1, 1, 1, 1,
+        0, 0, 0, 0, 0, 0, 0,
+    };
+}
+
+// Картинка размера width x height из картинки шириной width, пиксели
+// берутся от ближайшего соседа. Так эталонные фигуры 7x7 растягиваются
+// до нужного разрешения.
+inline PackedBitmap Resize(const PackedBitmap& bitmap, size_t width,
+        size_t new_width, size_t new_height) {
+    const size_t height = bitmap.Size() / width;
+    PackedBitmap resized(new_width * new_height);
+
+    for (size_t y = 0; y < new_height; y++) {
+        for (size_t x = 0; x < new_width; x++) {
+            const size_t from_x = x * width / new_width;
+            const size_t from_y = y * height / new_height;
+
+            resized.Set(x + y * new_width, bitmap.Get(from_x + from_y * width));
+        }
+    }
+
+    return resized;
+}
+
+// Наименьший прямоугольник [min_x, max_x] x [min_y, max_y], в котором
+// лежат все черные пиксели. У пустой картинки min больше max.
+struct Bounds {
+    size_t  min_x = std::numeric_limits<size_t>::max();
+    size_t  min_y = std::numeric_limits<size_t>::max();
+    size_t  max_x = 0;
+    size_t  max_y = 0;
+};
+
+inline Bounds GetBounds(const PackedBitmap& bitmap, size_t width) {
+    const size_t height = bitmap.Size() / width;
+    Bounds bounds;
+
+    for (size_t y = 0; y < height; y++) {
+        for (size_t x = 0; x < width; x++) {
+            if (bitmap.Get(x + y * width)) {
+                bounds.min_x = std::min(bounds.min_x, x);
+                bounds.min_y = std::min(bounds.min_y, y);
+                bounds.max_x = std::max(bounds.max_x, x);
+                bounds.max_y = std::max(bounds.max_y, y);
+            }
+        }
+    }
+
+    return bounds;
+}
+
+// Сдвиг на (dx, dy). Ушедшие за край пиксели теряются, пришедшие из-за
+// края - белые.
+inline PackedBitmap Shift(const PackedBitmap& bitmap, size_t width,
+        long dx, long dy) {
+    const long w = width;
+    const long h = bitmap.Size() / width;
+    PackedBitmap shifted(bitmap.Size());
+
+    for (long y = 0; y < h; y++) {
+        for (long x = 0; x < w; x++) {
+            const long from_x = x - dx;
+            const long from_y = y - dy;
+
+            if (from_x >= 0 && from_x < w && from_y >= 0 && from_y < h) {
+                shifted.Set(x + y * w, bitmap.Get(from_x + from_y * w));
+            }
+        }
+    }
+
+    return shifted;
+}
+
+// Поворот квадратной картинки на quarter_turns четвертей оборота по
+// часовой стрелке
+inline PackedBitmap Rotate(const PackedBitmap& bitmap, size_t width,
+        unsigned quarter_turns) {
+    if (bitmap.Size() != width * width) {
+        throw std::invalid_argument("Only square bitmaps can be rotated.");
+    }
+
+    PackedBitmap rotated = bitmap;
+
+    for (unsigned turn = 0; turn < quarter_turns % 4; turn++) {
+        const PackedBitmap source = rotated;
+
+        for (size_t y = 0; y < width; y++) {
+            for (size_t x = 0; x < width; x++) {
+                rotated.Set(width - 1 - y + x * width,
+                    source.Get(x + y * width));
+            }
+        }
+    }
+
+    return rotated;
+}
+
+} // namespace netz::shapes
@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace netz {
+
+// Ограниченная очередь без блокировок для одного писателя и одного
+// читателя. Писатель двигает только tail__, читатель только head__,
+// так что хватает пары атомарных счетчиков. Счетчики лежат в разных
+// строках кэша, чтобы потоки не отнимали друг у друга одну строку.
+//
+// TryPush вызывается только из потока-писателя, TryPop - только из
+// потока-читателя.
+template<typename T>
+class SpscQueue {
+public:
+    // capacity округляется вверх до степени двойки
+    explicit SpscQueue(size_t capacity) {
+        if (capacity == 0) {
+            throw std::invalid_argument("Queue capacity must be positive.");
+        }
+
+        size_t size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+
+        slots__.resize(size);
+        mask__ = size - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // false, если очередь полна
+    bool TryPush(T value) {
+        const size_t tail = tail__.load(std::memory_order_relaxed);
+
+        if (tail - head__.load(std::memory_order_acquire) > mask__) {
+            return false;
+        }
+
+        slots__[tail & mask__] = std::move(value);
+        tail__.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // false, если очередь пуста
+    bool TryPop(T& value) {
+        const size_t head = head__.load(std::memory_order_relaxed);
+
+        if (head == tail__.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = std::move(slots__[head & mask__]);
+        head__.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    size_t Capacity() const {
+        return slots__.size();
+    }
+private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    std::vector<T>                          slots__;
+    size_t                                  mask__ = 0;
+    alignas(CACHE_LINE) std::atomic<size_t> head__{0};
+    alignas(CACHE_LINE) std::atomic<size_t> tail__{0};
+};
+
+} // namespace netz
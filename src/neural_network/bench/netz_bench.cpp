@@ -0,0 +1,455 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "netz.hpp"
+#include "netz_bitmap.hpp"
+#include "netz_compiled.hpp"
+#include "netz_simd.hpp"
+#include "netz_trainer.hpp"
+
+// Производительность обучения и вывода netz. Каждый замер повторяется,
+// пока суммарное время не превысит --min-time, результат выводится в
+// JSON (по образцу Google Benchmark), чтобы сравнивать версии между
+// собой:
+//
+// {
+//   "context": { "date": ..., "isa": "avx512", "threads": 8, ... },
+//   "benchmarks": [
+//     { "name": "forward_batch/f32/784-128-10/batch:64",
+//       "iterations": 1200, "real_time_ns": 51234.5,
+//       "items_per_second": 1.2e6, ... },
+//     ...
+//   ]
+// }
+//
+// items - образцы для forward, adjust_weights и epoch, байты файла для
+// dump и load. Для epoch дополнительно выводится epochs_per_second.
+//
+// ./netz_bench [--filter substring] [--min-time seconds] [--threads n]
+
+namespace {
+
+constexpr size_t SAMPLE_COUNT = 1024;
+constexpr double ALPHA = 0.2;
+
+const std::vector<std::vector<size_t>> TOPOLOGIES = {
+    { 49, 6, 3 },
+    { 784, 128, 10 },
+    { 784, 512, 512, 10 },
+};
+
+// Картинка 28x28 через свертку с пулингом, затем те же полносвязные
+// слои, что у 784-128-10
+struct ConvTopology {
+    netz::ConvShape     shape;
+    std::vector<size_t> layers;
+};
+
+const std::vector<ConvTopology> CONV_TOPOLOGIES = {
+    { { 1, 28, 28, 8, 5, 4 }, { 128, 10 } },
+};
+
+const std::vector<size_t> BATCH_SIZES = { 1, 16, 64, 256 };
+
+struct Options {
+    std::string filter;
+    double      min_time = 0.5;
+    size_t      threads = 1;
+};
+
+struct Result {
+    std::string name;
+    size_t      iterations;
+    double      seconds;
+    double      items;
+    double      epochs;
+};
+
+template<typename Scalar>
+const char *ScalarName() {
+    return sizeof(Scalar) == sizeof(float) ? "f32" : "f64";
+}
+
+std::string TopologyName(const std::vector<size_t>& topology) {
+    std::string name;
+
+    for (size_t size : topology) {
+        name += (name.empty() ? "" : "-") + std::to_string(size);
+    }
+
+    return name;
+}
+
+template<typename Scalar>
+netz::BasicNetzwerk<Scalar> MakeNetwork(const std::vector<size_t>& topology) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dis(-0.5, 0.5);
+    netz::BasicNetzwerk<Scalar> netz;
+
+    for (size_t i = 0; i < topology[0]; i++) {
+        netz.AddInput(0);
+    }
+
+    for (size_t k = 1; k < topology.size(); k++) {
+        netz.AddLayer(topology[k]);
+
+        netz::BasicLayer<Scalar>& l = netz.GetLayer(k - 1);
+        for (size_t i = 0; i < l.Size(); i++) {
+            for (size_t j = 0; j < l.InputSize(); j++) {
+                l.SetWeight(i, j, static_cast<Scalar>(dis(gen)));
+            }
+        }
+    }
+
+    return netz.Invalidate();
+}
+
+template<typename Scalar>
+netz::BasicNetzwerk<Scalar> MakeConvNetwork(const ConvTopology& topology) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dis(-0.5, 0.5);
+    netz::BasicNetzwerk<Scalar> netz;
+
+    for (size_t i = 0; i < topology.shape.InputSize(); i++) {
+        netz.AddInput(0);
+    }
+
+    netz.AddConvolution(topology.shape);
+
+    for (size_t k = 0; k < topology.layers.size(); k++) {
+        netz.AddLayer(topology.layers[k]);
+
+        netz::BasicLayer<Scalar>& l = netz.GetLayer(k);
+        for (size_t i = 0; i < l.Size(); i++) {
+            for (size_t j = 0; j < l.InputSize(); j++) {
+                l.SetWeight(i, j, static_cast<Scalar>(dis(gen)));
+            }
+        }
+    }
+
+    return netz.Invalidate();
+}
+
+// Случайные черно-белые картинки и one-hot ответы
+template<typename Scalar>
+netz::BasicDataset<Scalar> MakeDataset(size_t input_count,
+        size_t output_count) {
+    std::mt19937 gen(7);
+    std::bernoulli_distribution pixel(0.3);
+    std::uniform_int_distribution<size_t> label(0, output_count - 1);
+    netz::BasicDataset<Scalar> data(input_count, output_count);
+    std::vector<Scalar> inputs(input_count);
+    std::vector<Scalar> expected(output_count);
+
+    for (size_t s = 0; s < SAMPLE_COUNT; s++) {
+        for (Scalar& x : inputs) {
+            x = pixel(gen) ? 1 : 0;
+        }
+
+        std::fill(expected.begin(), expected.end(), Scalar(0));
+        expected[label(gen)] = 1;
+
+        data.AddSample(inputs.data(), expected.data());
+    }
+
+    return data;
+}
+
+class Runner {
+public:
+    explicit Runner(const Options& options) : options__(options) {}
+
+    // body выполняет одну итерацию и возвращает число обработанных
+    // items. Первая итерация - прогрев, в замер не входит.
+    void Measure(const std::string& name, double epochs_per_iteration,
+            const std::function<double()>& body) {
+        if (name.find(options__.filter) == std::string::npos) return;
+
+        body();
+
+        Result result = { name, 0, 0.0, 0.0, 0.0 };
+        const auto start = std::chrono::steady_clock::now();
+
+        do {
+            result.items += body();
+            result.iterations++;
+            result.seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+        } while (result.seconds < options__.min_time);
+
+        result.epochs = epochs_per_iteration * result.iterations;
+        results__.push_back(result);
+
+        std::fprintf(stderr, "%-48s %10zu it %12.0f items/s\n",
+            name.c_str(), result.iterations, result.items / result.seconds);
+    }
+
+    void Report() const {
+        char date[32];
+        const std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S",
+            std::localtime(&now));
+
+        std::printf("{\n  \"context\": {\n");
+        std::printf("    \"date\": \"%s\",\n", date);
+        std::printf("    \"isa\": \"%s\",\n", netz::math::simd::IsaName(
+            netz::math::simd::ActiveIsa()));
+        std::printf("    \"threads\": %zu,\n", options__.threads);
+        std::printf("    \"hardware_concurrency\": %u,\n",
+            std::thread::hardware_concurrency());
+        std::printf("    \"samples\": %zu,\n", SAMPLE_COUNT);
+        std::printf("    \"min_time\": %g\n  },\n", options__.min_time);
+        std::printf("  \"benchmarks\": [");
+
+        for (size_t i = 0; i < results__.size(); i++) {
+            const Result& r = results__[i];
+
+            std::printf("%s\n    {\n", i ? "," : "");
+            std::printf("      \"name\": \"%s\",\n", r.name.c_str());
+            std::printf("      \"iterations\": %zu,\n", r.iterations);
+            std::printf("      \"real_time_ns\": %.1f,\n",
+                r.seconds / r.iterations * 1e9);
+            std::printf("      \"items_per_second\": %.1f",
+                r.items / r.seconds);
+
+            if (r.epochs > 0) {
+                std::printf(",\n      \"epochs_per_second\": %.3f",
+                    r.epochs / r.seconds);
+            }
+
+            std::printf("\n    }");
+        }
+
+        std::printf("\n  ]\n}\n");
+    }
+
+    const Options& GetOptions() const {
+        return options__;
+    }
+private:
+    Options             options__;
+    std::vector<Result> results__;
+};
+
+template<typename Scalar>
+void BenchForward(Runner& runner, const std::string& suffix,
+        netz::BasicNetzwerk<Scalar> netz,
+        const netz::BasicDataset<Scalar>& data) {
+    size_t row = 0;
+
+    // Соседние образцы различаются во многих входах, так что это
+    // полный проход по сети, а не инкрементальный
+    runner.Measure("forward/" + suffix, 0, [&] {
+        netz.SetInputs(data.inputs.Row(row));
+        netz.GetOuputs();
+        row = (row + 1) % data.Size();
+        return 1.0;
+    });
+
+    // Тот же проход по CompiledModel: по числу на пиксель и по биту,
+    // когда первый слой складывает веса черных пикселей без умножений
+    const netz::BasicCompiledModel<Scalar> model(netz);
+    netz::BasicInferenceContext<Scalar> context;
+    std::vector<netz::PackedBitmap> bitmaps;
+
+    for (size_t i = 0; i < data.Size(); i++) {
+        bitmaps.push_back(netz::PackedBitmap::FromPixels(data.inputs.Row(i),
+            data.inputs.cols));
+    }
+
+    runner.Measure("forward_compiled/" + suffix, 0, [&] {
+        model.GetOutputs(data.inputs.Row(row), context);
+        row = (row + 1) % data.Size();
+        return 1.0;
+    });
+
+    runner.Measure("forward_bitmap/" + suffix, 0, [&] {
+        model.GetOutputs(bitmaps[row], context);
+        row = (row + 1) % data.Size();
+        return 1.0;
+    });
+
+    for (size_t batch_size : BATCH_SIZES) {
+        netz::BasicMatrix<Scalar> batch(batch_size, data.inputs.cols);
+        std::copy(data.inputs.data.begin(),
+            data.inputs.data.begin() + batch.data.size(), batch.data.begin());
+
+        runner.Measure("forward_batch/" + suffix + "/batch:"
+                + std::to_string(batch_size), 0, [&] {
+            netz.GetOutputsBatch(batch);
+            return double(batch_size);
+        });
+    }
+}
+
+template<typename Scalar>
+void BenchAdjustWeights(Runner& runner, const std::string& suffix,
+        const netz::BasicNetzwerk<Scalar>& initial,
+        const netz::BasicDataset<Scalar>& data) {
+    for (size_t batch_size : BATCH_SIZES) {
+        netz::BasicNetzwerk<Scalar> netz = initial;
+        std::vector<Scalar> expected(data.expected.cols);
+        size_t row = 0;
+
+        netz.SetBatchSize(batch_size);
+
+        runner.Measure("adjust_weights/" + suffix + "/batch:"
+                + std::to_string(batch_size), 0, [&] {
+            const Scalar *e = data.expected.Row(row);
+            expected.assign(e, e + data.expected.cols);
+
+            netz.SetInputs(data.inputs.Row(row));
+            netz.GetOuputs();
+            netz.AdjustWeights(ALPHA, expected);
+
+            row = (row + 1) % data.Size();
+            return 1.0;
+        });
+    }
+}
+
+template<typename Scalar>
+void BenchEpoch(Runner& runner, const std::string& suffix,
+        const netz::BasicNetzwerk<Scalar>& initial,
+        const netz::BasicDataset<Scalar>& data) {
+    const size_t threads = runner.GetOptions().threads;
+
+    for (size_t batch_size : BATCH_SIZES) {
+        netz::BasicNetzwerk<Scalar> netz = initial;
+        netz.SetBatchSize(batch_size);
+
+        netz::BasicParallelTrainer<Scalar> trainer(netz, threads);
+        trainer.SetBatchSize(batch_size);
+
+        runner.Measure("epoch/" + suffix + "/batch:"
+                + std::to_string(batch_size) + "/threads:"
+                + std::to_string(threads), 1, [&] {
+            trainer.TrainEpoch(data, ALPHA);
+            return double(data.Size());
+        });
+    }
+}
+
+template<typename Scalar>
+void BenchModelIo(Runner& runner, const std::string& suffix,
+        const netz::BasicNetzwerk<Scalar>& netz) {
+    std::ostringstream text_out;
+    std::ostringstream binary_out;
+
+    netz.DumpStructure(text_out);
+    netz.DumpBinary(binary_out);
+
+    const std::string text = text_out.str();
+    const std::string binary = binary_out.str();
+
+    runner.Measure("dump_text/" + suffix, 0, [&] {
+        std::ostringstream out;
+        netz.DumpStructure(out);
+        return double(text.size());
+    });
+
+    runner.Measure("load_text/" + suffix, 0, [&] {
+        std::istringstream in(text);
+        netz::BasicNetzwerk<Scalar>::ReadStructure(in);
+        return double(text.size());
+    });
+
+    runner.Measure("dump_binary/" + suffix, 0, [&] {
+        std::ostringstream out;
+        netz.DumpBinary(out);
+        return double(binary.size());
+    });
+
+    runner.Measure("load_binary/" + suffix, 0, [&] {
+        std::istringstream in(binary);
+        netz::BasicNetzwerk<Scalar>::ReadBinary(in);
+        return double(binary.size());
+    });
+}
+
+template<typename Scalar>
+void BenchTopology(Runner& runner, const std::vector<size_t>& topology) {
+    const std::string suffix = std::string(ScalarName<Scalar>()) + "/"
+        + TopologyName(topology);
+    const netz::BasicNetzwerk<Scalar> netz = MakeNetwork<Scalar>(topology);
+    const netz::BasicDataset<Scalar> data = MakeDataset<Scalar>(topology[0],
+        topology.back());
+
+    BenchForward(runner, suffix, netz, data);
+    BenchAdjustWeights(runner, suffix, netz, data);
+    BenchEpoch(runner, suffix, netz, data);
+    BenchModelIo(runner, suffix, netz);
+}
+
+// Двоичный формат сверток не хранит, так что замеры dump и load здесь
+// не делаются
+template<typename Scalar>
+void BenchConvTopology(Runner& runner, const ConvTopology& topology) {
+    const netz::ConvShape& shape = topology.shape;
+    const std::string suffix = std::string(ScalarName<Scalar>()) + "/"
+        + std::to_string(shape.InputSize()) + "-conv"
+        + std::to_string(shape.filters) + "x" + std::to_string(shape.kernel)
+        + "-pool" + std::to_string(shape.pool) + "-"
+        + TopologyName(topology.layers);
+    const netz::BasicNetzwerk<Scalar> netz =
+        MakeConvNetwork<Scalar>(topology);
+    const netz::BasicDataset<Scalar> data = MakeDataset<Scalar>(
+        shape.InputSize(), topology.layers.back());
+
+    BenchForward(runner, suffix, netz, data);
+    BenchAdjustWeights(runner, suffix, netz, data);
+    BenchEpoch(runner, suffix, netz, data);
+}
+
+void PrintHelp(const char *name) {
+    std::fprintf(stderr, "Usage: %s [--filter substring] [--min-time seconds]"
+        " [--threads n]\n", name);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && std::strcmp(argv[i], "--filter") == 0) {
+            options.filter = argv[++i];
+        } else if (i + 1 < argc && std::strcmp(argv[i], "--min-time") == 0) {
+            options.min_time = std::strtod(argv[++i], nullptr);
+        } else if (i + 1 < argc && std::strcmp(argv[i], "--threads") == 0) {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            PrintHelp(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.threads == 0) {
+        PrintHelp(argv[0]);
+        return 1;
+    }
+
+    Runner runner(options);
+
+    for (const std::vector<size_t>& topology : TOPOLOGIES) {
+        BenchTopology<float>(runner, topology);
+        BenchTopology<double>(runner, topology);
+    }
+
+    for (const ConvTopology& topology : CONV_TOPOLOGIES) {
+        BenchConvTopology<float>(runner, topology);
+        BenchConvTopology<double>(runner, topology);
+    }
+
+    runner.Report();
+
+    return 0;
+}
@@ -1,119 +1,474 @@
 #pragma once
-#include <functional>
+#include <algorithm>
 #include <initializer_list>
 #include <vector>
 #include "netz_formulas.hpp"
+#include "netz_simd.hpp"
 
+// Сеть, слой и матрица параметризованы типом числа. Netzwerk - сеть на
+// double, NetzwerkF - на float: вдвое больше элементов на векторный
+// регистр, вдвое меньше памяти, и те же веса, что у netzp (fp_t = float).
+// Реализация инстанцируется явно для float и double в .cpp.
 namespace netz {
-    class Netzwerk;
-    class Neuron;
-    using Layer = std::vector<netz::Neuron>;
+    template<typename Scalar> class BasicNetzwerk;
+    template<typename Scalar> class BasicLayer;
+    template<typename Scalar> class BasicConvLayer;
+    template<typename Scalar> struct BasicMatrix;
+    struct ConvShape;
+
+    using Netzwerk      = BasicNetzwerk<double>;
+    using Layer         = BasicLayer<double>;
+    using ConvLayer     = BasicConvLayer<double>;
+    using Matrix        = BasicMatrix<double>;
+
+    using NetzwerkF     = BasicNetzwerk<float>;
+    using LayerF        = BasicLayer<float>;
+    using ConvLayerF    = BasicConvLayer<float>;
+    using MatrixF       = BasicMatrix<float>;
+
+    // Прямой проход полносвязного слоя по пакету образцов: weights -
+    // матрица size x input_size, строка outputs - выходы слоя на строке
+    // inputs. Общий для Layer и моделей, отображенных в память.
+    template<typename Scalar>
+    void ForwardDense(const Scalar *weights, size_t size, size_t input_size,
+        math::activation::Kind activation, const BasicMatrix<Scalar>& inputs,
+        BasicMatrix<Scalar>& outputs);
+
+    // Прямой проход сверточного слоя по пакету образцов, weights -
+    // ядра фильтров подряд. scratch - рабочий буфер вызывающего, он
+    // только растет, так что повторные вызовы не выделяют память.
+    template<typename Scalar>
+    void ForwardConv(const Scalar *weights, const ConvShape& shape,
+        math::activation::Kind activation, const BasicMatrix<Scalar>& inputs,
+        BasicMatrix<Scalar>& outputs, std::vector<Scalar>& scratch);
 }
 
-class netz::Netzwerk {
+// Матрица с построчным хранением. В пакетном режиме одна строка - один
+// образец.
+template<typename Scalar>
+struct netz::BasicMatrix {
+    size_t              rows = 0;
+    size_t              cols = 0;
+    std::vector<Scalar> data;
+
+    BasicMatrix() = default;
+    BasicMatrix(size_t rows, size_t cols);
+
+    Scalar *Row(size_t r);
+    const Scalar *Row(size_t r) const;
+};
+
+// Форма сверточного слоя. Вход - channels карт height x width, карта за
+// картой, каждая построчно. Каждый из filters фильтров - ядро kernel x
+// kernel по всем каналам, свертка идет с шагом 1 без дополнения краев.
+// Затем из каждого квадрата pool x pool карты берется максимум (при
+// pool = 1 пулинга нет, неполные квадраты у края отбрасываются). Выход -
+// filters карт OutputHeight x OutputWidth, так что следующий слой
+// получает их как каналы.
+struct netz::ConvShape {
+    size_t  channels = 1;
+    size_t  height = 0;
+    size_t  width = 0;
+    size_t  filters = 1;
+    size_t  kernel = 3;
+    size_t  pool = 1;
+
+    size_t InputSize() const {
+        return channels * height * width;
+    }
+
+    size_t ConvHeight() const {
+        return height - kernel + 1;
+    }
+
+    size_t ConvWidth() const {
+        return width - kernel + 1;
+    }
+
+    // Число положений ядра на карте
+    size_t Positions() const {
+        return ConvHeight() * ConvWidth();
+    }
+
+    // Число весов одного фильтра
+    size_t PatchSize() const {
+        return channels * kernel * kernel;
+    }
+
+    size_t OutputHeight() const {
+        return ConvHeight() / pool;
+    }
+
+    size_t OutputWidth() const {
+        return ConvWidth() / pool;
+    }
+
+    size_t OutputSize() const {
+        return filters * OutputHeight() * OutputWidth();
+    }
+
+    bool IsValid() const {
+        return channels > 0 && filters > 0 && kernel > 0 && pool > 0
+            && kernel <= height && kernel <= width
+            && pool <= ConvHeight() && pool <= ConvWidth();
+    }
+};
+
+// Сверточные слои, если они есть, идут между входами и полносвязными
+// слоями: AddConvolution вызывается после всех AddInput и до первого
+// AddLayer. Выходом сети всегда остается полносвязный слой.
+template<typename Scalar>
+class netz::BasicNetzwerk {
 public:
-    Netzwerk() = default;
-    Netzwerk(std::initializer_list<double> inputs,
+    using Layer     = BasicLayer<Scalar>;
+    using ConvLayer = BasicConvLayer<Scalar>;
+    using Matrix    = BasicMatrix<Scalar>;
+
+    BasicNetzwerk() = default;
+    BasicNetzwerk(std::initializer_list<Scalar> inputs,
         std::initializer_list<size_t> layer_sizes);
 
-    Netzwerk& AddInput(double input);
-    Netzwerk& AddLayer(size_t s);
+    BasicNetzwerk& AddInput(Scalar input);
+    BasicNetzwerk& AddLayer(size_t s, math::activation::Kind activation
+        = math::activation::Kind::SIGMA);
 
-    Netzwerk& SetInput(size_t index, double input);
-    double GetInput(size_t index) const;
+    template<typename Activation>
+    BasicNetzwerk& AddLayer(size_t s) {
+        return AddLayer(s, Activation::KIND);
+    }
+
+    // Форма входа shape должна совпадать с выходом предыдущего
+    // сверточного слоя или, для первого, с числом входов сети
+    BasicNetzwerk& AddConvolution(const ConvShape& shape,
+        math::activation::Kind activation = math::activation::Kind::SIGMA);
+
+    BasicNetzwerk& SetInput(size_t index, Scalar input);
+    BasicNetzwerk& SetInputs(const Scalar *inputs);
+    Scalar GetInput(size_t index) const;
+
+    // При размере пакета 1 (по умолчанию) веса меняются после каждого
+    // образца. При большем размере AdjustWeights только копит градиент,
+    // а веса меняются раз в batch_size образцов на суммарный градиент
+    // пакета, так что alpha по-прежнему действует на каждый образец.
+    BasicNetzwerk& SetBatchSize(size_t batch_size);
+    size_t GetBatchSize() const;
 
     template<typename NumberContainer>
     void AdjustWeights(double alpha, const NumberContainer& expected_values);
 
-    std::vector<double> GetOuputs();
+    // Применяет накопленный градиент неполного пакета, например в конце
+    // эпохи.
+    BasicNetzwerk& ApplyGradients(double alpha);
+
+    // Только добавляет градиент текущего образца в буферы слоев, не
+    // трогая веса и счетчик пакета. Сведение градиентов - забота
+    // вызывающего (см. ParallelTrainer).
+    template<typename NumberContainer>
+    void AccumulateGradients(const NumberContainer& expected_values);
 
+    // Копирует веса сети той же топологии
+    BasicNetzwerk& CopyWeights(const BasicNetzwerk& other);
+
+    // Веса, измененные напрямую через GetLayer, учитываются только после
+    // Invalidate.
+    BasicNetzwerk& Invalidate();
+
+    size_t LayersCount() const;
+    Layer& GetLayer(size_t k);
+    const Layer& GetLayer(size_t k) const;
+
+    size_t ConvLayersCount() const;
+    ConvLayer& GetConvLayer(size_t k);
+    const ConvLayer& GetConvLayer(size_t k) const;
+
+    // Число входов сети
+    size_t InputCount() const;
+
+    std::vector<Scalar> GetOuputs();
+    Matrix GetOutputsBatch(const Matrix& inputs) const;
+
+    // Веса пишутся с точностью max_digits10 для Scalar, так что
+    // ReadStructure (и разбор в netzp) восстанавливает их без потерь
     std::ostream& DumpWeights(std::ostream& out) const;
     std::ostream& DumpStructure(std::ostream& out) const;
 
-    Netzwerk& ReadWeights(std::istream& in);
-    static netz::Netzwerk ReadStructure(std::istream& in);
+    // Двоичный формат, см. netz_binary.hpp. Поток должен быть открыт в
+    // режиме std::ios::binary.
+    std::ostream& DumpBinary(std::ostream& out) const;
+
+    BasicNetzwerk& ReadWeights(std::istream& in);
+    static BasicNetzwerk ReadStructure(std::istream& in);
+    static BasicNetzwerk ReadBinary(std::istream& in);
 private:
     void Update();
+    template<typename NumberContainer>
+    void Backpropagate(double alpha, const NumberContainer& expected_values,
+        bool online);
+    const Scalar *LayerInputs(size_t k) const;
+    // Число входов первого полносвязного слоя
+    size_t FeatureCount() const;
+
+    // Инкрементальный проход допускается, если изменилось не больше
+    // 1/INCREMENTAL_MAX_SHARE входов
+    static constexpr size_t INCREMENTAL_MAX_SHARE = 4;
+    static constexpr size_t INCREMENTAL_REFRESH = 256;
 
+    std::vector<ConvLayer>	conv__;
     std::vector<Layer>	layers__;
-    std::vector<double>	inputs__;
+    std::vector<Scalar>	inputs__;
+    size_t		batch_size__ = 1;
+    size_t		batch_count__ = 0;
     mutable bool		needs_recalculation__ = true;
+
+    // Состояние инкрементального прохода: входы, по которым посчитаны
+    // суммы первого слоя, и признак того, что веса или топология
+    // менялись после последнего полного прохода
+    std::vector<Scalar>	forward_inputs__;
+    bool		weights_changed__ = true;
+    size_t		incremental_passes__ = 0;
+    std::vector<size_t>	changed_inputs__;
+    std::vector<Scalar>	input_deltas__;
 };
 
-class netz::Neuron {
+// Полносвязный слой. Веса всех нейронов слоя хранятся одной матрицей
+// size x input_size (строка на нейрон), выходы - одним буфером, так что
+// прямой проход по слою - это умножение матрицы на вектор.
+template<typename Scalar>
+class netz::BasicLayer {
 public:
-    Neuron() = delete;
-    explicit Neuron(std::function<double(double)> activation_func)
-        : activation_func__(activation_func) {}
-
-    Neuron& AddInput(double input);
-    Neuron& SetInput(size_t index, double input);
-    Neuron& SetWeight(size_t index, double weight);
-    Neuron& ResetInputs();
-    double GetInput(size_t index) const;
-    double GetWeight(size_t index) const;
-    double GetOutput() const;
+    using Matrix = BasicMatrix<Scalar>;
+
+    BasicLayer() = delete;
+    BasicLayer(size_t size, size_t input_size,
+        math::activation::Kind activation = math::activation::Kind::SIGMA);
+
+    BasicLayer& AddInput();
+    BasicLayer& SetWeight(size_t neuron, size_t index, Scalar weight);
+    Scalar GetWeight(size_t neuron, size_t index) const;
+    Scalar GetOutput(size_t neuron) const;
+    size_t Size() const;
     size_t InputSize() const;
+    math::activation::Kind GetActivation() const;
+
+    Scalar *Weights(size_t neuron);
+    const Scalar *Weights(size_t neuron) const;
+    const std::vector<Scalar>& Outputs() const;
+
+    Scalar *Deltas();
+    const Scalar *Deltas() const;
+    Scalar *Gradients(size_t neuron);
+    const Scalar *Gradients(size_t neuron) const;
+    BasicLayer& ApplyGradients(double scale);
+    BasicLayer& CopyWeights(const BasicLayer& other);
+
+    // Умножает deltas на производную функции активации в точке
+    // последнего прямого прохода
+    void ApplyDerivative(Scalar *deltas) const;
+
+    void Forward(const Scalar *inputs);
+    void ForwardBatch(const Matrix& inputs, Matrix& outputs) const;
+
+    // Поправляет суммы последнего прохода на изменение count входов:
+    // входу indices[c] добавилось deltas[c]
+    void ForwardDelta(const size_t *indices, const Scalar *deltas,
+        size_t count);
 private:
-    std::vector<double>             inputs__;
-    std::vector<double>             weights__;
-    std::function<double(double)>	activation_func__;
-    mutable double                  output__;
-    mutable bool                    needs_recalculation__ = true;
+    template<typename Activation>
+    void ForwardImpl(const Scalar *inputs);
+
+    size_t                  size__;
+    size_t                  input_size__;
+    math::activation::Kind  activation__;
+    std::vector<Scalar>     weights__;
+    std::vector<Scalar>     sums__;
+    std::vector<Scalar>     outputs__;
+
+    // Буферы обучения, выделяются вместе с весами
+    std::vector<Scalar> deltas__;
+    std::vector<Scalar> gradients__;
 };
 
+// Сверточный слой с необязательным max pooling. Прямой проход идет через
+// im2col: окна входа раскладываются в матрицу PatchSize x Positions
+// (строка - один вес ядра во всех положениях), и свертка становится
+// произведением матрицы ядер filters x PatchSize на нее. Внутренний цикл
+// - Axpy по длинной строке положений, а не скалярное произведение по
+// ядру из 9 чисел. Обратный проход использует ту же матрицу окон, так
+// что градиент ядра - скалярное произведение дельт карты на ее строку.
+template<typename Scalar>
+class netz::BasicConvLayer {
+public:
+    using Matrix = BasicMatrix<Scalar>;
+
+    BasicConvLayer() = delete;
+    BasicConvLayer(const ConvShape& shape,
+        math::activation::Kind activation = math::activation::Kind::SIGMA);
+
+    const ConvShape& Shape() const;
+    // Число выходов, то есть Shape().OutputSize()
+    size_t Size() const;
+    math::activation::Kind GetActivation() const;
+
+    // Ядро фильтра, PatchSize весов: канал за каналом, построчно
+    Scalar *Weights(size_t filter);
+    const Scalar *Weights(size_t filter) const;
+    Scalar *Gradients(size_t filter);
+    const Scalar *Gradients(size_t filter) const;
+    const std::vector<Scalar>& Outputs() const;
+
+    // Дельты выходов (после пулинга), их заполняет следующий слой
+    Scalar *Deltas();
+    const Scalar *Deltas() const;
+
+    BasicConvLayer& ApplyGradients(double scale);
+    BasicConvLayer& CopyWeights(const BasicConvLayer& other);
+
+    void Forward(const Scalar *inputs);
+    void ForwardBatch(const Matrix& inputs, Matrix& outputs) const;
+
+    // Обратный проход по Deltas() и последнему прямому проходу. В
+    // онлайн-режиме веса сразу сдвигаются на alpha * градиент, иначе
+    // градиент копится. Если input_deltas не nullptr, к ним добавляются
+    // дельты входов слоя, посчитанные по весам до изменения.
+    void Backward(double alpha, bool online, Scalar *input_deltas);
+private:
+    ConvShape               shape__;
+    math::activation::Kind  activation__;
+    std::vector<Scalar>     weights__;
+    // Матрица окон, суммы и карты после активации последнего прохода
+    std::vector<Scalar>     patches__;
+    std::vector<Scalar>     sums__;
+    std::vector<Scalar>     maps__;
+    std::vector<Scalar>     outputs__;
+    // Для каждого выхода - индекс максимума в maps__
+    std::vector<size_t>     argmax__;
+
+    // Буферы обучения
+    std::vector<Scalar>     deltas__;
+    std::vector<Scalar>     map_deltas__;
+    std::vector<Scalar>     patch_deltas__;
+    std::vector<Scalar>     gradients__;
+};
+
+namespace netz {
+    extern template struct BasicMatrix<float>;
+    extern template struct BasicMatrix<double>;
+    extern template class BasicLayer<float>;
+    extern template class BasicLayer<double>;
+    extern template class BasicConvLayer<float>;
+    extern template class BasicConvLayer<double>;
+    extern template class BasicNetzwerk<float>;
+    extern template class BasicNetzwerk<double>;
+
+    extern template void ForwardDense(const float *, size_t, size_t,
+        math::activation::Kind, const BasicMatrix<float>&,
+        BasicMatrix<float>&);
+    extern template void ForwardDense(const double *, size_t, size_t,
+        math::activation::Kind, const BasicMatrix<double>&,
+        BasicMatrix<double>&);
+    extern template void ForwardConv(const float *, const ConvShape&,
+        math::activation::Kind, const BasicMatrix<float>&,
+        BasicMatrix<float>&, std::vector<float>&);
+    extern template void ForwardConv(const double *, const ConvShape&,
+        math::activation::Kind, const BasicMatrix<double>&,
+        BasicMatrix<double>&, std::vector<double>&);
+}
+
+template<typename Scalar>
 template<typename NumberContainer>
-void netz::Netzwerk::AdjustWeights(double alpha,
+void netz::BasicNetzwerk<Scalar>::AdjustWeights(double alpha,
         const NumberContainer& expected_values) {
-    Layer *next_layer = &layers__.back();
-
-    std::vector<double> deltas_next;
+    const bool online = batch_size__ == 1;
 
-    // Сначала отдельно расчитывается дельта для последнего слоя
-    for (size_t i = 0; i < next_layer->size(); i++) {
-        Neuron& n = next_layer->at(i);
-        double delta = math::DeltaCoeffLastLayer(expected_values.at(i),
-            n.GetOutput());
+    Backpropagate(alpha, expected_values, online);
 
-        for (size_t j = 0; j < n.InputSize(); j++) {
-            double new_weight = n.GetWeight(j)
-                    + alpha * delta * n.GetInput(j);
+    if (online) {
+        needs_recalculation__ = true;
+        weights_changed__ = true;
+    } else if (++batch_count__ == batch_size__) {
+        ApplyGradients(alpha);
+    }
+}
 
-            n.SetWeight(j, new_weight);
-        }
+template<typename Scalar>
+template<typename NumberContainer>
+void netz::BasicNetzwerk<Scalar>::AccumulateGradients(
+        const NumberContainer& expected_values) {
+    Backpropagate(0.0, expected_values, false);
+}
 
-        deltas_next.push_back(delta);
+template<typename Scalar>
+template<typename NumberContainer>
+void netz::BasicNetzwerk<Scalar>::Backpropagate(double alpha,
+        const NumberContainer& expected_values, bool online) {
+    if (needs_recalculation__) {
+        Update();
+        needs_recalculation__ = false;
     }
 
-    // Потом для всех остальных
-    for (auto iter = layers__.rbegin() + 1; iter != layers__.rend(); iter++) {
-        Layer& l = *iter;
-        std::vector<double> deltas;
-
-        for (size_t i = 0; i < l.size(); i++) {
-            Neuron& n = l.at(i);
-            std::vector<double> weights_next;
-            for (size_t k = 0; k < next_layer->size(); k++) {
-                const Neuron& n_next = next_layer->at(k);
-                weights_next.push_back(n_next.GetWeight(i));
-            }
+    // Слои обходятся с конца. Для последнего слоя дельта считается по
+    // ожидаемым значениям, для остальных - по дельтам следующего слоя.
+    // В онлайн-режиме веса слоя меняются сразу, в пакетном режиме
+    // градиент копится до ApplyGradients.
+    for (size_t k = layers__.size(); k-- > 0;) {
+        Layer& l = layers__[k];
+        Scalar *deltas = l.Deltas();
+        const Scalar *inputs = LayerInputs(k);
 
-            double delta = math::DeltaCoeffHiddenLayer(
-                n.GetOutput(), deltas_next,
-                weights_next);
+        if (k == layers__.size() - 1) {
+            for (size_t i = 0; i < l.Size(); i++) {
+                deltas[i] = static_cast<Scalar>(expected_values.at(i))
+                    - l.GetOutput(i);
+            }
+        } else {
+            // Сумма дельт следующего слоя, взвешенная по столбцу его
+            // матрицы, набирается проходом по строкам, чтобы читать веса
+            // последовательно.
+            const Layer& next_layer = layers__[k + 1];
+            const Scalar *deltas_next = next_layer.Deltas();
 
-            for (size_t j = 0; j < n.InputSize(); j++) {
-                double new_weight = n.GetWeight(j)
-                        + alpha * delta * n.GetInput(j);
-                n.SetWeight(j, new_weight);
+            std::fill(deltas, deltas + l.Size(), Scalar(0));
+            for (size_t n = 0; n < next_layer.Size(); n++) {
+                math::simd::Axpy(deltas_next[n], next_layer.Weights(n),
+                    deltas, l.Size());
             }
+        }
+
+        l.ApplyDerivative(deltas);
 
-            deltas.push_back(delta);
+        for (size_t i = 0; i < l.Size(); i++) {
+            if (online) {
+                math::simd::Axpy(static_cast<Scalar>(alpha * deltas[i]),
+                    inputs, l.Weights(i), l.InputSize());
+            } else {
+                math::simd::Axpy(deltas[i], inputs, l.Gradients(i),
+                    l.InputSize());
+            }
         }
+    }
+
+    if (conv__.empty()) return;
+
+    // Дельты выходов последней свертки набираются по первому
+    // полносвязному слою так же, как дельты скрытых слоев
+    const Layer& first = layers__.front();
+    Scalar *deltas = conv__.back().Deltas();
 
-        deltas_next = std::move(deltas);
-        next_layer = &l;
+    std::fill(deltas, deltas + conv__.back().Size(), Scalar(0));
+    for (size_t n = 0; n < first.Size(); n++) {
+        math::simd::Axpy(first.Deltas()[n], first.Weights(n), deltas,
+            conv__.back().Size());
     }
 
-    needs_recalculation__ = true;
-}
\ No newline at end of file
+    for (size_t c = conv__.size(); c-- > 0;) {
+        Scalar *input_deltas = nullptr;
+
+        if (c > 0) {
+            input_deltas = conv__[c - 1].Deltas();
+            std::fill(input_deltas, input_deltas + conv__[c - 1].Size(),
+                Scalar(0));
+        }
+
+        conv__[c].Backward(alpha, online, input_deltas);
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "netz_bitmap.hpp"
+#include "netz_shapes.hpp"
+#include "netz_spsc_queue.hpp"
+#include "netz_trainer.hpp"
+
+// Обучающие картинки, которые генерируются на лету: эталонные фигуры
+// поворачиваются, сдвигаются и зашумляются в отдельном потоке, а
+// обучение забирает их готовыми кусками. Выборка нигде не хранится и
+// не читается с диска.
+namespace netz {
+    template<typename Scalar> class BasicAugmentedStream;
+
+    using AugmentedStream   = BasicAugmentedStream<double>;
+    using AugmentedStreamF  = BasicAugmentedStream<float>;
+
+    struct AugmentOptions {
+        // Размер картинок, все фигуры должны быть этого размера
+        size_t      width = shapes::WIDTH;
+        size_t      height = shapes::HEIGHT;
+        // Вероятность инверсии каждого пикселя
+        double      noise = 0.1;
+        // Наибольший сдвиг по каждой оси. Фигура сдвигается только так,
+        // чтобы не выйти за край картинки.
+        size_t      max_shift = 1;
+        // Поворачивать ли фигуры на случайное число четвертей оборота.
+        // Только для квадратных картинок.
+        bool        rotate = false;
+        uint64_t    seed = 0;
+        size_t      chunk_size = 4096;
+        // Сколько кусков поток может приготовить впрок
+        size_t      queue_chunks = 4;
+    };
+}
+
+// Класс образца выбирается случайно, ожидаемые выходы - one-hot вектор
+// номера фигуры в bases. При том же seed поток картинок один и тот же.
+//
+// Куски переходят от генерирующего потока к обучению через очередь
+// без блокировок и возвращаются обратно через вторую, так что память
+// выделяется только при создании. Сторона, которой нечего взять из
+// очереди, засыпает на условной переменной до следующего куска, а не
+// крутится впустую. Next и деструктор вызываются из одного потока.
+template<typename Scalar>
+class netz::BasicAugmentedStream {
+public:
+    using Dataset = BasicDataset<Scalar>;
+
+    BasicAugmentedStream(std::vector<PackedBitmap> bases,
+        const AugmentOptions& options);
+    ~BasicAugmentedStream();
+
+    BasicAugmentedStream(const BasicAugmentedStream&) = delete;
+    BasicAugmentedStream& operator=(const BasicAugmentedStream&) = delete;
+
+    // Следующий кусок из chunk_size образцов. Ссылка действительна до
+    // следующего вызова: тогда кусок возвращается генерирующему потоку.
+    const Dataset& Next();
+
+    // Сколько раз Next ждал кусок. Если это происходит часто, обучение
+    // упирается в генерацию.
+    size_t Stalls() const;
+private:
+    void Produce();
+    void Fill(Dataset& chunk);
+    PackedBitmap Augment(const PackedBitmap& base);
+
+    std::vector<PackedBitmap>   bases__;
+    AugmentOptions              options__;
+    std::vector<Dataset>        chunks__;
+    SpscQueue<Dataset *>        ready__;
+    SpscQueue<Dataset *>        free__;
+    Dataset                    *current__ = nullptr;
+    size_t                      stalls__ = 0;
+    std::mt19937_64             gen__;
+    std::atomic<bool>           stop__{false};
+    // Только для ожидания: сами куски ходят через очереди
+    std::mutex                  mutex__;
+    std::condition_variable     chunk_ready__;
+    std::condition_variable     chunk_freed__;
+    std::thread                 producer__;
+};
+
+namespace netz {
+    extern template class BasicAugmentedStream<float>;
+    extern template class BasicAugmentedStream<double>;
+}
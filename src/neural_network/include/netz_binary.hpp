@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+#include "netz.hpp"
+#include "netz_compiled.hpp"
+
+// Двоичный формат модели. Файл целиком можно отобразить в память и
+// считать сеть прямо по нему, без разбора и копирования весов.
+//
+// [Header, 64 байта]
+// [LayerRecord x layer_count]
+// [веса слоя 0, построчно] [веса слоя 1] ...
+//
+// Блок весов каждого слоя начинается со смещения, кратного ALIGNMENT, а
+// размер файла дополняется нулями до кратного ALIGNMENT. checksum - хэш
+// FNV-1a по 8-байтным словам всего, что идет после заголовка. Числа
+// записываются в порядке байт машины (на x86 - little-endian).
+namespace netz::binary {
+
+constexpr char          MAGIC[8]    = { 'N', 'E', 'T', 'Z', 'M', 'D', 'L', 0 };
+constexpr uint32_t      VERSION     = 1;
+constexpr size_t        ALIGNMENT   = 64;
+
+struct Header {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    scalar_size;
+    uint32_t    input_count;
+    uint32_t    layer_count;
+    uint64_t    file_size;
+    uint64_t    checksum;
+    uint8_t     reserved[24];
+};
+
+struct LayerRecord {
+    uint32_t    size;
+    uint32_t    input_size;
+    uint32_t    activation;
+    uint32_t    reserved;
+    uint64_t    offset;
+};
+
+static_assert(sizeof(Header) == ALIGNMENT, "Header must fill one block");
+static_assert(sizeof(LayerRecord) == 24, "LayerRecord must be packed");
+
+// true, если поток начинается с MAGIC. Позиция чтения не меняется.
+bool IsModel(std::istream& in);
+
+// Читает и проверяет заголовок (но не контрольную сумму)
+Header ReadHeader(std::istream& in);
+
+uint64_t Checksum(const void *data, size_t size);
+
+// Проверяет заголовок, таблицу слоев и контрольную сумму файла,
+// лежащего в памяти целиком. Возвращает таблицу слоев.
+const LayerRecord *Validate(const void *data, size_t size,
+    size_t scalar_size);
+
+} // namespace netz::binary
+
+namespace netz {
+    template<typename Scalar> class BasicMappedModel;
+
+    using MappedModel   = BasicMappedModel<double>;
+    using MappedModelF  = BasicMappedModel<float>;
+}
+
+// Модель только для вывода, веса которой читаются прямо из отображенного
+// в память файла. Тип числа в файле должен совпадать со Scalar. Как и
+// CompiledModel, модель не меняется после создания, и ее можно делить
+// между потоками, у каждого из которых свой InferenceContext.
+template<typename Scalar>
+class netz::BasicMappedModel {
+public:
+    using Matrix    = BasicMatrix<Scalar>;
+    using Context   = BasicInferenceContext<Scalar>;
+
+    explicit BasicMappedModel(const std::string& path);
+    ~BasicMappedModel();
+
+    BasicMappedModel(const BasicMappedModel&) = delete;
+    BasicMappedModel& operator=(const BasicMappedModel&) = delete;
+
+    size_t InputCount() const;
+    size_t OutputCount() const;
+    size_t LayersCount() const;
+
+    const Matrix& GetOutputsBatch(const Matrix& inputs,
+        Context& context) const;
+    Matrix GetOutputsBatch(const Matrix& inputs) const;
+private:
+    void                               *data__ = nullptr;
+    size_t                              size__ = 0;
+    size_t                              input_count__ = 0;
+    std::vector<DenseLayerView<Scalar>> layers__;
+};
+
+namespace netz {
+    extern template class BasicMappedModel<float>;
+    extern template class BasicMappedModel<double>;
+}
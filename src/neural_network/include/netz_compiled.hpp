@@ -0,0 +1,129 @@
+#pragma once
+#include <vector>
+#include "netz.hpp"
+#include "netz_bitmap.hpp"
+
+// Модели только для вывода, общие для нескольких потоков. Модель после
+// создания не меняется, все, что меняется при проходе, лежит в
+// InferenceContext. Константные методы модели можно вызывать из любого
+// числа потоков одновременно, если у каждого потока свой контекст.
+namespace netz {
+    template<typename Scalar> class BasicCompiledModel;
+    template<typename Scalar> class BasicInferenceContext;
+    template<typename Scalar> struct DenseLayerView;
+    template<typename Scalar> struct ConvLayerView;
+
+    using CompiledModel     = BasicCompiledModel<double>;
+    using InferenceContext  = BasicInferenceContext<double>;
+
+    using CompiledModelF    = BasicCompiledModel<float>;
+    using InferenceContextF = BasicInferenceContext<float>;
+
+    // Прямой проход по цепочке полносвязных слоев. Промежуточные
+    // выходы пишутся в буферы context, возвращается ссылка на выходы
+    // последнего слоя, действительная до следующего прохода с тем же
+    // контекстом.
+    template<typename Scalar>
+    const BasicMatrix<Scalar>& ForwardLayers(
+        const std::vector<DenseLayerView<Scalar>>& layers,
+        const BasicMatrix<Scalar>& inputs,
+        BasicInferenceContext<Scalar>& context);
+}
+
+// Слой, веса которого лежат в чужом буфере: в CompiledModel или в
+// отображенном в память файле
+template<typename Scalar>
+struct netz::DenseLayerView {
+    size_t                  size;
+    size_t                  input_size;
+    math::activation::Kind  activation;
+    const Scalar           *weights;
+};
+
+template<typename Scalar>
+struct netz::ConvLayerView {
+    ConvShape               shape;
+    math::activation::Kind  activation;
+    const Scalar           *weights;
+};
+
+// Буферы одного потока. Память выделяется на первом проходе и дальше
+// только растет с размером пакета, так что повторные вызовы с пакетами
+// того же размера не выделяют память.
+template<typename Scalar>
+class netz::BasicInferenceContext {
+public:
+    using Matrix = BasicMatrix<Scalar>;
+
+    BasicInferenceContext() = default;
+private:
+    template<typename S>
+    friend const BasicMatrix<S>& ForwardLayers(
+        const std::vector<DenseLayerView<S>>& layers,
+        const BasicMatrix<S>& inputs, BasicInferenceContext<S>& context);
+    friend class BasicCompiledModel<Scalar>;
+
+    Matrix              sample__;
+    Matrix              buffers__[2];
+    // Выходы сверток и рабочий буфер ForwardConv
+    Matrix              conv__[2];
+    std::vector<Scalar> scratch__;
+};
+
+// Неизменяемая копия весов сети. Веса всех слоев лежат одним буфером,
+// слой за слоем, в том же порядке, что и в BasicLayer, сначала ядра
+// сверток, потом полносвязные слои.
+template<typename Scalar>
+class netz::BasicCompiledModel {
+public:
+    using Matrix    = BasicMatrix<Scalar>;
+    using Context   = BasicInferenceContext<Scalar>;
+
+    explicit BasicCompiledModel(const BasicNetzwerk<Scalar>& netz);
+
+    // Слои указывают в собственный буфер весов. При перемещении буфер
+    // переезжает вместе с указателями, а копия указывала бы в чужой.
+    BasicCompiledModel(const BasicCompiledModel&) = delete;
+    BasicCompiledModel& operator=(const BasicCompiledModel&) = delete;
+    BasicCompiledModel(BasicCompiledModel&&) = default;
+    BasicCompiledModel& operator=(BasicCompiledModel&&) = default;
+
+    size_t InputCount() const;
+    size_t OutputCount() const;
+    size_t LayersCount() const;
+
+    // Выходы на одном образце из InputCount чисел. Указатель на
+    // OutputCount выходов действителен до следующего вызова с context.
+    const Scalar *GetOutputs(const Scalar *inputs, Context& context) const;
+
+    // То же на черно-белой картинке. Если первый слой полносвязный, его
+    // суммы считаются без умножений, как суммы весов черных пикселей.
+    const Scalar *GetOutputs(const PackedBitmap& bitmap,
+        Context& context) const;
+    const Matrix& GetOutputsBatch(const Matrix& inputs,
+        Context& context) const;
+
+    // То же с временным контекстом, для разовых вызовов
+    Matrix GetOutputsBatch(const Matrix& inputs) const;
+private:
+    const Matrix& Forward(const Matrix& inputs, Context& context) const;
+
+    size_t                              input_count__;
+    std::vector<Scalar>                 weights__;
+    std::vector<ConvLayerView<Scalar>>  conv__;
+    std::vector<DenseLayerView<Scalar>> layers__;
+};
+
+namespace netz {
+    extern template class BasicInferenceContext<float>;
+    extern template class BasicInferenceContext<double>;
+    extern template class BasicCompiledModel<float>;
+    extern template class BasicCompiledModel<double>;
+
+    extern template const BasicMatrix<float>& ForwardLayers(
+        const std::vector<DenseLayerView<float>>&,
+        const BasicMatrix<float>&, BasicInferenceContext<float>&);
+    extern template const BasicMatrix<double>& ForwardLayers(
+        const std::vector<DenseLayerView<double>>&,
+        const BasicMatrix<double>&, BasicInferenceContext<double>&);
+}
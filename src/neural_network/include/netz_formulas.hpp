@@ -1,9 +1,12 @@
 #pragma once
-#include <functional>
+#include <algorithm>
+#include <cmath>
 #include <numeric>
-#include <execution>
 #include <stdexcept>
 #include <sstream>
+#include <type_traits>
+#include <vector>
+#include "netz_simd.hpp"
 
 // Пространство имен нейронной сети
 namespace netz {
@@ -13,6 +16,23 @@ namespace netz {
 
 const std::string ERR_MSG_INDEX_OOB = "Index out of bounds!";
 const std::string ERR_MSG_SIZES_DIFFER = "Candidates sizes differ!";
+const std::string ERR_MSG_BATCH_SIZE = "Batch size must be positive!";
+const std::string ERR_MSG_SYNC_INTERVAL = "Sync interval must be positive!";
+const std::string ERR_MSG_THREAD_COUNT = "Thread count must be positive!";
+const std::string ERR_MSG_UNKNOWN_ACTIVATION = "Unknown activation function!";
+const std::string ERR_MSG_MODEL_FORMAT = "Not a netz model file!";
+const std::string ERR_MSG_MODEL_VERSION = "Unsupported model version!";
+const std::string ERR_MSG_MODEL_SCALAR = "Model number type differs!";
+const std::string ERR_MSG_MODEL_CHECKSUM = "Model checksum mismatch!";
+const std::string ERR_MSG_MODEL_IO = "Could not map model file!";
+const std::string ERR_MSG_EMPTY_MODEL = "Model has no layers!";
+const std::string ERR_MSG_DATASET_LABEL = "Dataset label out of range!";
+const std::string ERR_MSG_EMPTY_AUGMENT = "No shapes or empty chunks!";
+const std::string ERR_MSG_CONV_SHAPE = "Invalid convolution shape!";
+const std::string ERR_MSG_CONV_ORDER =
+    "Convolutions go after the inputs and before dense layers!";
+const std::string ERR_MSG_CONV_BINARY =
+    "Binary models hold dense layers only!";
 
 inline std::string ErrMsgImpl(const std::string& func_name,
         const std::string& msg) {
@@ -34,6 +54,21 @@ template<typename NumberContainer>
 double ErrorEstimation(const NumberContainer& expected_values,
         const NumberContainer& output_values);
 
+// Средний квадрат ошибки по выходам
+template<typename NumberContainer>
+double MeanSquaredError(const NumberContainer& expected_values,
+        const NumberContainer& output_values);
+
+// Бинарная перекрестная энтропия, усредненная по выходам: каждый
+// сигмоидный выход - отдельная вероятность. Выходы прижимаются к
+// [CROSS_ENTROPY_EPSILON, 1 - CROSS_ENTROPY_EPSILON], чтобы не брать
+// логарифм нуля.
+constexpr double CROSS_ENTROPY_EPSILON = 1e-7;
+
+template<typename NumberContainer>
+double CrossEntropy(const NumberContainer& expected_values,
+        const NumberContainer& output_values);
+
 double DeltaCoeffLastLayer(double expected_value,
         double output_value) noexcept;
 
@@ -55,8 +90,132 @@ double Sigma(double x) noexcept;
 
 double SigmaMirrored(double x) noexcept;
 
+double ReLU(double x) noexcept;
+
+double Tanh(double x) noexcept;
+
 } // netz::math::actfunc
 
+// Политики активации для слоев. Apply - сама функция, Derivative -
+// ее производная по взвешенной сумме x при уже посчитанном выходе
+// y = Apply(x), ApplyAll - функция над массивом (x и y могут совпадать).
+// Слой хранит только Kind, а ядра прямого и обратного
+// прохода инстанцируются для каждой политики отдельно, так что функция
+// встраивается в цикл, а выбор делается один раз на слой. Функции
+// шаблонные по типу числа, чтобы одни политики служили float и double.
+namespace netz::math::activation {
+
+enum class Kind {
+    SIGMA,
+    SIGMA_MIRRORED,
+    RELU,
+    TANH,
+};
+
+struct Sigma {
+    static constexpr Kind KIND = Kind::SIGMA;
+
+    template<typename T>
+    static T Apply(T x) noexcept {
+        return 1 / (1 + std::exp(-x));
+    }
+
+    template<typename T>
+    static T Derivative(T, T y) noexcept {
+        return y * (1 - y);
+    }
+
+    template<typename T>
+    static void ApplyAll(const T *x, T *y, size_t n) noexcept {
+        simd::Sigmoid(x, y, n);
+    }
+};
+
+struct SigmaMirrored {
+    static constexpr Kind KIND = Kind::SIGMA_MIRRORED;
+
+    template<typename T>
+    static T Apply(T x) noexcept {
+        return std::exp(x) / (1 + std::exp(-x));
+    }
+
+    template<typename T>
+    static T Derivative(T x, T y) noexcept {
+        return y * (2 - Sigma::Apply(x));
+    }
+
+    template<typename T>
+    static void ApplyAll(const T *x, T *y, size_t n) noexcept {
+        for (size_t i = 0; i < n; i++) {
+            y[i] = Apply(x[i]);
+        }
+    }
+};
+
+struct ReLU {
+    static constexpr Kind KIND = Kind::RELU;
+
+    template<typename T>
+    static T Apply(T x) noexcept {
+        return x > 0 ? x : T(0);
+    }
+
+    template<typename T>
+    static T Derivative(T x, T) noexcept {
+        return x > 0 ? T(1) : T(0);
+    }
+
+    template<typename T>
+    static void ApplyAll(const T *x, T *y, size_t n) noexcept {
+        for (size_t i = 0; i < n; i++) {
+            y[i] = Apply(x[i]);
+        }
+    }
+};
+
+struct Tanh {
+    static constexpr Kind KIND = Kind::TANH;
+
+    template<typename T>
+    static T Apply(T x) noexcept {
+        return std::tanh(x);
+    }
+
+    template<typename T>
+    static T Derivative(T, T y) noexcept {
+        return 1 - y * y;
+    }
+
+    template<typename T>
+    static void ApplyAll(const T *x, T *y, size_t n) noexcept {
+        for (size_t i = 0; i < n; i++) {
+            y[i] = Apply(x[i]);
+        }
+    }
+};
+
+// Вызывает func с объектом политики, соответствующей kind
+template<typename Func>
+decltype(auto) Visit(Kind kind, Func&& func) {
+    switch (kind) {
+        case Kind::SIGMA_MIRRORED:
+            return func(SigmaMirrored());
+        case Kind::RELU:
+            return func(ReLU());
+        case Kind::TANH:
+            return func(Tanh());
+        case Kind::SIGMA:
+        default:
+            return func(Sigma());
+    }
+}
+
+const char *KindName(Kind kind);
+
+Kind KindFromName(const std::string& name);
+
+} // namespace netz::math::activation
+
 template<typename NumberContainer>
 double netz::math::DotProduct(
         const NumberContainer& v1,
@@ -66,17 +225,39 @@ double netz::math::DotProduct(
         throw std::invalid_argument(ErrMsg(ERR_MSG_SIZES_DIFFER));
     }
 
+    if constexpr (std::is_same_v<NumberContainer, std::vector<double>>
+            || std::is_same_v<NumberContainer, std::vector<float>>) {
+        return simd::Dot(v1.data(), v2.data(), v1.size());
+    } else {
+        double result = 0.0;
+
+        for (size_t i = 0; i < v1.size(); i++) {
+            result += v1[i] * v2[i];
+        }
+
+        return result;
+    }
+}
+
+template<typename NumberContainer>
+double netz::math::ErrorEstimation(
+        const NumberContainer& expected_values,
+        const NumberContainer& output_values) {
+    if (expected_values.size() != output_values.size()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_SIZES_DIFFER));
+    }
+
     double result = 0.0;
 
-    for (size_t i = 0; i < v1.size(); i++) {
-        result += v1.at(i) * v2.at(i);
+    for (size_t i = 0; i < expected_values.size(); i++) {
+        result += expected_values[i] - output_values[i];
     }
 
     return result;
 }
 
 template<typename NumberContainer>
-double netz::math::ErrorEstimation(
+double netz::math::MeanSquaredError(
         const NumberContainer& expected_values,
         const NumberContainer& output_values) {
     if (expected_values.size() != output_values.size()) {
@@ -86,10 +267,33 @@ double netz::math::ErrorEstimation(
     double result = 0.0;
 
     for (size_t i = 0; i < expected_values.size(); i++) {
-        result += expected_values.at(i) - output_values.at(i);
+        const double error = expected_values[i] - output_values[i];
+        result += error * error;
     }
 
-    return result;
+    return expected_values.empty() ? 0.0 : result / expected_values.size();
+}
+
+template<typename NumberContainer>
+double netz::math::CrossEntropy(
+        const NumberContainer& expected_values,
+        const NumberContainer& output_values) {
+    if (expected_values.size() != output_values.size()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_SIZES_DIFFER));
+    }
+
+    double result = 0.0;
+
+    for (size_t i = 0; i < expected_values.size(); i++) {
+        const double expected = expected_values[i];
+        const double output = std::clamp<double>(output_values[i],
+            CROSS_ENTROPY_EPSILON, 1.0 - CROSS_ENTROPY_EPSILON);
+
+        result -= expected * std::log(output)
+            + (1.0 - expected) * std::log(1.0 - output);
+    }
+
+    return expected_values.empty() ? 0.0 : result / expected_values.size();
 }
 
 template<typename NumberContainer>
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Векторные ядра над непрерывными массивами float и double. Реализация
+// выбирается один раз, при первом вызове, по возможностям процессора:
+// AVX-512, AVX2 + FMA, SSE2 или скалярная. Переменная окружения
+// NETZ_SIMD (scalar, sse2, avx2, avx512) ограничивает выбор сверху,
+// например для сравнения производительности.
+namespace netz::math::simd {
+
+enum class Isa {
+    SCALAR,
+    SSE2,
+    AVX2,
+    AVX512,
+};
+
+Isa ActiveIsa();
+
+const char *IsaName(Isa isa);
+
+// Скалярное произведение x и y длины n
+double Dot(const double *x, const double *y, size_t n);
+float Dot(const float *x, const float *y, size_t n);
+
+// Четыре скалярных произведения с общим вектором w:
+// out[k] = (x_k, w). Строка весов читается один раз на четыре образца.
+void Dot4(const double *w, const double *x0, const double *x1,
+    const double *x2, const double *x3, size_t n, double *out);
+void Dot4(const float *w, const float *x0, const float *x1,
+    const float *x2, const float *x3, size_t n, float *out);
+
+// y += a * x
+void Axpy(double a, const double *x, double *y, size_t n);
+void Axpy(float a, const float *x, float *y, size_t n);
+
+// Сумма x[i] по тем i < n, для которых в bits установлен бит i (бит
+// i % 64 слова i / 64). Это скалярное произведение x на вектор из 0 и 1,
+// но без умножений: элементы отбираются маской.
+double MaskedSum(const double *x, const uint64_t *bits, size_t n);
+float MaskedSum(const float *x, const uint64_t *bits, size_t n);
+
+// y = 1 / (1 + exp(-x)), x и y могут совпадать
+void Sigmoid(const double *x, double *y, size_t n);
+void Sigmoid(const float *x, float *y, size_t n);
+
+} // namespace netz::math::simd
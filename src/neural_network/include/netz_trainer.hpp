@@ -0,0 +1,236 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "netz.hpp"
+#include "netz_dataset_file.hpp"
+
+namespace netz {
+    class WorkerPool;
+    template<typename Scalar> class BasicParallelTrainer;
+    template<typename Scalar> struct BasicDataset;
+    class EarlyStopping;
+    struct Metrics;
+
+    enum class TrainingMode {
+        SYNCHRONOUS,
+        ASYNCHRONOUS,
+    };
+
+    using ParallelTrainer   = BasicParallelTrainer<double>;
+    using Dataset           = BasicDataset<double>;
+
+    using ParallelTrainerF  = BasicParallelTrainer<float>;
+    using DatasetF          = BasicDataset<float>;
+
+    // Качество сети на выборке (см. Metrics)
+    template<typename Scalar>
+    Metrics Evaluate(const BasicNetzwerk<Scalar>& netz,
+        const BasicDataset<Scalar>& data);
+
+    // То же на записях [begin, end) упакованной выборки, распаковка
+    // идет кусками
+    template<typename Scalar>
+    Metrics Evaluate(const BasicNetzwerk<Scalar>& netz,
+        const dataset::MappedFile& file, size_t begin, size_t end);
+}
+
+// Обучающая выборка: строка inputs - образец, строка expected -
+// ожидаемые выходы сети для него.
+template<typename Scalar>
+struct netz::BasicDataset {
+    BasicMatrix<Scalar> inputs;
+    BasicMatrix<Scalar> expected;
+
+    BasicDataset() = default;
+    BasicDataset(size_t input_count, size_t output_count);
+
+    BasicDataset& AddSample(const Scalar *inputs, const Scalar *expected);
+    size_t Size() const;
+
+    // Делит выборку на обучающую и проверочную части. Образцы
+    // перемешиваются с зерном seed, в validation уходит доля
+    // validation_share от них (округленная вниз).
+    void Split(double validation_share, unsigned seed, BasicDataset& train,
+        BasicDataset& validation) const;
+
+    // Заменяет содержимое распакованными записями [begin, begin + count)
+    // упакованной выборки, метка превращается в one-hot вектор
+    // expected. Память уже выделенных матриц используется повторно.
+    BasicDataset& Assign(const dataset::MappedFile& file, size_t begin,
+        size_t count);
+};
+
+// Средние по выборке потери и доля образцов, у которых наибольший выход
+// сети совпадает с наибольшим ожидаемым
+struct netz::Metrics {
+    double  mse = 0.0;
+    double  cross_entropy = 0.0;
+    double  accuracy = 0.0;
+};
+
+// Ранняя остановка: обучение прекращается, если потери не уменьшались
+// больше чем на min_delta patience эпох подряд. Вызывающий сохраняет
+// веса, когда Update вернул true, и восстанавливает их после остановки.
+// При patience = 0 остановки нет. Эпохи считаются с 1: BestEpoch -
+// число эпох, пройденных к лучшему результату.
+class netz::EarlyStopping {
+public:
+    explicit EarlyStopping(size_t patience, double min_delta = 0.0);
+
+    // Учитывает потери очередной эпохи. true, если они лучшие на
+    // данный момент.
+    bool Update(double loss);
+    bool ShouldStop() const;
+
+    double BestLoss() const;
+    size_t BestEpoch() const;
+    size_t Epochs() const;
+private:
+    size_t  patience__;
+    double  min_delta__;
+    double  best_loss__;
+    size_t  best_epoch__ = 0;
+    size_t  improved_epoch__ = 0;
+    size_t  epochs__ = 0;
+};
+
+// Постоянный набор потоков. Run выполняет задачу на каждом потоке
+// (аргумент - номер потока) и ждет завершения всех.
+class netz::WorkerPool {
+public:
+    explicit WorkerPool(size_t size);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void Run(const std::function<void(size_t)>& task);
+    size_t Size() const;
+private:
+    void WorkerLoop(size_t worker);
+
+    std::vector<std::thread>            threads__;
+    std::mutex                          mutex__;
+    std::condition_variable             start__;
+    std::condition_variable             done__;
+    const std::function<void(size_t)>  *task__ = nullptr;
+    size_t                              generation__ = 0;
+    size_t                              pending__ = 0;
+    bool                                stop__ = false;
+};
+
+// Обучение с параллелизмом по данным. Каждый поток считает на своей
+// копии сети, обучаемая сеть обновляется только при сведении.
+//
+// SYNCHRONOUS: выборка идет пакетами по GetBatchSize образцов, пакет
+// делится между потоками, градиенты потоков суммируются и применяются
+// к сети одним шагом, как в пакетном режиме Netzwerk.
+//
+// ASYNCHRONOUS: каждый поток ведет онлайн-обучение своей копии на своей
+// части выборки без обмена градиентами и раз в GetSyncInterval образцов
+// копии усредняются. Это вариант в духе Hogwild без гонок по общим
+// весам.
+//
+// С одним потоком обучение идет прямо на сети в порядке выборки, как в
+// обычном цикле SetInput/GetOuputs/AdjustWeights.
+template<typename Scalar>
+class netz::BasicParallelTrainer {
+public:
+    using Mode      = TrainingMode;
+    using Netzwerk  = BasicNetzwerk<Scalar>;
+    using Layer     = BasicLayer<Scalar>;
+    using Dataset   = BasicDataset<Scalar>;
+
+    BasicParallelTrainer(Netzwerk& netz, size_t threads,
+        Mode mode = Mode::SYNCHRONOUS);
+
+    BasicParallelTrainer& SetBatchSize(size_t batch_size);
+    size_t GetBatchSize() const;
+    BasicParallelTrainer& SetSyncInterval(size_t interval);
+    size_t GetSyncInterval() const;
+
+    void TrainEpoch(const Dataset& data, double alpha);
+
+    // Эпоха по записям [begin, end) упакованной выборки. Записи
+    // распаковываются кусками по PACKED_CHUNK образцов в порядке,
+    // перемешанном на каждой эпохе, так что в памяти одновременно
+    // только один кусок в распакованном виде.
+    void TrainEpoch(const dataset::MappedFile& file, size_t begin,
+        size_t end, double alpha);
+private:
+    static constexpr size_t PACKED_CHUNK = 4096;
+
+    void TrainSequential(const Dataset& data, double alpha);
+    void TrainSynchronous(const Dataset& data, double alpha);
+    void TrainAsynchronous(const Dataset& data, double alpha);
+    void Shuffle(size_t size);
+
+    // Строки матриц весов (и ядра сверток) делятся между потоками при
+    // сведении. func(size, weights, gradients) получает длину строки и
+    // функции, возвращающие ее веса и градиенты в данной сети.
+    template<typename Func>
+    void ForEachRowSlice(size_t worker, Func func);
+
+    Netzwerk&               netz__;
+    Mode                    mode__;
+    size_t                  batch_size__ = 32;
+    size_t                  sync_interval__ = 64;
+    std::vector<Netzwerk>   replicas__;
+    std::vector<size_t>     order__;
+    std::vector<size_t>     chunks__;
+    Dataset                 chunk__;
+    std::mt19937            shuffle_gen__;
+    std::unique_ptr<WorkerPool> pool__;
+};
+
+namespace netz {
+    extern template struct BasicDataset<float>;
+    extern template struct BasicDataset<double>;
+    extern template class BasicParallelTrainer<float>;
+    extern template class BasicParallelTrainer<double>;
+
+    extern template Metrics Evaluate(const BasicNetzwerk<float>&,
+        const BasicDataset<float>&);
+    extern template Metrics Evaluate(const BasicNetzwerk<double>&,
+        const BasicDataset<double>&);
+    extern template Metrics Evaluate(const BasicNetzwerk<float>&,
+        const dataset::MappedFile&, size_t, size_t);
+    extern template Metrics Evaluate(const BasicNetzwerk<double>&,
+        const dataset::MappedFile&, size_t, size_t);
+}
+
+template<typename Scalar>
+template<typename Func>
+void netz::BasicParallelTrainer<Scalar>::ForEachRowSlice(size_t worker,
+        Func func) {
+    const size_t workers = replicas__.size();
+
+    for (size_t k = 0; k < netz__.ConvLayersCount(); k++) {
+        const ConvShape& shape = netz__.GetConvLayer(k).Shape();
+        const size_t begin = shape.filters * worker / workers;
+        const size_t end = shape.filters * (worker + 1) / workers;
+
+        for (size_t f = begin; f < end; f++) {
+            func(shape.PatchSize(),
+                [=](Netzwerk& n) { return n.GetConvLayer(k).Weights(f); },
+                [=](Netzwerk& n) { return n.GetConvLayer(k).Gradients(f); });
+        }
+    }
+
+    for (size_t k = 0; k < netz__.LayersCount(); k++) {
+        const Layer& l = netz__.GetLayer(k);
+        const size_t begin = l.Size() * worker / workers;
+        const size_t end = l.Size() * (worker + 1) / workers;
+
+        for (size_t i = begin; i < end; i++) {
+            func(l.InputSize(),
+                [=](Netzwerk& n) { return n.GetLayer(k).Weights(i); },
+                [=](Netzwerk& n) { return n.GetLayer(k).Gradients(i); });
+        }
+    }
+}
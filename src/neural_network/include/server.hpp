@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Режим serve: модель загружается один раз, а образцы приходят строками
+// по одному на строку, InputCount символов '0' или '1'. На каждую строку
+// отвечает одна строка в том же порядке:
+//
+// circle 0.975888 0.0242259 0.0109231     метка и выходы сети
+// error invalid record                    строка не разобрана
+//
+// Пустые строки пропускаются без ответа. Клиент может слать строки, не
+// дожидаясь ответов: все, что уже пришло, считается пакетами до
+// batch_size образцов за один проход сети, и ответы отправляются перед
+// тем, как ждать следующих данных.
+namespace server {
+
+struct Options {
+    size_t                      batch_size = 64;
+    // Метки выходов. Если метки для выхода нет, пишется его номер.
+    std::vector<std::string>    labels;
+};
+
+// Обслуживает один поток данных, например stdin/stdout, пока in_fd не
+// закроется
+template<typename Scalar, typename Model>
+void ServeStream(const Model& model, int in_fd, int out_fd,
+    const Options& options);
+
+// Слушает UNIX-сокет path. Каждое соединение обслуживается своим
+// потоком со своим InferenceContext, модель у всех одна. Возвращается
+// только с исключением.
+template<typename Scalar, typename Model>
+void ServeSocket(const Model& model, const std::string& path,
+    const Options& options);
+
+} // namespace server
@@ -1,67 +1,112 @@
 #include <algorithm>
 #include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "bitmap.hpp"
 #include "netz.hpp"
+#include "netz_augment.hpp"
+#include "netz_binary.hpp"
+#include "netz_compiled.hpp"
 #include "netz_formulas.hpp"
+#include "netz_shapes.hpp"
+#include "netz_trainer.hpp"
+#include "server.hpp"
+
+#include <unistd.h>
 
-constexpr double ACCEPTABLE_ERROR 	= 10e-6;
 constexpr char CMD_LOAD_WEIGHTS[] 	= "LOAD-WEIGHTS";
 constexpr char CMD_DUMP_WEIGHTS[] 	= "DUMP-WEIGHTS";
 constexpr char CMD_RUN[]		= "RUN";
+constexpr char CMD_SERVE[]		= "SERVE";
+constexpr char CMD_EXPORT_DATASET[]	= "EXPORT-DATASET";
 constexpr size_t ARGV_CMD		= 1;
 constexpr size_t ARGV_DUMP_FILE 	= 3;
 constexpr size_t ARGV_IN_FILE		= 2;
+constexpr size_t ARGV_MODEL_FILE	= 2;
 constexpr size_t INPUT_WIDTH		= 7;
 constexpr size_t INPUT_HEIGHT		= 7;
-constexpr size_t INPUT_COUNT		= INPUT_HEIGHT * INPUT_HEIGHT;
+constexpr size_t INPUT_COUNT		= INPUT_WIDTH * INPUT_HEIGHT;
 constexpr size_t CIRCLE_OUTPUT		= 0;
 constexpr size_t SQUARE_OUTPUT		= 1;
 constexpr size_t TRIANGLE_OUTPUT	= 2;
 constexpr size_t EPOCH_LIMIT		= 1000;
+constexpr size_t PATIENCE		= 0;
+constexpr double MIN_DELTA		= 0.0;
+constexpr double VALIDATION_SHARE	= 0.2;
+constexpr unsigned SPLIT_SEED		= 42;
+constexpr size_t SERVE_BATCH		= 64;
+constexpr size_t MONITOR_LIMIT		= 10000;
+constexpr char OPT_BATCH[]		= "--batch";
+constexpr char OPT_THREADS[]		= "--threads";
+constexpr char OPT_MODE[]		= "--mode";
+constexpr char OPT_ACTIVATION[]		= "--activation";
+constexpr char OPT_PRECISION[]		= "--precision";
+constexpr char OPT_FORMAT[]		= "--format";
+constexpr char OPT_EPOCHS[]		= "--epochs";
+constexpr char OPT_PATIENCE[]		= "--patience";
+constexpr char OPT_VALIDATION[]		= "--validation";
+constexpr char OPT_LOSS[]		= "--loss";
+constexpr char OPT_MIN_DELTA[]		= "--min-delta";
+constexpr char OPT_SOCKET[]		= "--socket";
+constexpr char OPT_DATASET[]		= "--dataset";
+constexpr char OPT_AUGMENT[]		= "--augment";
+constexpr char OPT_SIZE[]		= "--size";
+constexpr char OPT_CONV[]		= "--conv";
+constexpr char OPT_POOL[]		= "--pool";
+
+const std::vector<std::string> OUTPUT_LABELS = { "circle", "square",
+    "triangle" };
 
 const std::vector<double> CIRCLE_EXPECTED_OUTPUT   = { 1, 0, 0 };
 const std::vector<double> SQUARE_EXPECTED_OUTPUT   = { 0, 1, 0 };
 const std::vector<double> TRIANGLE_EXPECTED_OUTPUT = { 0, 0, 1 };
 
-const std::vector<double> base_circle = {
-    0, 0, 0, 0, 0, 0, 0,
-    0, 0, 1, 1, 1, 0, 0,
-    0, 1, 0, 0, 0, 1, 0,
-    0, 1, 0, 0, 0, 1, 0,
-    0, 1, 0, 0, 0, 1, 0,
-    0, 0, 1, 1, 1, 0, 0,
-    0, 0, 0, 0, 0, 0, 0,
-};
-
-const std::vector<double> base_square = {
-    0, 0, 0, 0, 0, 0, 0,
-    0, 1, 1, 1, 1, 1, 0,
-    0, 1, 0, 0, 0, 1, 0,
-    0, 1, 0, 0, 0, 1, 0,
-    0, 1, 0, 0, 0, 1, 0,
-    0, 1, 1, 1, 1, 1, 0,
-    0, 0, 0, 0, 0, 0, 0,
+// Параметры обучения и классификации, общие для сетей на float и double
+struct RunOptions {
+    bool                            load_weights = false;
+    bool                            serve = false;
+    std::string                     socket_path;
+    std::string                     dataset_path;
+    size_t                          augment_samples = 0;
+    // Разрешение картинок. Встроенные картинки - 7x7, другие размеры
+    // только с --dataset или --augment.
+    size_t                          input_width = INPUT_WIDTH;
+    size_t                          input_height = INPUT_HEIGHT;
+    // Сверточный слой перед скрытым, 0 фильтров - без него
+    size_t                          conv_filters = 0;
+    size_t                          conv_kernel = 3;
+    size_t                          conv_pool = 1;
+    bool                            dump_weights = false;
+    bool                            binary_format = false;
+    std::string                     model_path;
+    double                          alpha = 0.2;
+    size_t                          batch_size = 1;
+    bool                            batch_given = false;
+    size_t                          threads = 1;
+    netz::TrainingMode              mode = netz::TrainingMode::SYNCHRONOUS;
+    netz::math::activation::Kind    hidden_activation =
+        netz::math::activation::Kind::SIGMA;
+    size_t                          epochs = EPOCH_LIMIT;
+    size_t                          patience = PATIENCE;
+    double                          min_delta = MIN_DELTA;
+    double                          validation_share = VALIDATION_SHARE;
+    bool                            cross_entropy_loss = false;
 };
 
-const std::vector<double> base_triangle = {
-    0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 1, 0, 0, 0,
-    0, 0, 1, 0, 1, 0, 0,
-    0, 1, 0, 0, 0, 1, 0,
-    1, 0, 0, 0, 0, 0, 1,
-    1, 1, 1, 1, 1, 1, 1,
-    0, 0, 0, 0, 0, 0, 0,
-};
-
-std::ostream& PrintOutputs(std::ostream& out, const std::vector<double>& outs) {
+template<typename Scalar>
+std::ostream& PrintOutputs(std::ostream& out, const std::vector<Scalar>& outs) {
     bool is_first = true;
-    for (double outval : outs) {
+    for (Scalar outval : outs) {
         if (!is_first)
             out << '\n';
         is_first = false;
@@ -70,13 +115,89 @@ std::ostream& PrintOutputs(std::ostream& out, const std::vector<double>& outs) {
     return out;
 }
 
+template<typename Scalar>
+void AddBitmaps(netz::BasicDataset<Scalar>& dataset,
+        const std::vector<std::vector<int>>& bitmaps,
+        const std::vector<double>& expected) {
+    std::vector<Scalar> inputs(INPUT_COUNT);
+    const std::vector<Scalar> outputs(expected.begin(), expected.end());
+
+    for (const auto& figure : bitmaps) {
+        for (size_t i = 0; i < INPUT_COUNT; i++) {
+            inputs[i] = static_cast<Scalar>(figure.at(i));
+        }
+
+        dataset.AddSample(inputs.data(), outputs.data());
+    }
+}
+
 char ToUpper(char c) {
     return std::toupper(c);
 }
 
+// Разбирает целое число не меньше min_count. Принимаются только цифры:
+// std::stoul взял бы из "1e" единицу, а "-1" превратил бы в 2^64 - 1.
+bool ParseCount(const std::string& text, size_t min_count, size_t& count) {
+    const bool digits = !text.empty()
+        && std::all_of(text.begin(), text.end(), [](unsigned char c) {
+            return std::isdigit(c);
+        });
+
+    errno = 0;
+    const unsigned long long value = digits
+        ? std::strtoull(text.c_str(), nullptr, 10) : 0;
+
+    if (!digits || errno == ERANGE || value < min_count
+            || value > std::numeric_limits<size_t>::max()) {
+        return false;
+    }
+
+    count = static_cast<size_t>(value);
+    return true;
+}
+
+// Разбирает неотрицательное конечное число
+bool ParseReal(const std::string& text, double& value) {
+    char *end = nullptr;
+    const double parsed = std::strtod(text.c_str(), &end);
+
+    if (text.empty() || std::isspace(static_cast<unsigned char>(text[0]))
+            || *end != '\0' || !std::isfinite(parsed) || parsed < 0) {
+        return false;
+    }
+
+    value = parsed;
+    return true;
+}
+
+// Сообщает о неверном значении опции, результат - код выхода
+int InvalidValue(const char *name, const std::string& text) {
+    std::cerr << "Invalid value of " << name << ": " << text << "\n";
+    return 1;
+}
+
+// Выделяет из командной строки опции вида --name value, сдвигая
+// позиционные аргументы к началу argv.
+std::map<std::string, std::string> ExtractOptions(int& argc, char **argv) {
+    std::map<std::string, std::string> options;
+    int positional = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "--", 2) == 0 && i + 1 < argc) {
+            options[argv[i]] = argv[i + 1];
+            i++;
+        } else {
+            argv[positional++] = argv[i];
+        }
+    }
+
+    argc = positional;
+    return options;
+}
+
 void PrintUsage() {
     std::cout
-    << 	"Usage: ./netzwerk [cmd] args...\n"
+    << 	"Usage: ./netzwerk [cmd] args... [options]\n"
     << 	"Commands:\n"
     << 	"\t dump-weights [input_file] [dump_filename] - dumps weights "
     <<	"into a file.\n"
@@ -84,193 +205,657 @@ void PrintUsage() {
     <<	"from the file and skips learning.\n"
     <<	"\t run [input_file] - just run the program. The network will learn "
     <<	"without dumping its weights.\n"
+    <<	"\t serve [load_filename] - loads the model once and classifies "
+    <<	"bitmaps from stdin, one line of '0'/'1' characters per bitmap "
+    <<	"(as many as the model has inputs). "
+    <<	"Every line is answered with the class and the output values.\n"
+    <<	"\t export-dataset [dump_filename] - writes the built-in training "
+    <<	"bitmaps as a packed dataset for --dataset.\n"
+    << 	"Options:\n"
+    << 	"\t --batch [size] - sum the gradients over mini-batches of this "
+    <<	"size and update the weights once per batch instead of after every "
+    <<	"sample. The sum is not divided by the batch size, so the "
+    <<	"effective step grows with it. With serve "
+    <<	"the largest number of bitmaps classified in one pass (64 by "
+    <<	"default).\n"
+    << 	"\t --dataset [path] - train on a packed dataset file (1 bit per "
+    <<	"pixel and a label byte per sample) instead of the built-in "
+    <<	"bitmaps. The file is mapped into memory and unpacked in chunks; "
+    <<	"its last --validation share of samples is held out, so the file "
+    <<	"should be shuffled.\n"
+    << 	"\t --augment [count] - train on this many samples per epoch "
+    <<	"generated on the fly from the base shapes (shifted and noisy) "
+    <<	"by a separate thread. At 7x7 all built-in bitmaps are used for "
+    <<	"validation, at other sizes a separately generated chunk.\n"
+    << 	"\t --size [width]x[height] - resolution of the bitmaps (7x7 by "
+    <<	"default). Other sizes need --dataset with bitmaps of that size "
+    <<	"or --augment, which scales the base shapes up.\n"
+    << 	"\t --conv [filters]x[kernel] - put a convolution layer with this "
+    <<	"many filters of kernel x kernel pixels (3 by default) before the "
+    <<	"hidden layer. The convolution uses tanh.\n"
+    << 	"\t --pool [size] - with --conv, keep the largest output of every "
+    <<	"size x size square of the convolution (1, no pooling, by "
+    <<	"default).\n"
+    << 	"\t --socket [path] - with serve, listen on this UNIX socket "
+    <<	"instead of stdin. Every connection is served by its own thread.\n"
+    << 	"\t --threads [count] - train on this many threads.\n"
+    << 	"\t --mode [sync|async] - with several threads either reduce "
+    <<	"gradients every batch (sync, default) or train replicas "
+    <<	"independently and average them periodically (async).\n"
+    << 	"\t --activation [sigma|sigma-mirrored|relu|tanh] - activation "
+    <<	"function of the hidden layer (sigma by default).\n"
+    << 	"\t --precision [double|float] - number type of the network. "
+    <<	"Float weights are dumped exactly as netzp reads them.\n"
+    << 	"\t --format [text|binary] - format of the dumped weights (text "
+    <<	"by default). load-weights detects the format itself; binary "
+    <<	"models are mapped into memory and used without parsing.\n"
+    << 	"\t --epochs [count] - maximum number of training epochs "
+    <<	"(1000 by default).\n"
+    << 	"\t --patience [count] - stop after this many epochs without "
+    <<	"improvement of the validation loss and restore the best weights "
+    <<	"(0 by default, early stopping is off). The loss of a fresh "
+    <<	"sigmoid network may stay almost flat for hundreds of epochs "
+    <<	"before it starts to fall, so a small patience stops an untrained "
+    <<	"network.\n"
+    << 	"\t --min-delta [value] - with --patience, smallest decrease of "
+    <<	"the loss that counts as improvement (0 by default).\n"
+    << 	"\t --validation [share] - share of the samples held out for "
+    <<	"validation (0.2 by default). With 0 the training loss is "
+    <<	"monitored instead (on at most 10000 samples of a packed "
+    <<	"dataset).\n"
+    << 	"\t --loss [mse|cross-entropy] - loss monitored for early "
+    <<	"stopping (mse by default).\n"
     ;
 }
 
+template<typename Scalar, typename Model>
+void Classify(const Model& model, const std::vector<double>& input) {
+    const size_t input_count = model.InputCount();
+
+    if (input.size() % input_count != 0) {
+        std::cerr << "Warning, input size is "
+                  << input.size() << std::endl;
+    }
+
+    if (input.size() < input_count) {
+        throw std::runtime_error("Not enough input values");
+    }
+
+    netz::BasicMatrix<Scalar> samples(input.size() / input_count,
+        input_count);
+    std::copy(input.begin(), input.begin() + samples.data.size(),
+        samples.data.begin());
+
+    netz::BasicMatrix<Scalar> outputs_batch = model.GetOutputsBatch(samples);
+
+    for (size_t m = 0; m < outputs_batch.rows; m++) {
+        std::vector<Scalar> outputs(outputs_batch.Row(m),
+            outputs_batch.Row(m) + outputs_batch.cols);
+
+        PrintOutputs(std::cout, outputs) << std::endl;
+
+        auto max_iter = std::max_element(outputs.begin(), outputs.end());
+
+        switch (max_iter - outputs.begin()) {
+            case CIRCLE_OUTPUT:
+                std::cout << "circle" << std::endl;
+                break;
+            case SQUARE_OUTPUT:
+                std::cout << "square" << std::endl;
+                break;
+            case TRIANGLE_OUTPUT:
+                std::cout << "triangle" << std::endl;
+                break;
+        }
+    }
+}
+
+// Пишет встроенные картинки упакованной выборкой, классы вперемешку
+int ExportDataset(const char *path) {
+    std::ofstream out(path, std::ios::binary);
+
+    if (!out) {
+        std::cerr << "Could not open file " << path << std::endl;
+        return 1;
+    }
+
+    netz::dataset::Writer writer(out, INPUT_COUNT, OUTPUT_LABELS.size());
+
+    const size_t count = std::min({ circle_bitmaps.size(),
+        square_bitmaps.size(), triangle_bitmaps.size() });
+
+    for (size_t i = 0; i < count; i++) {
+        writer.Add(circle_bitmaps[i].data(), CIRCLE_OUTPUT);
+        writer.Add(square_bitmaps[i].data(), SQUARE_OUTPUT);
+        writer.Add(triangle_bitmaps[i].data(), TRIANGLE_OUTPUT);
+    }
+
+    return out ? 0 : 1;
+}
+
+template<typename Scalar, typename Model>
+void Serve(const Model& model, const RunOptions& run) {
+    server::Options options;
+    options.batch_size = run.batch_given ? run.batch_size : SERVE_BATCH;
+    options.labels = OUTPUT_LABELS;
+
+    if (run.socket_path.empty()) {
+        server::ServeStream<Scalar>(model, STDIN_FILENO, STDOUT_FILENO,
+            options);
+    } else {
+        server::ServeSocket<Scalar>(model, run.socket_path, options);
+    }
+}
+
+// Обучает сеть (или читает ее из dump_in), классифицирует картинки из
+// input и при необходимости пишет сеть в dump_out. В режиме serve
+// загруженная модель обслуживает запросы, пока они идут.
+template<typename Scalar>
+void Run(const RunOptions& run, const std::vector<double>& input,
+        std::istream& dump_in, std::ostream& dump_out) {
+    using namespace netz;
+
+    if (run.load_weights && run.binary_format) {
+        const BasicMappedModel<Scalar> model(run.model_path);
+
+        if (run.serve) {
+            Serve<Scalar>(model, run);
+        } else {
+            Classify<Scalar>(model, input);
+        }
+
+        return;
+    }
+
+    BasicNetzwerk<Scalar> netz;
+
+    if (run.load_weights) {
+        netz = BasicNetzwerk<Scalar>::ReadStructure(dump_in);
+    } else {
+        const size_t input_count = run.input_width * run.input_height;
+
+        if (input_count != INPUT_COUNT && run.dataset_path.empty()
+                && !run.augment_samples) {
+            throw std::runtime_error("The built-in bitmaps are 7x7, use "
+                "--dataset or --augment for other sizes.");
+        }
+
+        for (size_t i = 0; i < input_count; i++) {
+            netz.AddInput(0);
+        }
+
+        if (run.conv_filters) {
+            ConvShape shape;
+            shape.height = run.input_height;
+            shape.width = run.input_width;
+            shape.filters = run.conv_filters;
+            shape.kernel = run.conv_kernel;
+            shape.pool = run.conv_pool;
+
+            // Свертка всегда с гиперболическим тангенсом: у сигмоиды
+            // пустой фон дает 0.5 во всех положениях ядра, и полезный
+            // сигнал тонет в этом постоянном слагаемом
+            netz.AddConvolution(shape, math::activation::Kind::TANH);
+        }
+
+        netz.AddLayer(3 * 2, run.hidden_activation)
+            .AddLayer(3);
+
+        // Начальные веса лежат в [0, 1), и при большом числе входов
+        // суммы первого слоя уводят сигмоиду в насыщение. Для картинок,
+        // где черных пикселей немного, веса уменьшаются так, чтобы суммы
+        // были того же порядка, что и на 7x7. Выходы свертки отличны от
+        // нуля почти все, поэтому после нее веса делаются разных знаков
+        // со средним 0.
+        BasicLayer<Scalar>& first = netz.GetLayer(0);
+        const size_t first_inputs = first.InputSize();
+
+        if (run.conv_filters || first_inputs > INPUT_COUNT) {
+            const Scalar scale = Scalar(INPUT_COUNT) / first_inputs;
+            const Scalar spread = 1 / std::sqrt(Scalar(first_inputs));
+
+            for (size_t n = 0; n < first.Size(); n++) {
+                Scalar *weights = first.Weights(n);
+                for (size_t i = 0; i < first_inputs; i++) {
+                    weights[i] = run.conv_filters
+                        ? (2 * weights[i] - 1) * spread
+                        : weights[i] * scale;
+                }
+            }
+
+            netz.Invalidate();
+        }
+
+        netz.SetBatchSize(run.batch_size);
+
+        BasicDataset<Scalar> train;
+        BasicDataset<Scalar> validation;
+
+        // Упакованная выборка распаковывается кусками и при обучении, и
+        // при оценке. Обучение идет на [0, packed_train), потери
+        // считаются на [monitor_begin, monitor_end).
+        std::unique_ptr<dataset::MappedFile> packed;
+        size_t packed_train = 0;
+        size_t monitor_begin = 0;
+        size_t monitor_end = 0;
+
+        // Картинки для обучения генерируются на лету, а встроенные
+        // целиком идут на проверку. Для других размеров проверочные
+        // картинки генерируются так же, но с другим зерном.
+        std::unique_ptr<BasicAugmentedStream<Scalar>> augmented;
+
+        if (run.augment_samples) {
+            AugmentOptions augment;
+            augment.width = run.input_width;
+            augment.height = run.input_height;
+            augment.max_shift = std::max<size_t>(1,
+                run.input_width / shapes::WIDTH);
+            augment.seed = SPLIT_SEED;
+
+            std::vector<PackedBitmap> bases;
+            for (const PackedBitmap& base : { shapes::Circle(),
+                    shapes::Square(), shapes::Triangle() }) {
+                bases.push_back(shapes::Resize(base, shapes::WIDTH,
+                    run.input_width, run.input_height));
+            }
+
+            augmented = std::make_unique<BasicAugmentedStream<Scalar>>(
+                bases, augment);
+
+            if (input_count == INPUT_COUNT) {
+                validation = BasicDataset<Scalar>(INPUT_COUNT,
+                    CIRCLE_EXPECTED_OUTPUT.size());
+                AddBitmaps(validation, circle_bitmaps,
+                    CIRCLE_EXPECTED_OUTPUT);
+                AddBitmaps(validation, square_bitmaps,
+                    SQUARE_EXPECTED_OUTPUT);
+                AddBitmaps(validation, triangle_bitmaps,
+                    TRIANGLE_EXPECTED_OUTPUT);
+            } else {
+                augment.seed = SPLIT_SEED + 1;
+                augment.queue_chunks = 1;
+                validation = BasicAugmentedStream<Scalar>(bases,
+                    augment).Next();
+            }
+        } else if (run.dataset_path.empty()) {
+            BasicDataset<Scalar> dataset(INPUT_COUNT,
+                CIRCLE_EXPECTED_OUTPUT.size());
+            AddBitmaps(dataset, circle_bitmaps, CIRCLE_EXPECTED_OUTPUT);
+            AddBitmaps(dataset, square_bitmaps, SQUARE_EXPECTED_OUTPUT);
+            AddBitmaps(dataset, triangle_bitmaps, TRIANGLE_EXPECTED_OUTPUT);
+
+            dataset.Split(run.validation_share, SPLIT_SEED, train,
+                validation);
+        } else {
+            packed = std::make_unique<dataset::MappedFile>(run.dataset_path);
+
+            if (packed->InputCount() != input_count
+                    || packed->ClassCount() != OUTPUT_LABELS.size()) {
+                throw std::runtime_error("Dataset " + run.dataset_path
+                    + " does not fit the network (bitmaps of "
+                    + std::to_string(packed->InputCount())
+                    + " pixels, check --size).");
+            }
+
+            const size_t held_out = static_cast<size_t>(
+                run.validation_share * packed->Size());
+            packed_train = packed->Size() - held_out;
+
+            if (held_out) {
+                monitor_begin = packed_train;
+                monitor_end = packed->Size();
+            } else {
+                monitor_end = std::min(packed_train, MONITOR_LIMIT);
+            }
+        }
+
+        const BasicDataset<Scalar>& monitored =
+            validation.Size() ? validation : train;
+
+        BasicParallelTrainer<Scalar> trainer(netz, run.threads, run.mode);
+        if (run.batch_given) {
+            trainer.SetBatchSize(run.batch_size);
+        }
+
+        EarlyStopping stopping(run.patience, run.min_delta);
+        BasicNetzwerk<Scalar> best = netz;
+
+        for (size_t epoch = 0; epoch < run.epochs; epoch++) {
+            if (augmented) {
+                for (size_t trained = 0; trained < run.augment_samples;) {
+                    const BasicDataset<Scalar>& chunk = augmented->Next();
+                    trainer.TrainEpoch(chunk, run.alpha);
+                    trained += chunk.Size();
+                }
+            } else if (packed) {
+                trainer.TrainEpoch(*packed, 0, packed_train, run.alpha);
+            } else {
+                trainer.TrainEpoch(train, run.alpha);
+            }
+
+            const Metrics metrics = packed
+                ? Evaluate(netz, *packed, monitor_begin, monitor_end)
+                : Evaluate(netz, monitored);
+            const double loss = run.cross_entropy_loss
+                ? metrics.cross_entropy : metrics.mse;
+
+            std::cout << "Epoch: " << epoch
+                      << " loss: " << loss
+                      << " accuracy: " << metrics.accuracy << '\n';
+
+            if (stopping.Update(loss)) {
+                best.CopyWeights(netz);
+            }
+
+            if (stopping.ShouldStop()) break;
+        }
+
+        netz.CopyWeights(best);
+
+        // BestEpoch равен 0, если ни одна эпоха не дала конечных потерь
+        // (--epochs 0 или NaN на каждой эпохе)
+        if (stopping.BestEpoch() == 0) {
+            std::cout << "Trained " << stopping.Epochs() << " epochs, "
+                      << "the loss never improved, the initial weights "
+                      << "are kept" << std::endl;
+        } else {
+            std::cout << "Trained " << stopping.Epochs() << " epochs, best "
+                      << "loss " << stopping.BestLoss() << " after epoch "
+                      << stopping.BestEpoch() - 1 << std::endl;
+        }
+
+        if (augmented) {
+            std::cout << "Training waited for augmented samples "
+                      << augmented->Stalls() << " times" << std::endl;
+        }
+    }
+
+    const BasicCompiledModel<Scalar> model(netz);
+
+    if (run.serve) {
+        Serve<Scalar>(model, run);
+        return;
+    }
+
+    Classify<Scalar>(model, input);
+
+    if (run.dump_weights && run.binary_format) {
+        netz.DumpBinary(dump_out);
+    } else if (run.dump_weights) {
+        netz.DumpStructure(dump_out);
+    }
+}
+
 int main(int argc, char **argv) {
     using namespace netz;
 
+    std::map<std::string, std::string> options = ExtractOptions(argc, argv);
+
     if (argc < 3) {
         PrintUsage();
         return 0;
     }
 
-    Netzwerk netz;
+    RunOptions run;
     std::string cmd(argv[ARGV_CMD]);
     std::transform(cmd.begin(), cmd.end(), cmd.begin(), ToUpper);
 
-    bool dump_weights = false;
-    bool load_weights = false;
-
     std::ofstream dump_out;
     std::ifstream in_file;
     std::ifstream dump_in;
 
     if (cmd == CMD_DUMP_WEIGHTS) {
-        if (argc < 3) {
+        if (argc < 4) {
             PrintUsage();
             return 0;
         }
 
-        dump_weights = true;
-
-        dump_out.open(argv[ARGV_DUMP_FILE]);
-
-        if (!dump_out) {
-            std::cerr << "Could not open file "
-                      << argv[ARGV_DUMP_FILE] << std::endl;
-            return 1;
-        }
-
+        run.dump_weights = true;
     } else if (cmd == CMD_LOAD_WEIGHTS) {
-        if (argc < 3) {
+        if (argc < 4) {
             PrintUsage();
             return 0;
         }
 
-        load_weights = true;
+        run.load_weights = true;
 
-        dump_in.open(argv[ARGV_DUMP_FILE]);
+        dump_in.open(argv[ARGV_DUMP_FILE], std::ios::binary);
+        run.model_path = argv[ARGV_DUMP_FILE];
 
         if (!dump_in) {
             std::cerr << "Could not open file "
                       << argv[ARGV_DUMP_FILE] << std::endl;
             return 1;
         }
+    } else if (cmd == CMD_SERVE) {
+        run.load_weights = true;
+        run.serve = true;
+
+        dump_in.open(argv[ARGV_MODEL_FILE], std::ios::binary);
+        run.model_path = argv[ARGV_MODEL_FILE];
+
+        if (!dump_in) {
+            std::cerr << "Could not open file "
+                      << argv[ARGV_MODEL_FILE] << std::endl;
+            return 1;
+        }
+    } else if (cmd == CMD_EXPORT_DATASET) {
+        return ExportDataset(argv[ARGV_IN_FILE]);
     } else if (cmd != CMD_RUN) {
         std::cerr << "Unknown command.\n";
         return 1;
     }
 
-    in_file.open(argv[ARGV_IN_FILE]);
+    std::vector<double> input;
 
-    if (!in_file) {
-        std::cerr << "Could not open file "
-                  << argv[ARGV_IN_FILE] << std::endl;
-        return 1;
-    }
+    // В режиме serve картинки приходят позже, по одной на строку
+    if (!run.serve) {
+        in_file.open(argv[ARGV_IN_FILE]);
 
-    std::vector<double> input;
+        if (!in_file) {
+            std::cerr << "Could not open file "
+                      << argv[ARGV_IN_FILE] << std::endl;
+            return 1;
+        }
 
-    while (!in_file.eof() && (input.size() < INPUT_COUNT)) {
+        // Файл может содержать несколько картинок подряд, все они
+        // классифицируются одним пакетом.
         char c;
-        in_file >> c;
+        while (in_file >> c) {
+            if (c == '1' || c == '0') {
+                input.push_back(static_cast<double>(c - '0'));
+            }
+        }
 
-        if (c == '1' || c == '0') {
-            input.push_back(static_cast<double>(c - '0'));
+    }
+
+    if (options.count(OPT_BATCH)) {
+        if (!ParseCount(options[OPT_BATCH], 1, run.batch_size)) {
+            return InvalidValue(OPT_BATCH, options[OPT_BATCH]);
         }
+
+        run.batch_given = true;
     }
 
-    if (input.size() != INPUT_COUNT) {
-        std::cerr << "Warning, input size is "
-                  << input.size() << std::endl;
+    if (options.count(OPT_DATASET)) {
+        run.dataset_path = options[OPT_DATASET];
+    }
+
+    if (options.count(OPT_AUGMENT)) {
+        if (!ParseCount(options[OPT_AUGMENT], 0, run.augment_samples)) {
+            return InvalidValue(OPT_AUGMENT, options[OPT_AUGMENT]);
+        }
     }
 
-    double alpha = 0.2;
+    if (options.count(OPT_SIZE)) {
+        const std::string& size = options[OPT_SIZE];
+        const size_t x = size.find('x');
 
-    if (load_weights) {
-        netz = std::move(netz::Netzwerk::ReadStructure(dump_in));
-        for (size_t i = 0; i < INPUT_COUNT; i++) {
-            netz.AddInput(0);
+        if (!ParseCount(size.substr(0, x), 1, run.input_width)
+                || (x != std::string::npos && !ParseCount(
+                    size.substr(x + 1), 1, run.input_height))) {
+            return InvalidValue(OPT_SIZE, size);
         }
 
-        goto skip;
+        if (x == std::string::npos) {
+            run.input_height = run.input_width;
+        }
     }
 
-    netz.AddLayer(3 * 2)
-        .AddLayer(3);
+    if (options.count(OPT_CONV)) {
+        const std::string& conv = options[OPT_CONV];
+        const size_t x = conv.find('x');
 
-    for (size_t i = 0; i < INPUT_COUNT; i++) {
-        netz.AddInput(0);
+        if (!ParseCount(conv.substr(0, x), 1, run.conv_filters)
+                || (x != std::string::npos && !ParseCount(
+                    conv.substr(x + 1), 1, run.conv_kernel))) {
+            return InvalidValue(OPT_CONV, conv);
+        }
     }
 
-    for (size_t epoch = 0; epoch < EPOCH_LIMIT; epoch++) {
-        std::cout << "Epoch: " << epoch << std::endl;
-        for (const auto& figure : circle_bitmaps) {
-            for (size_t i = 0; i < INPUT_COUNT; i++) {
-                netz.SetInput(
-                    i, static_cast<double>(figure.at(i)));
-            }
+    if (options.count(OPT_POOL)) {
+        if (!ParseCount(options[OPT_POOL], 1, run.conv_pool)) {
+            return InvalidValue(OPT_POOL, options[OPT_POOL]);
+        }
+    }
 
-            std::vector<double> outputs = netz.GetOuputs();
+    if (options.count(OPT_SOCKET)) {
+        run.socket_path = options[OPT_SOCKET];
+    }
 
-            double error = math::ErrorEstimation(
-                CIRCLE_EXPECTED_OUTPUT,
-                outputs
-            );
+    if (options.count(OPT_THREADS)) {
+        if (!ParseCount(options[OPT_THREADS], 1, run.threads)) {
+            return InvalidValue(OPT_THREADS, options[OPT_THREADS]);
+        }
+    }
 
-            if (std::abs(error) > ACCEPTABLE_ERROR) {
-                netz.AdjustWeights(alpha,
-                    CIRCLE_EXPECTED_OUTPUT);
-            }
+    if (options.count(OPT_ACTIVATION)) {
+        try {
+            run.hidden_activation = math::activation::KindFromName(
+                options[OPT_ACTIVATION]);
+        } catch (const std::invalid_argument&) {
+            std::cerr << "Unknown activation function.\n";
+            return 1;
         }
+    }
 
-        for (const auto& figure : square_bitmaps) {
-            for (size_t i = 0; i < INPUT_COUNT; i++) {
-                netz.SetInput(
-                    i, static_cast<double>(figure.at(i)));
-            }
+    if (options.count(OPT_MODE)) {
+        if (options[OPT_MODE] == "async") {
+            run.mode = TrainingMode::ASYNCHRONOUS;
+        } else if (options[OPT_MODE] != "sync") {
+            std::cerr << "Unknown training mode.\n";
+            return 1;
+        }
+    }
 
-            std::vector<double> outputs = netz.GetOuputs();
+    if (options.count(OPT_EPOCHS)) {
+        if (!ParseCount(options[OPT_EPOCHS], 0, run.epochs)) {
+            return InvalidValue(OPT_EPOCHS, options[OPT_EPOCHS]);
+        }
+    }
 
-            double error = math::ErrorEstimation(
-                SQUARE_EXPECTED_OUTPUT,
-                outputs
-            );
+    if (options.count(OPT_PATIENCE)) {
+        if (!ParseCount(options[OPT_PATIENCE], 0, run.patience)) {
+            return InvalidValue(OPT_PATIENCE, options[OPT_PATIENCE]);
+        }
+    }
 
-            if (std::abs(error) > ACCEPTABLE_ERROR) {
-                netz.AdjustWeights(alpha,
-                    SQUARE_EXPECTED_OUTPUT);
-            }
+    if (options.count(OPT_MIN_DELTA)) {
+        if (!ParseReal(options[OPT_MIN_DELTA], run.min_delta)) {
+            return InvalidValue(OPT_MIN_DELTA, options[OPT_MIN_DELTA]);
         }
+    }
 
-        for (const auto& figure : triangle_bitmaps) {
-            for (size_t i = 0; i < INPUT_COUNT; i++) {
-                netz.SetInput(
-                    i, static_cast<double>(figure.at(i)));
-            }
+    if (options.count(OPT_VALIDATION)) {
+        if (!ParseReal(options[OPT_VALIDATION], run.validation_share)) {
+            return InvalidValue(OPT_VALIDATION, options[OPT_VALIDATION]);
+        }
 
-            std::vector<double> outputs = netz.GetOuputs();
+        if (run.validation_share >= 1) {
+            std::cerr << "Validation share must be in [0, 1).\n";
+            return 1;
+        }
+    }
 
-            double error = math::ErrorEstimation(
-                TRIANGLE_EXPECTED_OUTPUT,
-                outputs
-            );
+    if (options.count(OPT_LOSS)) {
+        if (options[OPT_LOSS] == "cross-entropy") {
+            run.cross_entropy_loss = true;
+        } else if (options[OPT_LOSS] != "mse") {
+            std::cerr << "Unknown loss function.\n";
+            return 1;
+        }
+    }
 
-            if (std::abs(error) > ACCEPTABLE_ERROR) {
-                netz.AdjustWeights(alpha,
-                    TRIANGLE_EXPECTED_OUTPUT);
-            }
+    if (options.count(OPT_FORMAT)) {
+        if (options[OPT_FORMAT] == "binary") {
+            run.binary_format = true;
+        } else if (options[OPT_FORMAT] != "text") {
+            std::cerr << "Unknown weights format.\n";
+            return 1;
         }
     }
 
-skip:
+    // Двоичная модель хранит только полносвязные слои, так что сверточную
+    // сеть пришлось бы отвергнуть уже после обучения
+    if (run.dump_weights && run.binary_format && run.conv_filters) {
+        std::cerr << "Binary models hold dense layers only, "
+                  << "use --format text with --conv.\n";
+        return 1;
+    }
 
-    for (size_t i = 0; i < INPUT_COUNT; i++) {
-        netz.SetInput(i, static_cast<double>(input.at(i)));
+    // Картинки проверяются до обучения: иначе нехватка входов
+    // обнаружилась бы только после всех эпох, а файл дампа остался бы
+    // пустым. Загруженная модель проверяет их сама, до классификации.
+    if (!run.load_weights
+            && input.size() < run.input_width * run.input_height) {
+        std::cerr << "Not enough input values" << std::endl;
+        return 1;
     }
 
-    std::vector<double> outputs = netz.GetOuputs();
+    if (run.dump_weights) {
+        dump_out.open(argv[ARGV_DUMP_FILE], std::ios::binary);
 
-    PrintOutputs(std::cout, outputs) << std::endl;
+        if (!dump_out) {
+            std::cerr << "Could not open file "
+                      << argv[ARGV_DUMP_FILE] << std::endl;
+            return 1;
+        }
+    }
 
-    auto max_iter = std::max_element(outputs.begin(), outputs.end());
+    bool single_precision = false;
 
-    switch (max_iter - outputs.begin()) {
-        case CIRCLE_OUTPUT:
-            std::cout << "circle" << std::endl;
-            break;
-        case SQUARE_OUTPUT:
-            std::cout << "square" << std::endl;
-            break;
-        case TRIANGLE_OUTPUT:
-            std::cout << "triangle" << std::endl;
-            break;
+    if (options.count(OPT_PRECISION)) {
+        if (options[OPT_PRECISION] == "float") {
+            single_precision = true;
+        } else if (options[OPT_PRECISION] != "double") {
+            std::cerr << "Unknown precision.\n";
+            return 1;
+        }
     }
 
-    if (dump_weights) {
-        netz.DumpStructure(dump_out);
+    // При загрузке формат определяется по файлу, а тип числа двоичной
+    // модели записан в ней самой
+    if (run.load_weights) {
+        run.binary_format = binary::IsModel(dump_in);
+    }
+
+    try {
+        if (run.binary_format && run.load_weights) {
+            const binary::Header header = binary::ReadHeader(dump_in);
+            single_precision = header.scalar_size == sizeof(float);
+        }
+
+        if (single_precision) {
+            Run<float>(run, input, dump_in, dump_out);
+        } else {
+            Run<double>(run, input, dump_in, dump_out);
+        }
+    } catch (const std::exception& e) {
+        // Загрузчики моделей бросают std::invalid_argument на
+        // испорченных файлах
+        std::cerr << e.what() << std::endl;
+        return 1;
     }
 
     return 0;
-}
\ No newline at end of file
+}
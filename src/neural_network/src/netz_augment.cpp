@@ -0,0 +1,161 @@
+#include "netz_augment.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+template<typename Scalar>
+netz::BasicAugmentedStream<Scalar>::BasicAugmentedStream(
+        std::vector<PackedBitmap> bases, const AugmentOptions& options)
+        : bases__(std::move(bases)), options__(options),
+          // Один кусок у обучения, остальные в очередях
+          chunks__(options.queue_chunks + 1),
+          ready__(chunks__.size()), free__(chunks__.size()),
+          gen__(options.seed) {
+    const size_t input_count = options__.width * options__.height;
+
+    if (bases__.empty() || options__.chunk_size == 0) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_EMPTY_AUGMENT));
+    }
+
+    for (const PackedBitmap& base : bases__) {
+        if (base.Size() != input_count || (options__.rotate
+                && options__.width != options__.height)) {
+            throw std::invalid_argument(ErrMsg(ERR_MSG_SIZES_DIFFER));
+        }
+    }
+
+    for (Dataset& chunk : chunks__) {
+        chunk = Dataset(input_count, bases__.size());
+        free__.TryPush(&chunk);
+    }
+
+    producer__ = std::thread(&BasicAugmentedStream::Produce, this);
+}
+
+template<typename Scalar>
+netz::BasicAugmentedStream<Scalar>::~BasicAugmentedStream() {
+    {
+        std::lock_guard<std::mutex> lock(mutex__);
+        stop__.store(true, std::memory_order_relaxed);
+    }
+
+    chunk_freed__.notify_one();
+    producer__.join();
+}
+
+template<typename Scalar>
+const netz::BasicDataset<Scalar>& netz::BasicAugmentedStream<Scalar>::Next() {
+    if (current__) {
+        free__.TryPush(current__);
+
+        // Блокировка нужна, чтобы уведомление не потерялось между
+        // проверкой очереди и засыпанием генерирующего потока
+        { std::lock_guard<std::mutex> lock(mutex__); }
+        chunk_freed__.notify_one();
+    }
+
+    if (!ready__.TryPop(current__)) {
+        stalls__++;
+
+        std::unique_lock<std::mutex> lock(mutex__);
+        chunk_ready__.wait(lock, [this] { return ready__.TryPop(current__); });
+    }
+
+    return *current__;
+}
+
+template<typename Scalar>
+size_t netz::BasicAugmentedStream<Scalar>::Stalls() const {
+    return stalls__;
+}
+
+template<typename Scalar>
+void netz::BasicAugmentedStream<Scalar>::Produce() {
+    while (!stop__.load(std::memory_order_relaxed)) {
+        Dataset *chunk = nullptr;
+
+        if (!free__.TryPop(chunk)) {
+            std::unique_lock<std::mutex> lock(mutex__);
+            chunk_freed__.wait(lock, [&] {
+                return stop__.load(std::memory_order_relaxed)
+                    || free__.TryPop(chunk);
+            });
+
+            if (stop__.load(std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        Fill(*chunk);
+
+        // В очередях места на все куски, так что это всегда удается
+        ready__.TryPush(chunk);
+
+        { std::lock_guard<std::mutex> lock(mutex__); }
+        chunk_ready__.notify_one();
+    }
+}
+
+template<typename Scalar>
+void netz::BasicAugmentedStream<Scalar>::Fill(Dataset& chunk) {
+    const size_t count = options__.chunk_size;
+    std::uniform_int_distribution<size_t> label_dist(0, bases__.size() - 1);
+
+    chunk.inputs.rows = chunk.expected.rows = count;
+    chunk.inputs.data.resize(count * chunk.inputs.cols);
+    chunk.expected.data.assign(count * chunk.expected.cols, Scalar(0));
+
+    for (size_t i = 0; i < count; i++) {
+        const size_t label = label_dist(gen__);
+
+        Augment(bases__[label]).Unpack(chunk.inputs.Row(i));
+        chunk.expected.Row(i)[label] = Scalar(1);
+    }
+}
+
+template<typename Scalar>
+netz::PackedBitmap netz::BasicAugmentedStream<Scalar>::Augment(
+        const PackedBitmap& base) {
+    PackedBitmap bitmap = base;
+
+    if (options__.rotate) {
+        bitmap = shapes::Rotate(bitmap, options__.width,
+            std::uniform_int_distribution<unsigned>(0, 3)(gen__));
+    }
+
+    if (options__.max_shift) {
+        const shapes::Bounds bounds = shapes::GetBounds(bitmap,
+            options__.width);
+        const long shift = options__.max_shift;
+
+        // Пустая картинка не сдвигается
+        if (bounds.min_x <= bounds.max_x) {
+            std::uniform_int_distribution<long> dx(
+                -std::min<long>(shift, bounds.min_x),
+                std::min<long>(shift, options__.width - 1 - bounds.max_x));
+            std::uniform_int_distribution<long> dy(
+                -std::min<long>(shift, bounds.min_y),
+                std::min<long>(shift, options__.height - 1 - bounds.max_y));
+
+            // Порядок вызовов задан явно, чтобы поток не зависел от
+            // компилятора
+            const long shift_x = dx(gen__);
+            const long shift_y = dy(gen__);
+
+            bitmap = shapes::Shift(bitmap, options__.width, shift_x,
+                shift_y);
+        }
+    }
+
+    std::uniform_real_distribution<double> noise_dist(0.0, 1.0);
+
+    for (size_t i = 0; i < bitmap.Size(); i++) {
+        if (noise_dist(gen__) < options__.noise) {
+            bitmap.Flip(i);
+        }
+    }
+
+    return bitmap;
+}
+
+template class netz::BasicAugmentedStream<float>;
+template class netz::BasicAugmentedStream<double>;
@@ -0,0 +1,316 @@
+#include "netz_binary.hpp"
+#include "netz_formulas.hpp"
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME  = 1099511628211ull;
+
+size_t AlignUp(size_t value) {
+    return (value + netz::binary::ALIGNMENT - 1)
+        / netz::binary::ALIGNMENT * netz::binary::ALIGNMENT;
+}
+
+} // namespace
+
+bool netz::binary::IsModel(std::istream& in) {
+    const std::streampos position = in.tellg();
+    char magic[sizeof(MAGIC)];
+
+    in.read(magic, sizeof(magic));
+    const bool is_model = in.gcount() == sizeof(magic)
+        && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+
+    in.clear();
+    in.seekg(position);
+
+    return is_model;
+}
+
+netz::binary::Header netz::binary::ReadHeader(std::istream& in) {
+    Header header;
+
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+    if (in.gcount() != sizeof(header)
+            || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_FORMAT));
+    }
+
+    if (header.version != VERSION) {
+        throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_VERSION));
+    }
+
+    return header;
+}
+
+// FNV-1a, но по 8-байтным словам: блоки файла выровнены, так что хвост
+// короче слова бывает только у чужих данных
+uint64_t netz::binary::Checksum(const void *data, size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    uint64_t hash = FNV_OFFSET;
+    size_t i = 0;
+
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+
+    for (; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+const netz::binary::LayerRecord *netz::binary::Validate(const void *data,
+        size_t size, size_t scalar_size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    Header header;
+
+    if (size < sizeof(header)) {
+        throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_FORMAT));
+    }
+
+    std::memcpy(&header, bytes, sizeof(header));
+
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+            || header.file_size != size || header.layer_count == 0) {
+        throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_FORMAT));
+    }
+
+    if (header.version != VERSION) {
+        throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_VERSION));
+    }
+
+    if (header.scalar_size != scalar_size) {
+        throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_SCALAR));
+    }
+
+    const size_t table_end = sizeof(header)
+        + header.layer_count * sizeof(LayerRecord);
+
+    // Каждый вход первого слоя занимает в файле хотя бы одно число, так
+    // что их число ограничено размером файла еще до разбора слоев
+    if (table_end > size || header.input_count == 0
+            || header.input_count > size / scalar_size) {
+        throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_FORMAT));
+    }
+
+    const LayerRecord *records =
+        reinterpret_cast<const LayerRecord *>(bytes + sizeof(header));
+    size_t input_size = header.input_count;
+
+    for (size_t k = 0; k < header.layer_count; k++) {
+        const LayerRecord& record = records[k];
+
+        // Размер блока весов не вычисляется произведением: size *
+        // input_size * scalar_size переполняется и проходит проверку
+        if (record.size == 0 || record.input_size != input_size
+                || record.activation
+                    > static_cast<uint32_t>(math::activation::Kind::TANH)
+                || record.offset % ALIGNMENT != 0
+                || record.offset < table_end
+                || record.offset > size
+                || record.size > (size - record.offset) / scalar_size
+                    / record.input_size) {
+            throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_FORMAT));
+        }
+
+        input_size = record.size;
+    }
+
+    if (Checksum(bytes + sizeof(header), size - sizeof(header))
+            != header.checksum) {
+        throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_CHECKSUM));
+    }
+
+    return records;
+}
+
+// Файл собирается в памяти целиком и пишется одним вызовом write
+template<typename Scalar>
+std::ostream& netz::BasicNetzwerk<Scalar>::DumpBinary(
+        std::ostream& out) const {
+    using namespace binary;
+
+    if (!conv__.empty()) {
+        throw std::runtime_error(ErrMsg(ERR_MSG_CONV_BINARY));
+    }
+
+    size_t offset = AlignUp(sizeof(Header)
+        + layers__.size() * sizeof(LayerRecord));
+    std::vector<LayerRecord> records(layers__.size());
+
+    for (size_t k = 0; k < layers__.size(); k++) {
+        const Layer& l = layers__[k];
+
+        records[k] = LayerRecord();
+        records[k].size = l.Size();
+        records[k].input_size = l.InputSize();
+        records[k].activation = static_cast<uint32_t>(l.GetActivation());
+        records[k].offset = offset;
+
+        offset += AlignUp(l.Size() * l.InputSize() * sizeof(Scalar));
+    }
+
+    std::vector<char> buffer(offset, 0);
+
+    std::memcpy(buffer.data() + sizeof(Header), records.data(),
+        records.size() * sizeof(LayerRecord));
+
+    for (size_t k = 0; k < layers__.size(); k++) {
+        const Layer& l = layers__[k];
+
+        std::memcpy(buffer.data() + records[k].offset, l.Weights(0),
+            l.Size() * l.InputSize() * sizeof(Scalar));
+    }
+
+    Header header = Header();
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.scalar_size = sizeof(Scalar);
+    header.input_count = inputs__.size();
+    header.layer_count = layers__.size();
+    header.file_size = buffer.size();
+    header.checksum = Checksum(buffer.data() + sizeof(Header),
+        buffer.size() - sizeof(Header));
+
+    std::memcpy(buffer.data(), &header, sizeof(header));
+
+    return out.write(buffer.data(), buffer.size());
+}
+
+template<typename Scalar>
+netz::BasicNetzwerk<Scalar> netz::BasicNetzwerk<Scalar>::ReadBinary(
+        std::istream& in) {
+    const std::vector<char> buffer((std::istreambuf_iterator<char>(in)),
+        std::istreambuf_iterator<char>());
+
+    const binary::LayerRecord *records = binary::Validate(buffer.data(),
+        buffer.size(), sizeof(Scalar));
+
+    binary::Header header;
+    std::memcpy(&header, buffer.data(), sizeof(header));
+
+    // Входы добавляются до слоев, чтобы первый слой сразу получил
+    // матрицу нужной ширины
+    BasicNetzwerk netz;
+
+    for (size_t i = 0; i < header.input_count; i++) {
+        netz.AddInput(0);
+    }
+
+    for (size_t k = 0; k < header.layer_count; k++) {
+        netz.AddLayer(records[k].size,
+            static_cast<math::activation::Kind>(records[k].activation));
+
+        Layer& l = netz.layers__.back();
+        std::memcpy(l.Weights(0), buffer.data() + records[k].offset,
+            l.Size() * l.InputSize() * sizeof(Scalar));
+    }
+
+    return netz;
+}
+
+template<typename Scalar>
+netz::BasicMappedModel<Scalar>::BasicMappedModel(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_IO));
+    }
+
+    struct stat info;
+
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_IO));
+    }
+
+    size__ = info.st_size;
+    data__ = mmap(nullptr, size__, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data__ == MAP_FAILED) {
+        data__ = nullptr;
+        throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_IO));
+    }
+
+    const binary::LayerRecord *records;
+
+    try {
+        records = binary::Validate(data__, size__, sizeof(Scalar));
+    } catch (...) {
+        munmap(data__, size__);
+        throw;
+    }
+
+    binary::Header header;
+    std::memcpy(&header, data__, sizeof(header));
+    input_count__ = header.input_count;
+
+    const char *bytes = static_cast<const char *>(data__);
+
+    for (size_t k = 0; k < header.layer_count; k++) {
+        layers__.push_back({ records[k].size, records[k].input_size,
+            static_cast<math::activation::Kind>(records[k].activation),
+            reinterpret_cast<const Scalar *>(bytes + records[k].offset) });
+    }
+}
+
+template<typename Scalar>
+netz::BasicMappedModel<Scalar>::~BasicMappedModel() {
+    if (data__) {
+        munmap(data__, size__);
+    }
+}
+
+template<typename Scalar>
+size_t netz::BasicMappedModel<Scalar>::InputCount() const {
+    return input_count__;
+}
+
+template<typename Scalar>
+size_t netz::BasicMappedModel<Scalar>::OutputCount() const {
+    return layers__.back().size;
+}
+
+template<typename Scalar>
+size_t netz::BasicMappedModel<Scalar>::LayersCount() const {
+    return layers__.size();
+}
+
+template<typename Scalar>
+const netz::BasicMatrix<Scalar>&
+netz::BasicMappedModel<Scalar>::GetOutputsBatch(const Matrix& inputs,
+        Context& context) const {
+    return ForwardLayers(layers__, inputs, context);
+}
+
+template<typename Scalar>
+netz::BasicMatrix<Scalar> netz::BasicMappedModel<Scalar>::GetOutputsBatch(
+        const Matrix& inputs) const {
+    Context context;
+    return GetOutputsBatch(inputs, context);
+}
+
+template std::ostream& netz::BasicNetzwerk<float>::DumpBinary(
+    std::ostream&) const;
+template std::ostream& netz::BasicNetzwerk<double>::DumpBinary(
+    std::ostream&) const;
+template netz::BasicNetzwerk<float> netz::BasicNetzwerk<float>::ReadBinary(
+    std::istream&);
+template netz::BasicNetzwerk<double> netz::BasicNetzwerk<double>::ReadBinary(
+    std::istream&);
+template class netz::BasicMappedModel<float>;
+template class netz::BasicMappedModel<double>;
@@ -0,0 +1,189 @@
+#include "netz_compiled.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+template<typename Scalar>
+const netz::BasicMatrix<Scalar>& netz::ForwardLayers(
+        const std::vector<DenseLayerView<Scalar>>& layers,
+        const BasicMatrix<Scalar>& inputs,
+        BasicInferenceContext<Scalar>& context) {
+    const BasicMatrix<Scalar> *current = &inputs;
+
+    for (size_t k = 0; k < layers.size(); k++) {
+        const DenseLayerView<Scalar>& l = layers[k];
+        BasicMatrix<Scalar>& next = context.buffers__[k % 2];
+
+        ForwardDense(l.weights, l.size, l.input_size, l.activation,
+            *current, next);
+        current = &next;
+    }
+
+    return *current;
+}
+
+template<typename Scalar>
+netz::BasicCompiledModel<Scalar>::BasicCompiledModel(
+        const BasicNetzwerk<Scalar>& netz) {
+    if (netz.LayersCount() == 0) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_EMPTY_MODEL));
+    }
+
+    input_count__ = netz.InputCount();
+
+    size_t total = 0;
+    for (size_t k = 0; k < netz.ConvLayersCount(); k++) {
+        const ConvShape& shape = netz.GetConvLayer(k).Shape();
+        total += shape.filters * shape.PatchSize();
+    }
+
+    for (size_t k = 0; k < netz.LayersCount(); k++) {
+        const BasicLayer<Scalar>& l = netz.GetLayer(k);
+        total += l.Size() * l.InputSize();
+    }
+
+    // Буфер выделяется целиком до того, как берутся указатели на него
+    weights__.reserve(total);
+
+    for (size_t k = 0; k < netz.ConvLayersCount(); k++) {
+        const BasicConvLayer<Scalar>& c = netz.GetConvLayer(k);
+        const ConvShape& shape = c.Shape();
+        const size_t offset = weights__.size();
+
+        weights__.insert(weights__.end(), c.Weights(0),
+            c.Weights(0) + shape.filters * shape.PatchSize());
+        conv__.push_back({ shape, c.GetActivation(),
+            weights__.data() + offset });
+    }
+
+    for (size_t k = 0; k < netz.LayersCount(); k++) {
+        const BasicLayer<Scalar>& l = netz.GetLayer(k);
+        const Scalar *weights = l.Weights(0);
+        const size_t offset = weights__.size();
+
+        weights__.insert(weights__.end(), weights,
+            weights + l.Size() * l.InputSize());
+        layers__.push_back({ l.Size(), l.InputSize(), l.GetActivation(),
+            weights__.data() + offset });
+    }
+}
+
+template<typename Scalar>
+size_t netz::BasicCompiledModel<Scalar>::InputCount() const {
+    return input_count__;
+}
+
+template<typename Scalar>
+size_t netz::BasicCompiledModel<Scalar>::OutputCount() const {
+    return layers__.back().size;
+}
+
+template<typename Scalar>
+size_t netz::BasicCompiledModel<Scalar>::LayersCount() const {
+    return layers__.size();
+}
+
+// Свертки пишут в свою пару буферов контекста, полносвязные слои - в
+// свою, так что выход последней свертки не затирается первым слоем
+template<typename Scalar>
+const netz::BasicMatrix<Scalar>& netz::BasicCompiledModel<Scalar>::Forward(
+        const Matrix& inputs, Context& context) const {
+    const Matrix *current = &inputs;
+
+    for (size_t k = 0; k < conv__.size(); k++) {
+        const ConvLayerView<Scalar>& c = conv__[k];
+        Matrix& next = context.conv__[k % 2];
+
+        ForwardConv(c.weights, c.shape, c.activation, *current, next,
+            context.scratch__);
+        current = &next;
+    }
+
+    return ForwardLayers(layers__, *current, context);
+}
+
+template<typename Scalar>
+const Scalar *netz::BasicCompiledModel<Scalar>::GetOutputs(
+        const Scalar *inputs, Context& context) const {
+    Matrix& sample = context.sample__;
+
+    sample.rows = 1;
+    sample.cols = input_count__;
+    sample.data.assign(inputs, inputs + input_count__);
+
+    return Forward(sample, context).Row(0);
+}
+
+template<typename Scalar>
+const Scalar *netz::BasicCompiledModel<Scalar>::GetOutputs(
+        const PackedBitmap& bitmap, Context& context) const {
+    if (bitmap.Size() != input_count__) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_SIZES_DIFFER));
+    }
+
+    if (!conv__.empty()) {
+        Matrix& sample = context.sample__;
+
+        sample.rows = 1;
+        sample.cols = input_count__;
+        sample.data.resize(input_count__);
+        bitmap.Unpack(sample.data.data());
+
+        return Forward(sample, context).Row(0);
+    }
+
+    const DenseLayerView<Scalar>& first = layers__.front();
+    Matrix *current = &context.buffers__[0];
+
+    current->rows = 1;
+    current->cols = first.size;
+    current->data.resize(first.size);
+
+    for (size_t i = 0; i < first.size; i++) {
+        current->data[i] = math::simd::MaskedSum(
+            first.weights + i * first.input_size, bitmap.Words(),
+            input_count__);
+    }
+
+    math::activation::Visit(first.activation, [&](auto activation) {
+        using Activation = decltype(activation);
+
+        Activation::ApplyAll(current->data.data(), current->data.data(),
+            first.size);
+    });
+
+    for (size_t k = 1; k < layers__.size(); k++) {
+        const DenseLayerView<Scalar>& l = layers__[k];
+        Matrix& next = context.buffers__[k % 2];
+
+        ForwardDense(l.weights, l.size, l.input_size, l.activation,
+            *current, next);
+        current = &next;
+    }
+
+    return current->Row(0);
+}
+
+template<typename Scalar>
+const netz::BasicMatrix<Scalar>&
+netz::BasicCompiledModel<Scalar>::GetOutputsBatch(const Matrix& inputs,
+        Context& context) const {
+    return Forward(inputs, context);
+}
+
+template<typename Scalar>
+netz::BasicMatrix<Scalar> netz::BasicCompiledModel<Scalar>::GetOutputsBatch(
+        const Matrix& inputs) const {
+    Context context;
+    return GetOutputsBatch(inputs, context);
+}
+
+template class netz::BasicInferenceContext<float>;
+template class netz::BasicInferenceContext<double>;
+template class netz::BasicCompiledModel<float>;
+template class netz::BasicCompiledModel<double>;
+template const netz::BasicMatrix<float>& netz::ForwardLayers(
+    const std::vector<DenseLayerView<float>>&, const BasicMatrix<float>&,
+    BasicInferenceContext<float>&);
+template const netz::BasicMatrix<double>& netz::ForwardLayers(
+    const std::vector<DenseLayerView<double>>&, const BasicMatrix<double>&,
+    BasicInferenceContext<double>&);
@@ -0,0 +1,337 @@
+#include "netz.hpp"
+#include "netz_formulas.hpp"
+#include "netz_simd.hpp"
+#include <cmath>
+#include <stdexcept>
+
+double GetRandomDouble();
+
+namespace {
+
+// Раскладывает окна входа в матрицу shape.PatchSize() x
+// shape.Positions(): строка (c, ky, kx) - пиксели канала c со сдвигом
+// (kx, ky) во всех положениях ядра
+template<typename Scalar>
+void Im2Col(const netz::ConvShape& shape, const Scalar *input,
+        Scalar *patches) {
+    const size_t conv_height = shape.ConvHeight();
+    const size_t conv_width = shape.ConvWidth();
+
+    for (size_t c = 0; c < shape.channels; c++) {
+        const Scalar *map = input + c * shape.height * shape.width;
+
+        for (size_t ky = 0; ky < shape.kernel; ky++) {
+            for (size_t kx = 0; kx < shape.kernel; kx++) {
+                for (size_t y = 0; y < conv_height; y++) {
+                    const Scalar *from = map + (y + ky) * shape.width + kx;
+                    std::copy(from, from + conv_width, patches);
+                    patches += conv_width;
+                }
+            }
+        }
+    }
+}
+
+// Обратное к Im2Col: дельты окон добавляются к дельтам пикселей, из
+// которых окна были взяты
+template<typename Scalar>
+void Col2Im(const netz::ConvShape& shape, const Scalar *patch_deltas,
+        Scalar *input_deltas) {
+    const size_t conv_height = shape.ConvHeight();
+    const size_t conv_width = shape.ConvWidth();
+
+    for (size_t c = 0; c < shape.channels; c++) {
+        Scalar *map = input_deltas + c * shape.height * shape.width;
+
+        for (size_t ky = 0; ky < shape.kernel; ky++) {
+            for (size_t kx = 0; kx < shape.kernel; kx++) {
+                for (size_t y = 0; y < conv_height; y++) {
+                    Scalar *to = map + (y + ky) * shape.width + kx;
+
+                    for (size_t x = 0; x < conv_width; x++) {
+                        to[x] += patch_deltas[x];
+                    }
+
+                    patch_deltas += conv_width;
+                }
+            }
+        }
+    }
+}
+
+// sums (filters x Positions) = weights (filters x PatchSize) * patches
+template<typename Scalar>
+void Convolve(const Scalar *weights, const netz::ConvShape& shape,
+        const Scalar *patches, Scalar *sums) {
+    const size_t positions = shape.Positions();
+    const size_t patch_size = shape.PatchSize();
+
+    std::fill(sums, sums + shape.filters * positions, Scalar(0));
+
+    for (size_t f = 0; f < shape.filters; f++) {
+        for (size_t j = 0; j < patch_size; j++) {
+            netz::math::simd::Axpy(weights[f * patch_size + j],
+                patches + j * positions, sums + f * positions, positions);
+        }
+    }
+}
+
+// Max pooling карт maps в outputs. Если argmax не nullptr, туда пишется
+// индекс максимума в maps для каждого выхода.
+template<typename Scalar>
+void Pool(const netz::ConvShape& shape, const Scalar *maps, Scalar *outputs,
+        size_t *argmax) {
+    const size_t conv_width = shape.ConvWidth();
+    const size_t out_height = shape.OutputHeight();
+    const size_t out_width = shape.OutputWidth();
+
+    for (size_t f = 0; f < shape.filters; f++) {
+        const size_t map = f * shape.Positions();
+
+        for (size_t oy = 0; oy < out_height; oy++) {
+            for (size_t ox = 0; ox < out_width; ox++) {
+                size_t best = map + oy * shape.pool * conv_width
+                    + ox * shape.pool;
+
+                for (size_t py = 0; py < shape.pool; py++) {
+                    for (size_t px = 0; px < shape.pool; px++) {
+                        const size_t i = map
+                            + (oy * shape.pool + py) * conv_width
+                            + ox * shape.pool + px;
+
+                        if (maps[i] > maps[best]) {
+                            best = i;
+                        }
+                    }
+                }
+
+                const size_t o = (f * out_height + oy) * out_width + ox;
+
+                outputs[o] = maps[best];
+                if (argmax) {
+                    argmax[o] = best;
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+// Ядра начинаются со случайных весов обоих знаков, масштабированных по
+// числу весов ядра: фильтры с одинаковыми по знаку весами выделяли бы
+// только яркость, а не края.
+template<typename Scalar>
+netz::BasicConvLayer<Scalar>::BasicConvLayer(const ConvShape& shape,
+        math::activation::Kind activation)
+        : shape__(shape), activation__(activation),
+          weights__(shape.filters * shape.PatchSize()),
+          patches__(shape.PatchSize() * shape.Positions()),
+          sums__(shape.filters * shape.Positions()),
+          maps__(sums__.size()), outputs__(shape.OutputSize()),
+          argmax__(shape.OutputSize()), deltas__(shape.OutputSize()),
+          map_deltas__(sums__.size()), patch_deltas__(patches__.size()),
+          gradients__(weights__.size()) {
+    if (!shape.IsValid()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_CONV_SHAPE));
+    }
+
+    const double scale = 1.0 / std::sqrt(double(shape.PatchSize()));
+
+    for (Scalar& weight : weights__) {
+        weight = static_cast<Scalar>((2 * GetRandomDouble() - 1) * scale);
+    }
+}
+
+template<typename Scalar>
+const netz::ConvShape& netz::BasicConvLayer<Scalar>::Shape() const {
+    return shape__;
+}
+
+template<typename Scalar>
+size_t netz::BasicConvLayer<Scalar>::Size() const {
+    return outputs__.size();
+}
+
+template<typename Scalar>
+netz::math::activation::Kind
+netz::BasicConvLayer<Scalar>::GetActivation() const {
+    return activation__;
+}
+
+template<typename Scalar>
+Scalar *netz::BasicConvLayer<Scalar>::Weights(size_t filter) {
+    return weights__.data() + filter * shape__.PatchSize();
+}
+
+template<typename Scalar>
+const Scalar *netz::BasicConvLayer<Scalar>::Weights(size_t filter) const {
+    return weights__.data() + filter * shape__.PatchSize();
+}
+
+template<typename Scalar>
+Scalar *netz::BasicConvLayer<Scalar>::Gradients(size_t filter) {
+    return gradients__.data() + filter * shape__.PatchSize();
+}
+
+template<typename Scalar>
+const Scalar *netz::BasicConvLayer<Scalar>::Gradients(size_t filter) const {
+    return gradients__.data() + filter * shape__.PatchSize();
+}
+
+template<typename Scalar>
+const std::vector<Scalar>& netz::BasicConvLayer<Scalar>::Outputs() const {
+    return outputs__;
+}
+
+template<typename Scalar>
+Scalar *netz::BasicConvLayer<Scalar>::Deltas() {
+    return deltas__.data();
+}
+
+template<typename Scalar>
+const Scalar *netz::BasicConvLayer<Scalar>::Deltas() const {
+    return deltas__.data();
+}
+
+template<typename Scalar>
+netz::BasicConvLayer<Scalar>& netz::BasicConvLayer<Scalar>::ApplyGradients(
+        double scale) {
+    math::simd::Axpy(static_cast<Scalar>(scale), gradients__.data(),
+        weights__.data(), weights__.size());
+
+    std::fill(gradients__.begin(), gradients__.end(), Scalar(0));
+
+    return *this;
+}
+
+template<typename Scalar>
+netz::BasicConvLayer<Scalar>& netz::BasicConvLayer<Scalar>::CopyWeights(
+        const BasicConvLayer& other) {
+    if (other.weights__.size() != weights__.size()
+            || other.outputs__.size() != outputs__.size()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_SIZES_DIFFER));
+    }
+
+    std::copy(other.weights__.begin(), other.weights__.end(),
+        weights__.begin());
+
+    return *this;
+}
+
+template<typename Scalar>
+void netz::BasicConvLayer<Scalar>::Forward(const Scalar *inputs) {
+    Im2Col(shape__, inputs, patches__.data());
+    Convolve(weights__.data(), shape__, patches__.data(), sums__.data());
+
+    math::activation::Visit(activation__, [&](auto activation) {
+        using Activation = decltype(activation);
+
+        Activation::ApplyAll(sums__.data(), maps__.data(), sums__.size());
+    });
+
+    Pool(shape__, maps__.data(), outputs__.data(), argmax__.data());
+}
+
+template<typename Scalar>
+void netz::BasicConvLayer<Scalar>::ForwardBatch(const Matrix& inputs,
+        Matrix& outputs) const {
+    std::vector<Scalar> scratch;
+
+    ForwardConv(weights__.data(), shape__, activation__, inputs, outputs,
+        scratch);
+}
+
+template<typename Scalar>
+void netz::BasicConvLayer<Scalar>::Backward(double alpha, bool online,
+        Scalar *input_deltas) {
+    const size_t positions = shape__.Positions();
+    const size_t patch_size = shape__.PatchSize();
+
+    // Дельта выхода пулинга достается только максимуму своего квадрата
+    std::fill(map_deltas__.begin(), map_deltas__.end(), Scalar(0));
+    for (size_t o = 0; o < outputs__.size(); o++) {
+        map_deltas__[argmax__[o]] = deltas__[o];
+    }
+
+    math::activation::Visit(activation__, [&](auto activation) {
+        using Activation = decltype(activation);
+
+        for (size_t i = 0; i < map_deltas__.size(); i++) {
+            map_deltas__[i] *= Activation::Derivative(sums__[i], maps__[i]);
+        }
+    });
+
+    if (input_deltas) {
+        std::fill(patch_deltas__.begin(), patch_deltas__.end(), Scalar(0));
+
+        for (size_t f = 0; f < shape__.filters; f++) {
+            for (size_t j = 0; j < patch_size; j++) {
+                math::simd::Axpy(weights__[f * patch_size + j],
+                    map_deltas__.data() + f * positions,
+                    patch_deltas__.data() + j * positions, positions);
+            }
+        }
+
+        Col2Im(shape__, patch_deltas__.data(), input_deltas);
+    }
+
+    // Градиент веса ядра - сумма по всем положениям ядра, поэтому шаг
+    // делится на корень из их числа: иначе на больших картинках ядра
+    // меняются намного быстрее полносвязных слоев и обучение разваливается
+    const double step = (online ? alpha : 1.0) / std::sqrt(double(positions));
+    const Scalar scale = static_cast<Scalar>(step);
+
+    for (size_t f = 0; f < shape__.filters; f++) {
+        Scalar *target = online ? Weights(f) : Gradients(f);
+
+        for (size_t j = 0; j < patch_size; j++) {
+            target[j] += scale * math::simd::Dot(
+                map_deltas__.data() + f * positions,
+                patches__.data() + j * positions, positions);
+        }
+    }
+}
+
+template<typename Scalar>
+void netz::ForwardConv(const Scalar *weights, const ConvShape& shape,
+        math::activation::Kind activation, const BasicMatrix<Scalar>& inputs,
+        BasicMatrix<Scalar>& outputs, std::vector<Scalar>& scratch) {
+    if (inputs.cols != shape.InputSize()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_SIZES_DIFFER));
+    }
+
+    const size_t patches_size = shape.PatchSize() * shape.Positions();
+    const size_t sums_size = shape.filters * shape.Positions();
+
+    outputs.rows = inputs.rows;
+    outputs.cols = shape.OutputSize();
+    outputs.data.resize(outputs.rows * outputs.cols);
+
+    if (scratch.size() < patches_size + sums_size) {
+        scratch.resize(patches_size + sums_size);
+    }
+
+    Scalar *patches = scratch.data();
+    Scalar *sums = patches + patches_size;
+
+    math::activation::Visit(activation, [&](auto policy) {
+        using Activation = decltype(policy);
+
+        for (size_t m = 0; m < inputs.rows; m++) {
+            Im2Col(shape, inputs.Row(m), patches);
+            Convolve(weights, shape, patches, sums);
+            Activation::ApplyAll(sums, sums, sums_size);
+            Pool(shape, sums, outputs.Row(m), static_cast<size_t *>(nullptr));
+        }
+    });
+}
+
+template class netz::BasicConvLayer<float>;
+template class netz::BasicConvLayer<double>;
+template void netz::ForwardConv(const float *, const ConvShape&,
+    math::activation::Kind, const BasicMatrix<float>&, BasicMatrix<float>&,
+    std::vector<float>&);
+template void netz::ForwardConv(const double *, const ConvShape&,
+    math::activation::Kind, const BasicMatrix<double>&, BasicMatrix<double>&,
+    std::vector<double>&);
@@ -2,11 +2,45 @@
 #include "netz_formulas.hpp"
 
 double netz::math::actfunc::Sigma(double x) noexcept {
-    return 1 / (1 + std::exp(-x));
+    return activation::Sigma::Apply(x);
 }
 
 double netz::math::actfunc::SigmaMirrored(double x) noexcept {
-    return std::exp(x) / (1 + std::exp(-x));
+    return activation::SigmaMirrored::Apply(x);
+}
+
+double netz::math::actfunc::ReLU(double x) noexcept {
+    return activation::ReLU::Apply(x);
+}
+
+double netz::math::actfunc::Tanh(double x) noexcept {
+    return activation::Tanh::Apply(x);
+}
+
+const char *netz::math::activation::KindName(Kind kind) {
+    switch (kind) {
+        case Kind::SIGMA_MIRRORED:
+            return "sigma-mirrored";
+        case Kind::RELU:
+            return "relu";
+        case Kind::TANH:
+            return "tanh";
+        case Kind::SIGMA:
+        default:
+            return "sigma";
+    }
+}
+
+netz::math::activation::Kind netz::math::activation::KindFromName(
+        const std::string& name) {
+    for (Kind kind : { Kind::SIGMA, Kind::SIGMA_MIRRORED,
+            Kind::RELU, Kind::TANH }) {
+        if (name == KindName(kind)) {
+            return kind;
+        }
+    }
+
+    throw std::invalid_argument(ErrMsg(ERR_MSG_UNKNOWN_ACTIVATION));
 }
 
 double netz::math::DeltaCoeffLastLayer(double expected_value,
@@ -0,0 +1,284 @@
+#include "netz.hpp"
+#include "netz_formulas.hpp"
+#include "netz_simd.hpp"
+#include <random>
+#include <stdexcept>
+
+std::random_device rd;
+std::mt19937 gen(rd());
+std::uniform_real_distribution<> dis(0.0, 1.0);
+
+double GetRandomDouble() {
+	return dis(gen);
+}
+
+template<typename Scalar>
+netz::BasicLayer<Scalar>::BasicLayer(size_t size, size_t input_size,
+		math::activation::Kind activation)
+		: size__(size), input_size__(input_size), activation__(activation),
+		weights__(size * input_size), sums__(size), outputs__(size),
+		deltas__(size), gradients__(size * input_size) {
+	for (Scalar& weight : weights__) {
+		weight = static_cast<Scalar>(GetRandomDouble());
+	}
+}
+
+template<typename Scalar>
+netz::BasicLayer<Scalar>& netz::BasicLayer<Scalar>::AddInput() {
+	std::vector<Scalar> weights(size__ * (input_size__ + 1));
+
+	for (size_t i = 0; i < size__; i++) {
+		std::copy(Weights(i), Weights(i) + input_size__,
+			weights.begin() + i * (input_size__ + 1));
+		weights[i * (input_size__ + 1) + input_size__] =
+			static_cast<Scalar>(GetRandomDouble());
+	}
+
+	weights__ = std::move(weights);
+	input_size__++;
+	gradients__.assign(size__ * input_size__, Scalar(0));
+
+	return *this;
+}
+
+template<typename Scalar>
+void netz::BasicLayer<Scalar>::Forward(const Scalar *inputs) {
+	math::activation::Visit(activation__, [&](auto activation) {
+		ForwardImpl<decltype(activation)>(inputs);
+	});
+}
+
+template<typename Scalar>
+template<typename Activation>
+void netz::BasicLayer<Scalar>::ForwardImpl(const Scalar *inputs) {
+	for (size_t i = 0; i < size__; i++) {
+		sums__[i] = math::simd::Dot(inputs, Weights(i), input_size__);
+	}
+
+	Activation::ApplyAll(sums__.data(), outputs__.data(), size__);
+}
+
+template<typename Scalar>
+void netz::BasicLayer<Scalar>::ForwardDelta(const size_t *indices,
+		const Scalar *deltas, size_t count) {
+	for (size_t i = 0; i < size__; i++) {
+		const Scalar *weights = Weights(i);
+		Scalar sum = sums__[i];
+
+		for (size_t c = 0; c < count; c++) {
+			sum += weights[indices[c]] * deltas[c];
+		}
+
+		sums__[i] = sum;
+	}
+
+	math::activation::Visit(activation__, [&](auto activation) {
+		using Activation = decltype(activation);
+
+		Activation::ApplyAll(sums__.data(), outputs__.data(), size__);
+	});
+}
+
+template<typename Scalar>
+void netz::BasicLayer<Scalar>::ApplyDerivative(Scalar *deltas) const {
+	math::activation::Visit(activation__, [&](auto activation) {
+		using Activation = decltype(activation);
+
+		for (size_t i = 0; i < size__; i++) {
+			deltas[i] *= Activation::Derivative(sums__[i], outputs__[i]);
+		}
+	});
+}
+
+template<typename Scalar>
+netz::BasicLayer<Scalar>& netz::BasicLayer<Scalar>::SetWeight(size_t neuron,
+		size_t index, Scalar weight) {
+	if (neuron >= size__ || index >= input_size__) {
+		throw std::invalid_argument(ErrMsg(ERR_MSG_INDEX_OOB));
+	}
+
+	weights__[neuron * input_size__ + index] = weight;
+
+	return *this;
+}
+
+template<typename Scalar>
+Scalar netz::BasicLayer<Scalar>::GetWeight(size_t neuron,
+		size_t index) const {
+	if (neuron >= size__ || index >= input_size__) {
+		throw std::invalid_argument(ErrMsg(ERR_MSG_INDEX_OOB));
+	}
+
+	return weights__[neuron * input_size__ + index];
+}
+
+template<typename Scalar>
+Scalar netz::BasicLayer<Scalar>::GetOutput(size_t neuron) const {
+	if (neuron >= size__) {
+		throw std::invalid_argument(ErrMsg(ERR_MSG_INDEX_OOB));
+	}
+
+	return outputs__[neuron];
+}
+
+template<typename Scalar>
+size_t netz::BasicLayer<Scalar>::Size() const {
+	return size__;
+}
+
+template<typename Scalar>
+size_t netz::BasicLayer<Scalar>::InputSize() const {
+	return input_size__;
+}
+
+template<typename Scalar>
+netz::math::activation::Kind
+netz::BasicLayer<Scalar>::GetActivation() const {
+	return activation__;
+}
+
+template<typename Scalar>
+Scalar *netz::BasicLayer<Scalar>::Weights(size_t neuron) {
+	return weights__.data() + neuron * input_size__;
+}
+
+template<typename Scalar>
+const Scalar *netz::BasicLayer<Scalar>::Weights(size_t neuron) const {
+	return weights__.data() + neuron * input_size__;
+}
+
+template<typename Scalar>
+const std::vector<Scalar>& netz::BasicLayer<Scalar>::Outputs() const {
+	return outputs__;
+}
+
+template<typename Scalar>
+Scalar *netz::BasicLayer<Scalar>::Deltas() {
+	return deltas__.data();
+}
+
+template<typename Scalar>
+const Scalar *netz::BasicLayer<Scalar>::Deltas() const {
+	return deltas__.data();
+}
+
+template<typename Scalar>
+Scalar *netz::BasicLayer<Scalar>::Gradients(size_t neuron) {
+	return gradients__.data() + neuron * input_size__;
+}
+
+template<typename Scalar>
+const Scalar *netz::BasicLayer<Scalar>::Gradients(size_t neuron) const {
+	return gradients__.data() + neuron * input_size__;
+}
+
+template<typename Scalar>
+netz::BasicLayer<Scalar>& netz::BasicLayer<Scalar>::CopyWeights(
+		const BasicLayer& other) {
+	if (other.size__ != size__ || other.input_size__ != input_size__) {
+		throw std::invalid_argument(ErrMsg(ERR_MSG_SIZES_DIFFER));
+	}
+
+	std::copy(other.weights__.begin(), other.weights__.end(),
+		weights__.begin());
+
+	return *this;
+}
+
+template<typename Scalar>
+netz::BasicLayer<Scalar>& netz::BasicLayer<Scalar>::ApplyGradients(
+		double scale) {
+	math::simd::Axpy(static_cast<Scalar>(scale), gradients__.data(),
+		weights__.data(), weights__.size());
+
+	std::fill(gradients__.begin(), gradients__.end(), Scalar(0));
+
+	return *this;
+}
+
+template<typename Scalar>
+void netz::BasicLayer<Scalar>::ForwardBatch(const Matrix& inputs,
+		Matrix& outputs) const {
+	ForwardDense(weights__.data(), size__, input_size__, activation__, inputs,
+		outputs);
+}
+
+namespace {
+
+// Образцы обрабатываются блоками по BATCH_BLOCK строк: строка весов
+// нейрона читается один раз на весь блок, а не на каждый образец.
+template<typename Activation, typename Scalar>
+void ForwardDenseImpl(const Scalar *weights, size_t size, size_t input_size,
+		const netz::BasicMatrix<Scalar>& inputs,
+		netz::BasicMatrix<Scalar>& outputs) {
+	constexpr size_t BATCH_BLOCK = 4;
+
+	outputs.rows = inputs.rows;
+	outputs.cols = size;
+	outputs.data.resize(outputs.rows * outputs.cols);
+
+	size_t m = 0;
+	for (; m + BATCH_BLOCK <= inputs.rows; m += BATCH_BLOCK) {
+		Scalar sums[BATCH_BLOCK];
+
+		for (size_t i = 0; i < size; i++) {
+			netz::math::simd::Dot4(weights + i * input_size, inputs.Row(m),
+				inputs.Row(m + 1), inputs.Row(m + 2), inputs.Row(m + 3),
+				input_size, sums);
+
+			for (size_t b = 0; b < BATCH_BLOCK; b++) {
+				outputs.Row(m + b)[i] = sums[b];
+			}
+		}
+	}
+
+	for (; m < inputs.rows; m++) {
+		for (size_t i = 0; i < size; i++) {
+			outputs.Row(m)[i] = netz::math::simd::Dot(inputs.Row(m),
+				weights + i * input_size, input_size);
+		}
+	}
+
+	Activation::ApplyAll(outputs.data.data(), outputs.data.data(),
+		outputs.data.size());
+}
+
+} // namespace
+
+template<typename Scalar>
+void netz::ForwardDense(const Scalar *weights, size_t size, size_t input_size,
+		math::activation::Kind activation, const BasicMatrix<Scalar>& inputs,
+		BasicMatrix<Scalar>& outputs) {
+	if (inputs.cols != input_size) {
+		throw std::invalid_argument(ErrMsg(ERR_MSG_SIZES_DIFFER));
+	}
+
+	math::activation::Visit(activation, [&](auto policy) {
+		ForwardDenseImpl<decltype(policy)>(weights, size, input_size, inputs,
+			outputs);
+	});
+}
+
+template<typename Scalar>
+netz::BasicMatrix<Scalar>::BasicMatrix(size_t rows, size_t cols)
+		: rows(rows), cols(cols), data(rows * cols) {}
+
+template<typename Scalar>
+Scalar *netz::BasicMatrix<Scalar>::Row(size_t r) {
+	return data.data() + r * cols;
+}
+
+template<typename Scalar>
+const Scalar *netz::BasicMatrix<Scalar>::Row(size_t r) const {
+	return data.data() + r * cols;
+}
+
+template struct netz::BasicMatrix<float>;
+template struct netz::BasicMatrix<double>;
+template class netz::BasicLayer<float>;
+template class netz::BasicLayer<double>;
+template void netz::ForwardDense(const float *, size_t, size_t,
+	math::activation::Kind, const BasicMatrix<float>&, BasicMatrix<float>&);
+template void netz::ForwardDense(const double *, size_t, size_t,
+	math::activation::Kind, const BasicMatrix<double>&,
+	BasicMatrix<double>&);
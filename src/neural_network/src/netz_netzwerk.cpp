@@ -1,10 +1,18 @@
 #include "netz.hpp"
 #include "netz_formulas.hpp"
+#include "netz_model_parser.hpp"
+#include <algorithm>
 #include <initializer_list>
 #include <iostream>
+#include <limits>
+#include <numeric>
 #include <stdexcept>
+#include <string_view>
+#include <vector>
 
-netz::Netzwerk::Netzwerk(std::initializer_list<double> inputs,
+template<typename Scalar>
+netz::BasicNetzwerk<Scalar>::BasicNetzwerk(
+        std::initializer_list<Scalar> inputs,
         std::initializer_list<size_t> layer_sizes)
         : inputs__(inputs), layers__() {
     for (const size_t size : layer_sizes) {
@@ -12,91 +20,309 @@ netz::Netzwerk::Netzwerk(std::initializer_list<double> inputs,
     }
 }
 
-netz::Netzwerk& netz::Netzwerk::AddLayer(size_t s) {
-    std::function<void(Neuron&)> connect_neuron;
+template<typename Scalar>
+netz::BasicNetzwerk<Scalar>& netz::BasicNetzwerk<Scalar>::AddLayer(size_t s,
+        math::activation::Kind activation) {
+    const size_t input_size = layers__.empty()
+        ? FeatureCount()
+        : layers__.back().Size();
 
+    layers__.emplace_back(s, input_size, activation);
+    needs_recalculation__ = true;
+    weights_changed__ = true;
+
+    return *this;
+}
+
+template<typename Scalar>
+netz::BasicNetzwerk<Scalar>& netz::BasicNetzwerk<Scalar>::AddConvolution(
+        const ConvShape& shape, math::activation::Kind activation) {
     if (!layers__.empty()) {
-        connect_neuron = [this](Neuron& neuron) -> void {
-            const Layer& last = *(layers__.end() - 2);
-            for (const Neuron& n : last) {
-                neuron.AddInput(n.GetOutput());
-            }
-        };
-    } else {
-        connect_neuron = [this](Neuron& neuron) -> void {
-            for (double input : inputs__) {
-                neuron.AddInput(input);
-            }
-        };
+        throw std::invalid_argument(ErrMsg(ERR_MSG_CONV_ORDER));
     }
 
-    layers__.emplace_back(s, Neuron(math::actfunc::Sigma));
+    if (!shape.IsValid()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_CONV_SHAPE));
+    }
 
-    for (	auto iter = layers__.back().begin();
-        iter != layers__.back().end(); iter++ )
-        connect_neuron(*iter);
+    if (shape.InputSize() != FeatureCount()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_SIZES_DIFFER));
+    }
 
+    conv__.emplace_back(shape, activation);
     needs_recalculation__ = true;
+    weights_changed__ = true;
 
     return *this;
 }
 
-netz::Netzwerk& netz::Netzwerk::AddInput(double input) {
+template<typename Scalar>
+netz::BasicNetzwerk<Scalar>& netz::BasicNetzwerk<Scalar>::AddInput(
+        Scalar input) {
+    if (!conv__.empty()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_CONV_ORDER));
+    }
+
     inputs__.push_back(input);
     needs_recalculation__ = true;
+    weights_changed__ = true;
 
     if (layers__.empty()) return *this;
 
-    for (int i = 0; i < layers__.front().size(); i++) {
-        Neuron& n = layers__.front().at(i);
-        n.AddInput(input);
+    layers__.front().AddInput();
+
+    return *this;
+}
+
+template<typename Scalar>
+netz::BasicNetzwerk<Scalar>& netz::BasicNetzwerk<Scalar>::SetBatchSize(
+        size_t batch_size) {
+    if (batch_size == 0) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_BATCH_SIZE));
+    }
+
+    batch_size__ = batch_size;
+
+    return *this;
+}
+
+template<typename Scalar>
+size_t netz::BasicNetzwerk<Scalar>::GetBatchSize() const {
+    return batch_size__;
+}
+
+template<typename Scalar>
+netz::BasicNetzwerk<Scalar>& netz::BasicNetzwerk<Scalar>::ApplyGradients(
+        double alpha) {
+    if (batch_count__ == 0) return *this;
+
+    for (ConvLayer& c : conv__) {
+        c.ApplyGradients(alpha);
+    }
+
+    for (Layer& l : layers__) {
+        l.ApplyGradients(alpha);
+    }
+
+    batch_count__ = 0;
+    needs_recalculation__ = true;
+    weights_changed__ = true;
+
+    return *this;
+}
+
+template<typename Scalar>
+netz::BasicNetzwerk<Scalar>& netz::BasicNetzwerk<Scalar>::CopyWeights(
+        const BasicNetzwerk& other) {
+    if (other.layers__.size() != layers__.size()
+            || other.conv__.size() != conv__.size()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_SIZES_DIFFER));
+    }
+
+    for (size_t k = 0; k < conv__.size(); k++) {
+        conv__[k].CopyWeights(other.conv__[k]);
     }
 
+    for (size_t k = 0; k < layers__.size(); k++) {
+        layers__[k].CopyWeights(other.layers__[k]);
+    }
+
+    needs_recalculation__ = true;
+    weights_changed__ = true;
+
     return *this;
 }
 
-void netz::Netzwerk::Update() {
-    for (size_t k = 1; k < layers__.size(); k++) {
-        Layer& prev_layer = layers__[k - 1];
-        for (Neuron& n : layers__.at(k)) {
-            for (size_t po = 0; po < prev_layer.size(); po++) {
-                n.SetInput(po, prev_layer.at(po).GetOutput());
+template<typename Scalar>
+netz::BasicNetzwerk<Scalar>& netz::BasicNetzwerk<Scalar>::Invalidate() {
+    needs_recalculation__ = true;
+    weights_changed__ = true;
+
+    return *this;
+}
+
+template<typename Scalar>
+size_t netz::BasicNetzwerk<Scalar>::LayersCount() const {
+    return layers__.size();
+}
+
+template<typename Scalar>
+netz::BasicLayer<Scalar>& netz::BasicNetzwerk<Scalar>::GetLayer(size_t k) {
+    if (k >= layers__.size()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_INDEX_OOB));
+    }
+
+    return layers__[k];
+}
+
+template<typename Scalar>
+const netz::BasicLayer<Scalar>& netz::BasicNetzwerk<Scalar>::GetLayer(
+        size_t k) const {
+    if (k >= layers__.size()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_INDEX_OOB));
+    }
+
+    return layers__[k];
+}
+
+template<typename Scalar>
+size_t netz::BasicNetzwerk<Scalar>::ConvLayersCount() const {
+    return conv__.size();
+}
+
+template<typename Scalar>
+netz::BasicConvLayer<Scalar>& netz::BasicNetzwerk<Scalar>::GetConvLayer(
+        size_t k) {
+    if (k >= conv__.size()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_INDEX_OOB));
+    }
+
+    return conv__[k];
+}
+
+template<typename Scalar>
+const netz::BasicConvLayer<Scalar>& netz::BasicNetzwerk<Scalar>::GetConvLayer(
+        size_t k) const {
+    if (k >= conv__.size()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_INDEX_OOB));
+    }
+
+    return conv__[k];
+}
+
+template<typename Scalar>
+size_t netz::BasicNetzwerk<Scalar>::InputCount() const {
+    return inputs__.size();
+}
+
+template<typename Scalar>
+size_t netz::BasicNetzwerk<Scalar>::FeatureCount() const {
+    return conv__.empty() ? inputs__.size() : conv__.back().Size();
+}
+
+template<typename Scalar>
+const Scalar *netz::BasicNetzwerk<Scalar>::LayerInputs(size_t k) const {
+    if (k > 0) {
+        return layers__[k - 1].Outputs().data();
+    }
+
+    return conv__.empty() ? inputs__.data() : conv__.back().Outputs().data();
+}
+
+// Если с прошлого прохода менялись только входы и таких входов немного,
+// суммы первого слоя поправляются на w * dx по изменившимся входам.
+// Выходы первого слоя от этого меняются все, так что остальные слои
+// считаются полностью. Ошибка округления от поправок копится, поэтому
+// раз в INCREMENTAL_REFRESH таких проходов делается полный. После
+// свертки изменение одного входа задевает много ее выходов, так что с
+// ней проход всегда полный.
+template<typename Scalar>
+void netz::BasicNetzwerk<Scalar>::Update() {
+    if (layers__.empty()) return;
+
+    if (conv__.empty() && !weights_changed__
+            && incremental_passes__ < INCREMENTAL_REFRESH) {
+        changed_inputs__.clear();
+        input_deltas__.clear();
+
+        for (size_t j = 0; j < inputs__.size(); j++) {
+            if (inputs__[j] != forward_inputs__[j]) {
+                changed_inputs__.push_back(j);
+                input_deltas__.push_back(inputs__[j] - forward_inputs__[j]);
             }
         }
+
+        if (changed_inputs__.empty()) return;
+
+        if (changed_inputs__.size() * INCREMENTAL_MAX_SHARE
+                <= inputs__.size()) {
+            layers__.front().ForwardDelta(changed_inputs__.data(),
+                input_deltas__.data(), changed_inputs__.size());
+
+            for (size_t j : changed_inputs__) {
+                forward_inputs__[j] = inputs__[j];
+            }
+
+            for (size_t k = 1; k < layers__.size(); k++) {
+                layers__[k].Forward(LayerInputs(k));
+            }
+
+            incremental_passes__++;
+            return;
+        }
+    }
+
+    for (size_t k = 0; k < conv__.size(); k++) {
+        conv__[k].Forward(k == 0 ? inputs__.data()
+            : conv__[k - 1].Outputs().data());
+    }
+
+    for (size_t k = 0; k < layers__.size(); k++) {
+        layers__[k].Forward(LayerInputs(k));
     }
+
+    forward_inputs__ = inputs__;
+    weights_changed__ = false;
+    incremental_passes__ = 0;
 }
 
-std::vector<double> netz::Netzwerk::GetOuputs() {
+template<typename Scalar>
+std::vector<Scalar> netz::BasicNetzwerk<Scalar>::GetOuputs() {
     if (needs_recalculation__) {
         Update();
         needs_recalculation__ = false;
     }
 
-    std::vector<double> outputs;
-    for (const Neuron& n : layers__.back()) {
-        outputs.push_back(n.GetOutput());
+    return layers__.back().Outputs();
+}
+
+template<typename Scalar>
+netz::BasicMatrix<Scalar> netz::BasicNetzwerk<Scalar>::GetOutputsBatch(
+        const Matrix& inputs) const {
+    if (inputs.cols != inputs__.size()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_SIZES_DIFFER));
+    }
+
+    Matrix current = inputs;
+    Matrix next;
+
+    for (const ConvLayer& c : conv__) {
+        c.ForwardBatch(current, next);
+        std::swap(current, next);
     }
 
-    return outputs;
+    for (const Layer& l : layers__) {
+        l.ForwardBatch(current, next);
+        std::swap(current, next);
+    }
+
+    return current;
 }
 
-netz::Netzwerk& netz::Netzwerk::SetInput(size_t index, double input) {
+template<typename Scalar>
+netz::BasicNetzwerk<Scalar>& netz::BasicNetzwerk<Scalar>::SetInput(
+        size_t index, Scalar input) {
     if (index >= inputs__.size()) {
         throw std::invalid_argument(ErrMsg(ERR_MSG_INDEX_OOB));
     }
 
-    for (int i = 0; i < layers__.front().size(); i++) {
-        Neuron& n = layers__.front().at(i);
-        n.SetInput(index, input);
-    }
-
     inputs__[index] = input;
     needs_recalculation__ = true;
 
     return *this;
 }
 
-double netz::Netzwerk::GetInput(size_t index) const {
+template<typename Scalar>
+netz::BasicNetzwerk<Scalar>& netz::BasicNetzwerk<Scalar>::SetInputs(
+        const Scalar *inputs) {
+    std::copy(inputs, inputs + inputs__.size(), inputs__.begin());
+    needs_recalculation__ = true;
+
+    return *this;
+}
+
+template<typename Scalar>
+Scalar netz::BasicNetzwerk<Scalar>::GetInput(size_t index) const {
     if (index >= inputs__.size()) {
         throw std::invalid_argument(ErrMsg(ERR_MSG_INDEX_OOB));
     }
@@ -104,121 +330,271 @@ double netz::Netzwerk::GetInput(size_t index) const {
     return inputs__.at(index);
 }
 
-std::ostream& netz::Netzwerk::DumpWeights(std::ostream& out) const {
+template<typename Scalar>
+std::ostream& netz::BasicNetzwerk<Scalar>::DumpWeights(
+        std::ostream& out) const {
+    const std::streamsize precision =
+        out.precision(std::numeric_limits<Scalar>::max_digits10);
+
     bool is_first = true;
+    for (const ConvLayer& c : conv__) {
+        for (size_t f = 0; f < c.Shape().filters; f++) {
+            for (size_t j = 0; j < c.Shape().PatchSize(); j++) {
+                if (!is_first) {
+                    out << '\n';
+                }
+
+                is_first = false;
+                out << c.Weights(f)[j];
+            }
+        }
+    }
+
     for (int k = 0; k < layers__.size(); k++) {
-        for (int i = 0; i < layers__.at(k).size(); i++) {
-            for (int j = 0; j < layers__.at(k).at(i).InputSize(); j++) {
+        for (int i = 0; i < layers__.at(k).Size(); i++) {
+            for (int j = 0; j < layers__.at(k).InputSize(); j++) {
                 if (!is_first) {
-                    out << std::endl;
+                    out << '\n';
                 }
 
                 is_first = false;
-                out << layers__.at(k).at(i).GetWeight(j);
+                out << layers__.at(k).GetWeight(i, j);
             }
         }
     }
+
+    out.precision(precision);
     return out;
 }
 
-std::ostream& netz::Netzwerk::DumpStructure(std::ostream& out) const {
+template<typename Scalar>
+std::ostream& netz::BasicNetzwerk<Scalar>::DumpStructure(
+        std::ostream& out) const {
+    const std::streamsize precision =
+        out.precision(std::numeric_limits<Scalar>::max_digits10);
+
     bool is_first = true;
-    out << ">" << inputs__.size() << std::endl;
+    out << ">" << inputs__.size() << '\n';
+    for (size_t k = 0; k < conv__.size(); k++) {
+        const ConvShape& shape = conv__[k].Shape();
+
+        out << "%" << k << "/" << shape.channels << "x" << shape.height
+            << "x" << shape.width << "/" << shape.filters << "/"
+            << shape.kernel << "/" << shape.pool << "/"
+            << math::activation::KindName(conv__[k].GetActivation()) << '\n';
+
+        for (size_t f = 0; f < shape.filters; f++) {
+            for (size_t j = 0; j < shape.PatchSize(); j++) {
+                out << "#" << conv__[k].Weights(f)[j] << '\n';
+            }
+        }
+    }
+
     for (int k = 0; k < layers__.size(); k++) {
-        for (int i = 0; i < layers__.at(k).size(); i++) {
-        out << "@" << k << "/" << i << std::endl;
+        // Сигмоида подразумевается по умолчанию, строка с функцией
+        // активации пишется только для остальных
+        if (layers__.at(k).GetActivation() != math::activation::Kind::SIGMA) {
+            out << "!" << k << "/"
+                << math::activation::KindName(layers__.at(k).GetActivation())
+                << '\n';
+        }
 
-            for (int j = 0; j < layers__.at(k).at(i).InputSize(); j++) {
+        for (int i = 0; i < layers__.at(k).Size(); i++) {
+        out << "@" << k << "/" << i << '\n';
+
+            for (int j = 0; j < layers__.at(k).InputSize(); j++) {
                 if (!is_first) {
-                    out << std::endl;
+                    out << '\n';
                 }
 
                 // is_first = false;
-                out << "#" << layers__.at(k).at(i).GetWeight(j) << std::endl;
+                out << "#" << layers__.at(k).GetWeight(i, j) << '\n';
             }
         }
     }
 
+    out.precision(precision);
     return out;
 }
 
-netz::Netzwerk netz::Netzwerk::ReadStructure(std::istream& in) {
-    std::string line;
-    std::vector<std::vector<std::vector<double>>> weights;
-    int input_count = 0;
-
-    int layer = 0;
-    int neuron = 0;
-    while (std::getline(in, line)) {
-        if (line.empty()) continue; // Skip empty lines
-        std::cout << "Line: " << line << std::endl;
+namespace {
+
+// Веса всех нейронов складываются в один массив, нейрон помнит свой
+// отрезок в нем. Сеть строится, когда известна вся топология.
+template<typename Scalar>
+struct StructureCollector {
+    struct Neuron {
+        size_t layer;
+        size_t neuron;
+        size_t begin;
+        size_t end;
+    };
+
+    struct Convolution {
+        netz::ConvShape                 shape;
+        netz::math::activation::Kind    activation;
+        size_t                          begin;
+        size_t                          end;
+    };
+
+    size_t                                      input_count = 0;
+    std::vector<Convolution>                    convolutions;
+    std::vector<size_t>                         layer_sizes;
+    std::vector<netz::math::activation::Kind>   activations;
+    std::vector<Neuron>                         neurons;
+    std::vector<Scalar>                         weights;
+    // Куда идут веса: в последнюю свертку или в последний нейрон
+    bool                                        in_convolution = false;
+
+    void OnInputCount(size_t count) {
+        input_count = count;
+    }
 
-        if (line[0] == '>') {
-            std::string input_count_str = line.substr(1); // remove '>'
-            input_count = std::stoi(input_count_str);
+    // Свертки идут по порядку, индекс в дампе только для читателя
+    void OnConvolution(size_t, const netz::parser::Convolution& conv) {
+        netz::ConvShape shape;
+        shape.channels = conv.channels;
+        shape.height = conv.height;
+        shape.width = conv.width;
+        shape.filters = conv.filters;
+        shape.kernel = conv.kernel;
+        shape.pool = conv.pool;
+
+        convolutions.push_back({ shape,
+            netz::math::activation::KindFromName(
+                std::string(conv.activation)),
+            weights.size(), weights.size() });
+        in_convolution = true;
+    }
 
-        } else if (line[0] == '@') {
-            // Parse the indices
-            std::string indices = line.substr(1); // Remove '@'
-            size_t delimiterPos = indices.find('/');
-            if (delimiterPos == std::string::npos) {
-                throw std::runtime_error("Invalid index format.");
-            }
+    void OnActivation(size_t layer, std::string_view name) {
+        if (layer >= activations.size()) {
+            activations.resize(layer + 1,
+                netz::math::activation::Kind::SIGMA);
+        }
 
-            layer  = std::stoi(indices.substr(0, delimiterPos));
-            neuron = std::stoi(indices.substr(delimiterPos + 1));
+        activations[layer] = netz::math::activation::KindFromName(
+            std::string(name));
+    }
 
-            // Ensure the array is large enough
-            if (layer >= weights.size()) {
-                weights.resize(layer + 1);
-            }
+    void OnNeuron(size_t layer, size_t neuron) {
+        if (layer >= layer_sizes.size()) {
+            layer_sizes.resize(layer + 1, 0);
+        }
 
-            if (neuron >= weights[layer].size()) {
-                weights[layer].resize(neuron + 1);
-            }
+        layer_sizes[layer] = std::max(layer_sizes[layer], neuron + 1);
+        neurons.push_back({ layer, neuron, weights.size(), weights.size() });
+        in_convolution = false;
+    }
 
-        } else if (line[0] == '#') {
-            double value = std::stod(line.substr(1)); // Remove '#'
-            weights[layer][neuron].push_back(value);
+    void OnWeight(double weight) {
+        weights.push_back(static_cast<Scalar>(weight));
 
+        if (in_convolution) {
+            convolutions.back().end++;
+        } else {
+            neurons.back().end++;
         }
     }
+};
+
+} // namespace
+
+template<typename Scalar>
+netz::BasicNetzwerk<Scalar> netz::BasicNetzwerk<Scalar>::ReadStructure(
+        std::istream& in) {
+    StructureCollector<Scalar> collector;
+    parser::ParseModel(in, collector);
+
+    // Недостающий вес остался бы случайным начальным, так что неполный
+    // дамп (например, обрезанный файл) не загружается
+    if (collector.input_count == 0 || collector.layer_sizes.empty()
+            || std::count(collector.layer_sizes.begin(),
+                collector.layer_sizes.end(), 0) != 0) {
+        throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_FORMAT));
+    }
 
-    Netzwerk netz;
+    collector.activations.resize(collector.layer_sizes.size(),
+        math::activation::Kind::SIGMA);
 
-    for (layer = 0; layer < weights.size(); layer++) {
-        netz.AddLayer(weights.at(layer).size());
-    }
+    // Входы добавляются до слоев, чтобы первый слой сразу получил
+    // матрицу нужной ширины
+    BasicNetzwerk netz;
 
-    for (int i = 0; i < input_count; i++) {
+    for (size_t i = 0; i < collector.input_count; i++) {
         netz.AddInput(0);
     }
 
-    for (layer = 0; layer < weights.size(); layer++) {
-        for (neuron = 0; neuron < weights.at(layer).size(); neuron++) {
-            for (int weight = 0; weight < weights.at(layer).at(neuron).size(); weight++) {
-                netz.layers__.at(layer).at(neuron).SetWeight(
-                        weight,
-                        weights.at(layer).at(neuron).at(weight)
-                    );
-            }
+    for (const auto& conv : collector.convolutions) {
+        netz.AddConvolution(conv.shape, conv.activation);
+
+        ConvLayer& c = netz.conv__.back();
+        const size_t count = conv.shape.filters * conv.shape.PatchSize();
+
+        if (conv.end - conv.begin != count) {
+            throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_FORMAT));
         }
+
+        std::copy(collector.weights.begin() + conv.begin,
+            collector.weights.begin() + conv.end, c.Weights(0));
+    }
+
+    for (size_t k = 0; k < collector.layer_sizes.size(); k++) {
+        netz.AddLayer(collector.layer_sizes[k], collector.activations[k]);
+    }
+
+    // Каждый нейрон должен встретиться ровно один раз со всеми весами
+    std::vector<std::vector<bool>> loaded(collector.layer_sizes.size());
+
+    for (size_t k = 0; k < loaded.size(); k++) {
+        loaded[k].resize(collector.layer_sizes[k], false);
+    }
+
+    for (const auto& neuron : collector.neurons) {
+        Layer& l = netz.layers__.at(neuron.layer);
+
+        if (neuron.end - neuron.begin != l.InputSize()
+                || loaded[neuron.layer][neuron.neuron]) {
+            throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_FORMAT));
+        }
+
+        loaded[neuron.layer][neuron.neuron] = true;
+        std::copy(collector.weights.begin() + neuron.begin,
+            collector.weights.begin() + neuron.end, l.Weights(neuron.neuron));
+    }
+
+    if (collector.neurons.size() != std::accumulate(
+            collector.layer_sizes.begin(), collector.layer_sizes.end(),
+            size_t(0))) {
+        throw std::runtime_error(ErrMsg(ERR_MSG_MODEL_FORMAT));
     }
 
     return netz;
 }
 
-netz::Netzwerk& netz::Netzwerk::ReadWeights(std::istream& in) {
-    bool is_first = true;
+template<typename Scalar>
+netz::BasicNetzwerk<Scalar>& netz::BasicNetzwerk<Scalar>::ReadWeights(
+        std::istream& in) {
+    for (ConvLayer& c : conv__) {
+        for (size_t f = 0; f < c.Shape().filters; f++) {
+            for (size_t j = 0; j < c.Shape().PatchSize(); j++) {
+                in >> c.Weights(f)[j];
+            }
+        }
+    }
+
     for (size_t k = 0; k < layers__.size(); k++) {
-        for (size_t i = 0; i < layers__.at(k).size(); i++) {
-            for (size_t j = 0; j < layers__.at(k).at(i).InputSize(); j++) {
-                double w;
+        for (size_t i = 0; i < layers__.at(k).Size(); i++) {
+            for (size_t j = 0; j < layers__.at(k).InputSize(); j++) {
+                Scalar w;
                 in >> w;
-                layers__.at(k).at(i).SetWeight(j, w);
+                layers__.at(k).SetWeight(i, j, w);
             }
         }
     }
 
     return *this;
-}
\ No newline at end of file
+}
+
+template class netz::BasicNetzwerk<float>;
+template class netz::BasicNetzwerk<double>;
@@ -0,0 +1,987 @@
+#include "netz_simd.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NETZ_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using netz::math::simd::Isa;
+
+// exp(r) на |r| <= ln2 / 2 рядом Тейлора до r^12, погрешность ниже
+// единицы последнего разряда double
+constexpr double EXP_COEFFS[] = {
+    1.0 / 479001600, 1.0 / 39916800, 1.0 / 3628800, 1.0 / 362880,
+    1.0 / 40320, 1.0 / 5040, 1.0 / 720, 1.0 / 120, 1.0 / 24, 1.0 / 6,
+    1.0 / 2, 1.0, 1.0,
+};
+
+constexpr double EXP_CLAMP  = 708.0;
+constexpr double LOG2E      = 1.4426950408889634;
+constexpr double LN2_HI     = 0.693145751953125;
+constexpr double LN2_LO     = 1.42860682030941723212e-6;
+// Прибавление 1.5 * 2^52 округляет до целого, а в младших битах
+// мантиссы оказывается само целое
+constexpr double ROUND_MAGIC = 6755399441055744.0;
+
+// exp(r) для float: ряда до r^7 достаточно для 24 бит мантиссы
+constexpr float EXP_COEFFS_F[] = {
+    1.0f / 5040, 1.0f / 720, 1.0f / 120, 1.0f / 24, 1.0f / 6, 1.0f / 2,
+    1.0f, 1.0f,
+};
+
+constexpr float EXP_CLAMP_F   = 87.0f;
+constexpr float LOG2E_F       = 1.44269504f;
+constexpr float LN2_HI_F      = 0.693359375f;
+constexpr float LN2_LO_F      = -2.12194440e-4f;
+// 1.5 * 2^23, то же округление для мантиссы float
+constexpr float ROUND_MAGIC_F = 12582912.0f;
+
+template<typename T>
+struct KernelSet {
+    T (*dot)(const T *, const T *, size_t);
+    void (*dot4)(const T *, const T *, const T *, const T *, const T *,
+        size_t, T *);
+    void (*axpy)(T, const T *, T *, size_t);
+    void (*sigmoid)(const T *, T *, size_t);
+    T (*masked_sum)(const T *, const uint64_t *, size_t);
+};
+
+struct Kernels {
+    Isa isa;
+    KernelSet<double> f64;
+    KernelSet<float> f32;
+};
+
+// Скалярные ядра общие для float и double
+template<typename T>
+T DotScalar(const T *x, const T *y, size_t n) {
+    T result = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        result += x[i] * y[i];
+    }
+
+    return result;
+}
+
+template<typename T>
+void Dot4Scalar(const T *w, const T *x0, const T *x1,
+        const T *x2, const T *x3, size_t n, T *out) {
+    T sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        sum0 += x0[i] * w[i];
+        sum1 += x1[i] * w[i];
+        sum2 += x2[i] * w[i];
+        sum3 += x3[i] * w[i];
+    }
+
+    out[0] = sum0;
+    out[1] = sum1;
+    out[2] = sum2;
+    out[3] = sum3;
+}
+
+template<typename T>
+void AxpyScalar(T a, const T *x, T *y, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+template<typename T>
+void SigmoidScalar(const T *x, T *y, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        y[i] = 1 / (1 + std::exp(-x[i]));
+    }
+}
+
+// Обходит только установленные биты, начиная с бита first. В SSE2 нет
+// масок, так что это ядро используется и там.
+template<typename T>
+T MaskedSumScalar(const T *x, const uint64_t *bits, size_t n,
+        size_t first) {
+    T result = 0;
+
+    for (size_t w = first / 64; w * 64 < n; w++) {
+        uint64_t word = bits[w];
+
+        if (w == first / 64 && first % 64) {
+            word &= ~uint64_t(0) << (first % 64);
+        }
+
+        if (n - w * 64 < 64) {
+            word &= (uint64_t(1) << (n - w * 64)) - 1;
+        }
+
+        for (; word; word &= word - 1) {
+            result += x[w * 64 + __builtin_ctzll(word)];
+        }
+    }
+
+    return result;
+}
+
+template<typename T>
+T MaskedSumScalar(const T *x, const uint64_t *bits, size_t n) {
+    return MaskedSumScalar(x, bits, n, 0);
+}
+
+// Биты bits с first по first + count - 1, count <= 16 и first кратно count
+inline unsigned BitChunk(const uint64_t *bits, size_t first, size_t count) {
+    return (bits[first / 64] >> (first % 64)) & ((1u << count) - 1);
+}
+
+#ifdef NETZ_SIMD_X86
+
+// SSE2 входит в базовый набор x86-64, поэтому атрибут target не нужен
+double DotSse2(const double *x, const double *y, size_t n) {
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_pd(acc0,
+            _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+        acc1 = _mm_add_pd(acc1,
+            _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2)));
+    }
+
+    acc0 = _mm_add_pd(acc0, acc1);
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc0);
+    double result = lanes[0] + lanes[1];
+
+    for (; i < n; i++) {
+        result += x[i] * y[i];
+    }
+
+    return result;
+}
+
+void Dot4Sse2(const double *w, const double *x0, const double *x1,
+        const double *x2, const double *x3, size_t n, double *out) {
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    __m128d acc2 = _mm_setzero_pd();
+    __m128d acc3 = _mm_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        const __m128d wv = _mm_loadu_pd(w + i);
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(x0 + i), wv));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(x1 + i), wv));
+        acc2 = _mm_add_pd(acc2, _mm_mul_pd(_mm_loadu_pd(x2 + i), wv));
+        acc3 = _mm_add_pd(acc3, _mm_mul_pd(_mm_loadu_pd(x3 + i), wv));
+    }
+
+    double lanes[8];
+    _mm_storeu_pd(lanes, acc0);
+    _mm_storeu_pd(lanes + 2, acc1);
+    _mm_storeu_pd(lanes + 4, acc2);
+    _mm_storeu_pd(lanes + 6, acc3);
+
+    for (int k = 0; k < 4; k++) {
+        out[k] = lanes[2 * k] + lanes[2 * k + 1];
+    }
+
+    for (; i < n; i++) {
+        out[0] += x0[i] * w[i];
+        out[1] += x1[i] * w[i];
+        out[2] += x2[i] * w[i];
+        out[3] += x3[i] * w[i];
+    }
+}
+
+void AxpySse2(double a, const double *x, double *y, size_t n) {
+    const __m128d av = _mm_set1_pd(a);
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i),
+            _mm_mul_pd(av, _mm_loadu_pd(x + i))));
+    }
+
+    for (; i < n; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+__m128d ExpSse2(__m128d x) {
+    x = _mm_min_pd(_mm_max_pd(x, _mm_set1_pd(-EXP_CLAMP)),
+        _mm_set1_pd(EXP_CLAMP));
+
+    const __m128d magic = _mm_set1_pd(ROUND_MAGIC);
+    const __m128d kn = _mm_add_pd(_mm_mul_pd(x, _mm_set1_pd(LOG2E)), magic);
+    const __m128d n = _mm_sub_pd(kn, magic);
+
+    __m128d r = _mm_sub_pd(x, _mm_mul_pd(n, _mm_set1_pd(LN2_HI)));
+    r = _mm_sub_pd(r, _mm_mul_pd(n, _mm_set1_pd(LN2_LO)));
+
+    __m128d p = _mm_set1_pd(EXP_COEFFS[0]);
+    for (size_t c = 1; c < sizeof(EXP_COEFFS) / sizeof(double); c++) {
+        p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(EXP_COEFFS[c]));
+    }
+
+    __m128i e = _mm_sub_epi64(_mm_castpd_si128(kn), _mm_castpd_si128(magic));
+    e = _mm_slli_epi64(_mm_add_epi64(e, _mm_set1_epi64x(1023)), 52);
+
+    return _mm_mul_pd(p, _mm_castsi128_pd(e));
+}
+
+void SigmoidSse2(const double *x, double *y, size_t n) {
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d zero = _mm_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        const __m128d e = ExpSse2(_mm_sub_pd(zero, _mm_loadu_pd(x + i)));
+        _mm_storeu_pd(y + i, _mm_div_pd(one, _mm_add_pd(one, e)));
+    }
+
+    SigmoidScalar<double>(x + i, y + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+double HorizontalSumAvx2(__m256d v) {
+    const __m128d half = _mm_add_pd(_mm256_castpd256_pd128(v),
+        _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+}
+
+__attribute__((target("avx2,fma")))
+double DotAvx2(const double *x, const double *y, size_t n) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i),
+            _mm256_loadu_pd(y + i), acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 4),
+            _mm256_loadu_pd(y + i + 4), acc1);
+    }
+
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i),
+            _mm256_loadu_pd(y + i), acc0);
+    }
+
+    double result = HorizontalSumAvx2(_mm256_add_pd(acc0, acc1));
+
+    for (; i < n; i++) {
+        result += x[i] * y[i];
+    }
+
+    return result;
+}
+
+__attribute__((target("avx2,fma")))
+void Dot4Avx2(const double *w, const double *x0, const double *x1,
+        const double *x2, const double *x3, size_t n, double *out) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    __m256d acc2 = _mm256_setzero_pd();
+    __m256d acc3 = _mm256_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        const __m256d wv = _mm256_loadu_pd(w + i);
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(x0 + i), wv, acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(x1 + i), wv, acc1);
+        acc2 = _mm256_fmadd_pd(_mm256_loadu_pd(x2 + i), wv, acc2);
+        acc3 = _mm256_fmadd_pd(_mm256_loadu_pd(x3 + i), wv, acc3);
+    }
+
+    out[0] = HorizontalSumAvx2(acc0);
+    out[1] = HorizontalSumAvx2(acc1);
+    out[2] = HorizontalSumAvx2(acc2);
+    out[3] = HorizontalSumAvx2(acc3);
+
+    for (; i < n; i++) {
+        out[0] += x0[i] * w[i];
+        out[1] += x1[i] * w[i];
+        out[2] += x2[i] * w[i];
+        out[3] += x3[i] * w[i];
+    }
+}
+
+__attribute__((target("avx2,fma")))
+void AxpyAvx2(double a, const double *x, double *y, size_t n) {
+    const __m256d av = _mm256_set1_pd(a);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(y + i, _mm256_fmadd_pd(av, _mm256_loadu_pd(x + i),
+            _mm256_loadu_pd(y + i)));
+    }
+
+    for (; i < n; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+__attribute__((target("avx2,fma")))
+__m256d ExpAvx2(__m256d x) {
+    x = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(-EXP_CLAMP)),
+        _mm256_set1_pd(EXP_CLAMP));
+
+    const __m256d magic = _mm256_set1_pd(ROUND_MAGIC);
+    const __m256d kn = _mm256_fmadd_pd(x, _mm256_set1_pd(LOG2E), magic);
+    const __m256d n = _mm256_sub_pd(kn, magic);
+
+    __m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(LN2_HI), x);
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(LN2_LO), r);
+
+    __m256d p = _mm256_set1_pd(EXP_COEFFS[0]);
+    for (size_t c = 1; c < sizeof(EXP_COEFFS) / sizeof(double); c++) {
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_COEFFS[c]));
+    }
+
+    __m256i e = _mm256_sub_epi64(_mm256_castpd_si256(kn),
+        _mm256_castpd_si256(magic));
+    e = _mm256_slli_epi64(_mm256_add_epi64(e, _mm256_set1_epi64x(1023)), 52);
+
+    return _mm256_mul_pd(p, _mm256_castsi256_pd(e));
+}
+
+__attribute__((target("avx2,fma")))
+void SigmoidAvx2(const double *x, double *y, size_t n) {
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d zero = _mm256_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        const __m256d e = ExpAvx2(_mm256_sub_pd(zero,
+            _mm256_loadu_pd(x + i)));
+        _mm256_storeu_pd(y + i, _mm256_div_pd(one, _mm256_add_pd(one, e)));
+    }
+
+    SigmoidScalar<double>(x + i, y + i, n - i);
+}
+
+// Маска полосы k - бит k очередной четверки: полоса берется, если ее
+// бит установлен
+__attribute__((target("avx2,fma")))
+double MaskedSumAvx2(const double *x, const uint64_t *bits, size_t n) {
+    const __m256i lane_bits = _mm256_setr_epi64x(1, 2, 4, 8);
+    __m256d acc = _mm256_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        const __m256i chunk = _mm256_set1_epi64x(BitChunk(bits, i, 4));
+        const __m256i mask = _mm256_cmpeq_epi64(
+            _mm256_and_si256(chunk, lane_bits), lane_bits);
+
+        acc = _mm256_add_pd(acc, _mm256_and_pd(_mm256_castsi256_pd(mask),
+            _mm256_loadu_pd(x + i)));
+    }
+
+    return HorizontalSumAvx2(acc) + MaskedSumScalar(x, bits, n, i);
+}
+
+// В AVX-512 хвосты обрабатываются маской, без скалярного цикла
+__attribute__((target("avx512f")))
+double DotAvx512(const double *x, const double *y, size_t n) {
+    __m512d acc = _mm512_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        acc = _mm512_fmadd_pd(_mm512_loadu_pd(x + i),
+            _mm512_loadu_pd(y + i), acc);
+    }
+
+    if (i < n) {
+        const __mmask8 mask = (__mmask8) ((1u << (n - i)) - 1);
+        acc = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, x + i),
+            _mm512_maskz_loadu_pd(mask, y + i), acc);
+    }
+
+    return _mm512_reduce_add_pd(acc);
+}
+
+__attribute__((target("avx512f")))
+void Dot4Avx512(const double *w, const double *x0, const double *x1,
+        const double *x2, const double *x3, size_t n, double *out) {
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    __m512d acc2 = _mm512_setzero_pd();
+    __m512d acc3 = _mm512_setzero_pd();
+
+    for (size_t i = 0; i < n; i += 8) {
+        const __mmask8 mask = n - i >= 8
+            ? (__mmask8) 0xFF
+            : (__mmask8) ((1u << (n - i)) - 1);
+        const __m512d wv = _mm512_maskz_loadu_pd(mask, w + i);
+
+        acc0 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, x0 + i), wv, acc0);
+        acc1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, x1 + i), wv, acc1);
+        acc2 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, x2 + i), wv, acc2);
+        acc3 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, x3 + i), wv, acc3);
+    }
+
+    out[0] = _mm512_reduce_add_pd(acc0);
+    out[1] = _mm512_reduce_add_pd(acc1);
+    out[2] = _mm512_reduce_add_pd(acc2);
+    out[3] = _mm512_reduce_add_pd(acc3);
+}
+
+// Биты картинки сами служат маской загрузки
+__attribute__((target("avx512f")))
+double MaskedSumAvx512(const double *x, const uint64_t *bits, size_t n) {
+    __m512d acc = _mm512_setzero_pd();
+
+    for (size_t i = 0; i < n; i += 8) {
+        __mmask8 mask = (__mmask8) BitChunk(bits, i, 8);
+
+        if (n - i < 8) {
+            mask &= (__mmask8) ((1u << (n - i)) - 1);
+        }
+
+        acc = _mm512_mask_add_pd(acc, mask, acc,
+            _mm512_maskz_loadu_pd(mask, x + i));
+    }
+
+    return _mm512_reduce_add_pd(acc);
+}
+
+__attribute__((target("avx512f")))
+void AxpyAvx512(double a, const double *x, double *y, size_t n) {
+    const __m512d av = _mm512_set1_pd(a);
+
+    for (size_t i = 0; i < n; i += 8) {
+        const __mmask8 mask = n - i >= 8
+            ? (__mmask8) 0xFF
+            : (__mmask8) ((1u << (n - i)) - 1);
+
+        _mm512_mask_storeu_pd(y + i, mask, _mm512_fmadd_pd(av,
+            _mm512_maskz_loadu_pd(mask, x + i),
+            _mm512_maskz_loadu_pd(mask, y + i)));
+    }
+}
+
+__attribute__((target("avx512f")))
+__m512d ExpAvx512(__m512d x) {
+    x = _mm512_min_pd(_mm512_max_pd(x, _mm512_set1_pd(-EXP_CLAMP)),
+        _mm512_set1_pd(EXP_CLAMP));
+
+    const __m512d n = _mm512_roundscale_pd(
+        _mm512_mul_pd(x, _mm512_set1_pd(LOG2E)),
+        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+
+    __m512d r = _mm512_fnmadd_pd(n, _mm512_set1_pd(LN2_HI), x);
+    r = _mm512_fnmadd_pd(n, _mm512_set1_pd(LN2_LO), r);
+
+    __m512d p = _mm512_set1_pd(EXP_COEFFS[0]);
+    for (size_t c = 1; c < sizeof(EXP_COEFFS) / sizeof(double); c++) {
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_COEFFS[c]));
+    }
+
+    return _mm512_scalef_pd(p, n);
+}
+
+__attribute__((target("avx512f")))
+void SigmoidAvx512(const double *x, double *y, size_t n) {
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d zero = _mm512_setzero_pd();
+
+    for (size_t i = 0; i < n; i += 8) {
+        const __mmask8 mask = n - i >= 8
+            ? (__mmask8) 0xFF
+            : (__mmask8) ((1u << (n - i)) - 1);
+        const __m512d e = ExpAvx512(_mm512_sub_pd(zero,
+            _mm512_maskz_loadu_pd(mask, x + i)));
+
+        _mm512_mask_storeu_pd(y + i, mask,
+            _mm512_div_pd(one, _mm512_add_pd(one, e)));
+    }
+}
+
+// Ядра для float повторяют ядра для double, но на регистр приходится
+// вдвое больше элементов
+
+float DotSse2(const float *x, const float *y, size_t n) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0,
+            _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+        acc1 = _mm_add_ps(acc1,
+            _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(y + i + 4)));
+    }
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    float result = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+    for (; i < n; i++) {
+        result += x[i] * y[i];
+    }
+
+    return result;
+}
+
+void Dot4Sse2(const float *w, const float *x0, const float *x1,
+        const float *x2, const float *x3, size_t n, float *out) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps();
+    __m128 acc3 = _mm_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        const __m128 wv = _mm_loadu_ps(w + i);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x0 + i), wv));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x1 + i), wv));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(x2 + i), wv));
+        acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(x3 + i), wv));
+    }
+
+    float lanes[16];
+    _mm_storeu_ps(lanes, acc0);
+    _mm_storeu_ps(lanes + 4, acc1);
+    _mm_storeu_ps(lanes + 8, acc2);
+    _mm_storeu_ps(lanes + 12, acc3);
+
+    for (int k = 0; k < 4; k++) {
+        out[k] = (lanes[4 * k] + lanes[4 * k + 1])
+            + (lanes[4 * k + 2] + lanes[4 * k + 3]);
+    }
+
+    for (; i < n; i++) {
+        out[0] += x0[i] * w[i];
+        out[1] += x1[i] * w[i];
+        out[2] += x2[i] * w[i];
+        out[3] += x3[i] * w[i];
+    }
+}
+
+void AxpySse2(float a, const float *x, float *y, size_t n) {
+    const __m128 av = _mm_set1_ps(a);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i),
+            _mm_mul_ps(av, _mm_loadu_ps(x + i))));
+    }
+
+    for (; i < n; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+__m128 ExpSse2(__m128 x) {
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-EXP_CLAMP_F)),
+        _mm_set1_ps(EXP_CLAMP_F));
+
+    const __m128 magic = _mm_set1_ps(ROUND_MAGIC_F);
+    const __m128 kn = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(LOG2E_F)), magic);
+    const __m128 n = _mm_sub_ps(kn, magic);
+
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(LN2_HI_F)));
+    r = _mm_sub_ps(r, _mm_mul_ps(n, _mm_set1_ps(LN2_LO_F)));
+
+    __m128 p = _mm_set1_ps(EXP_COEFFS_F[0]);
+    for (size_t c = 1; c < sizeof(EXP_COEFFS_F) / sizeof(float); c++) {
+        p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(EXP_COEFFS_F[c]));
+    }
+
+    __m128i e = _mm_sub_epi32(_mm_castps_si128(kn), _mm_castps_si128(magic));
+    e = _mm_slli_epi32(_mm_add_epi32(e, _mm_set1_epi32(127)), 23);
+
+    return _mm_mul_ps(p, _mm_castsi128_ps(e));
+}
+
+void SigmoidSse2(const float *x, float *y, size_t n) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        const __m128 e = ExpSse2(_mm_sub_ps(zero, _mm_loadu_ps(x + i)));
+        _mm_storeu_ps(y + i, _mm_div_ps(one, _mm_add_ps(one, e)));
+    }
+
+    SigmoidScalar<float>(x + i, y + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+float HorizontalSumAvx2(__m256 v) {
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(v),
+        _mm256_extractf128_ps(v, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    return _mm_cvtss_f32(_mm_add_ss(half, _mm_shuffle_ps(half, half, 1)));
+}
+
+__attribute__((target("avx2,fma")))
+float DotAvx2(const float *x, const float *y, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i),
+            _mm256_loadu_ps(y + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8),
+            _mm256_loadu_ps(y + i + 8), acc1);
+    }
+
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i),
+            _mm256_loadu_ps(y + i), acc0);
+    }
+
+    float result = HorizontalSumAvx2(_mm256_add_ps(acc0, acc1));
+
+    for (; i < n; i++) {
+        result += x[i] * y[i];
+    }
+
+    return result;
+}
+
+__attribute__((target("avx2,fma")))
+void Dot4Avx2(const float *w, const float *x0, const float *x1,
+        const float *x2, const float *x3, size_t n, float *out) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps();
+    __m256 acc3 = _mm256_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        const __m256 wv = _mm256_loadu_ps(w + i);
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x0 + i), wv, acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(x1 + i), wv, acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(x2 + i), wv, acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(x3 + i), wv, acc3);
+    }
+
+    out[0] = HorizontalSumAvx2(acc0);
+    out[1] = HorizontalSumAvx2(acc1);
+    out[2] = HorizontalSumAvx2(acc2);
+    out[3] = HorizontalSumAvx2(acc3);
+
+    for (; i < n; i++) {
+        out[0] += x0[i] * w[i];
+        out[1] += x1[i] * w[i];
+        out[2] += x2[i] * w[i];
+        out[3] += x3[i] * w[i];
+    }
+}
+
+__attribute__((target("avx2,fma")))
+float MaskedSumAvx2(const float *x, const uint64_t *bits, size_t n) {
+    const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64,
+        128);
+    __m256 acc = _mm256_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        const __m256i chunk = _mm256_set1_epi32(BitChunk(bits, i, 8));
+        const __m256i mask = _mm256_cmpeq_epi32(
+            _mm256_and_si256(chunk, lane_bits), lane_bits);
+
+        acc = _mm256_add_ps(acc, _mm256_and_ps(_mm256_castsi256_ps(mask),
+            _mm256_loadu_ps(x + i)));
+    }
+
+    return HorizontalSumAvx2(acc) + MaskedSumScalar(x, bits, n, i);
+}
+
+__attribute__((target("avx2,fma")))
+void AxpyAvx2(float a, const float *x, float *y, size_t n) {
+    const __m256 av = _mm256_set1_ps(a);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(av, _mm256_loadu_ps(x + i),
+            _mm256_loadu_ps(y + i)));
+    }
+
+    for (; i < n; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+__attribute__((target("avx2,fma")))
+__m256 ExpAvx2(__m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-EXP_CLAMP_F)),
+        _mm256_set1_ps(EXP_CLAMP_F));
+
+    const __m256 magic = _mm256_set1_ps(ROUND_MAGIC_F);
+    const __m256 kn = _mm256_fmadd_ps(x, _mm256_set1_ps(LOG2E_F), magic);
+    const __m256 n = _mm256_sub_ps(kn, magic);
+
+    __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_HI_F), x);
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_LO_F), r);
+
+    __m256 p = _mm256_set1_ps(EXP_COEFFS_F[0]);
+    for (size_t c = 1; c < sizeof(EXP_COEFFS_F) / sizeof(float); c++) {
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_COEFFS_F[c]));
+    }
+
+    __m256i e = _mm256_sub_epi32(_mm256_castps_si256(kn),
+        _mm256_castps_si256(magic));
+    e = _mm256_slli_epi32(_mm256_add_epi32(e, _mm256_set1_epi32(127)), 23);
+
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+}
+
+__attribute__((target("avx2,fma")))
+void SigmoidAvx2(const float *x, float *y, size_t n) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        const __m256 e = ExpAvx2(_mm256_sub_ps(zero,
+            _mm256_loadu_ps(x + i)));
+        _mm256_storeu_ps(y + i, _mm256_div_ps(one, _mm256_add_ps(one, e)));
+    }
+
+    SigmoidScalar<float>(x + i, y + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+__mmask16 TailMask16(size_t left) {
+    return left >= 16 ? (__mmask16) 0xFFFF : (__mmask16) ((1u << left) - 1);
+}
+
+__attribute__((target("avx512f")))
+float DotAvx512(const float *x, const float *y, size_t n) {
+    __m512 acc = _mm512_setzero_ps();
+
+    for (size_t i = 0; i < n; i += 16) {
+        const __mmask16 mask = TailMask16(n - i);
+        acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, x + i),
+            _mm512_maskz_loadu_ps(mask, y + i), acc);
+    }
+
+    return _mm512_reduce_add_ps(acc);
+}
+
+__attribute__((target("avx512f")))
+void Dot4Avx512(const float *w, const float *x0, const float *x1,
+        const float *x2, const float *x3, size_t n, float *out) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    __m512 acc2 = _mm512_setzero_ps();
+    __m512 acc3 = _mm512_setzero_ps();
+
+    for (size_t i = 0; i < n; i += 16) {
+        const __mmask16 mask = TailMask16(n - i);
+        const __m512 wv = _mm512_maskz_loadu_ps(mask, w + i);
+
+        acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, x0 + i), wv, acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, x1 + i), wv, acc1);
+        acc2 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, x2 + i), wv, acc2);
+        acc3 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, x3 + i), wv, acc3);
+    }
+
+    out[0] = _mm512_reduce_add_ps(acc0);
+    out[1] = _mm512_reduce_add_ps(acc1);
+    out[2] = _mm512_reduce_add_ps(acc2);
+    out[3] = _mm512_reduce_add_ps(acc3);
+}
+
+__attribute__((target("avx512f")))
+float MaskedSumAvx512(const float *x, const uint64_t *bits, size_t n) {
+    __m512 acc = _mm512_setzero_ps();
+
+    for (size_t i = 0; i < n; i += 16) {
+        const __mmask16 mask = (__mmask16) BitChunk(bits, i, 16)
+            & TailMask16(n - i);
+
+        acc = _mm512_mask_add_ps(acc, mask, acc,
+            _mm512_maskz_loadu_ps(mask, x + i));
+    }
+
+    return _mm512_reduce_add_ps(acc);
+}
+
+__attribute__((target("avx512f")))
+void AxpyAvx512(float a, const float *x, float *y, size_t n) {
+    const __m512 av = _mm512_set1_ps(a);
+
+    for (size_t i = 0; i < n; i += 16) {
+        const __mmask16 mask = TailMask16(n - i);
+
+        _mm512_mask_storeu_ps(y + i, mask, _mm512_fmadd_ps(av,
+            _mm512_maskz_loadu_ps(mask, x + i),
+            _mm512_maskz_loadu_ps(mask, y + i)));
+    }
+}
+
+__attribute__((target("avx512f")))
+__m512 ExpAvx512(__m512 x) {
+    x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(-EXP_CLAMP_F)),
+        _mm512_set1_ps(EXP_CLAMP_F));
+
+    const __m512 n = _mm512_roundscale_ps(
+        _mm512_mul_ps(x, _mm512_set1_ps(LOG2E_F)),
+        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+
+    __m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(LN2_HI_F), x);
+    r = _mm512_fnmadd_ps(n, _mm512_set1_ps(LN2_LO_F), r);
+
+    __m512 p = _mm512_set1_ps(EXP_COEFFS_F[0]);
+    for (size_t c = 1; c < sizeof(EXP_COEFFS_F) / sizeof(float); c++) {
+        p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_COEFFS_F[c]));
+    }
+
+    return _mm512_scalef_ps(p, n);
+}
+
+__attribute__((target("avx512f")))
+void SigmoidAvx512(const float *x, float *y, size_t n) {
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 zero = _mm512_setzero_ps();
+
+    for (size_t i = 0; i < n; i += 16) {
+        const __mmask16 mask = TailMask16(n - i);
+        const __m512 e = ExpAvx512(_mm512_sub_ps(zero,
+            _mm512_maskz_loadu_ps(mask, x + i)));
+
+        _mm512_mask_storeu_ps(y + i, mask,
+            _mm512_div_ps(one, _mm512_add_ps(one, e)));
+    }
+}
+
+#endif // NETZ_SIMD_X86
+
+Isa DetectIsa() {
+    Isa isa = Isa::SCALAR;
+
+#ifdef NETZ_SIMD_X86
+    __builtin_cpu_init();
+
+    isa = Isa::SSE2;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        isa = Isa::AVX2;
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        isa = Isa::AVX512;
+    }
+#endif
+
+    const char *limit = std::getenv("NETZ_SIMD");
+    if (limit) {
+        for (Isa candidate : { Isa::SCALAR, Isa::SSE2, Isa::AVX2 }) {
+            if (std::strcmp(limit, netz::math::simd::IsaName(candidate)) == 0
+                    && candidate < isa) {
+                isa = candidate;
+            }
+        }
+    }
+
+    return isa;
+}
+
+Kernels SelectKernels() {
+    switch (DetectIsa()) {
+#ifdef NETZ_SIMD_X86
+        case Isa::AVX512:
+            return { Isa::AVX512,
+                { DotAvx512, Dot4Avx512, AxpyAvx512, SigmoidAvx512,
+                    MaskedSumAvx512 },
+                { DotAvx512, Dot4Avx512, AxpyAvx512, SigmoidAvx512,
+                    MaskedSumAvx512 } };
+        case Isa::AVX2:
+            return { Isa::AVX2,
+                { DotAvx2, Dot4Avx2, AxpyAvx2, SigmoidAvx2, MaskedSumAvx2 },
+                { DotAvx2, Dot4Avx2, AxpyAvx2, SigmoidAvx2, MaskedSumAvx2 } };
+        case Isa::SSE2:
+            return { Isa::SSE2,
+                { DotSse2, Dot4Sse2, AxpySse2, SigmoidSse2, MaskedSumScalar },
+                { DotSse2, Dot4Sse2, AxpySse2, SigmoidSse2,
+                    MaskedSumScalar } };
+#endif
+        default:
+            return { Isa::SCALAR,
+                { DotScalar, Dot4Scalar, AxpyScalar, SigmoidScalar,
+                    MaskedSumScalar },
+                { DotScalar, Dot4Scalar, AxpyScalar, SigmoidScalar,
+                    MaskedSumScalar } };
+    }
+}
+
+const Kernels& ActiveKernels() {
+    static const Kernels kernels = SelectKernels();
+    return kernels;
+}
+
+} // namespace
+
+netz::math::simd::Isa netz::math::simd::ActiveIsa() {
+    return ActiveKernels().isa;
+}
+
+const char *netz::math::simd::IsaName(Isa isa) {
+    switch (isa) {
+        case Isa::SSE2:
+            return "sse2";
+        case Isa::AVX2:
+            return "avx2";
+        case Isa::AVX512:
+            return "avx512";
+        case Isa::SCALAR:
+        default:
+            return "scalar";
+    }
+}
+
+double netz::math::simd::Dot(const double *x, const double *y, size_t n) {
+    return ActiveKernels().f64.dot(x, y, n);
+}
+
+float netz::math::simd::Dot(const float *x, const float *y, size_t n) {
+    return ActiveKernels().f32.dot(x, y, n);
+}
+
+void netz::math::simd::Dot4(const double *w, const double *x0,
+        const double *x1, const double *x2, const double *x3, size_t n,
+        double *out) {
+    ActiveKernels().f64.dot4(w, x0, x1, x2, x3, n, out);
+}
+
+void netz::math::simd::Dot4(const float *w, const float *x0,
+        const float *x1, const float *x2, const float *x3, size_t n,
+        float *out) {
+    ActiveKernels().f32.dot4(w, x0, x1, x2, x3, n, out);
+}
+
+void netz::math::simd::Axpy(double a, const double *x, double *y, size_t n) {
+    ActiveKernels().f64.axpy(a, x, y, n);
+}
+
+void netz::math::simd::Axpy(float a, const float *x, float *y, size_t n) {
+    ActiveKernels().f32.axpy(a, x, y, n);
+}
+
+double netz::math::simd::MaskedSum(const double *x, const uint64_t *bits,
+        size_t n) {
+    return ActiveKernels().f64.masked_sum(x, bits, n);
+}
+
+float netz::math::simd::MaskedSum(const float *x, const uint64_t *bits,
+        size_t n) {
+    return ActiveKernels().f32.masked_sum(x, bits, n);
+}
+
+void netz::math::simd::Sigmoid(const double *x, double *y, size_t n) {
+    ActiveKernels().f64.sigmoid(x, y, n);
+}
+
+void netz::math::simd::Sigmoid(const float *x, float *y, size_t n) {
+    ActiveKernels().f32.sigmoid(x, y, n);
+}
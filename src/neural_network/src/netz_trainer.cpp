@@ -0,0 +1,494 @@
+#include "netz_trainer.hpp"
+#include "netz_formulas.hpp"
+#include "netz_simd.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+constexpr double ACCEPTABLE_ERROR = 10e-6;
+
+// Образцы оцениваются пакетами, чтобы не держать выходы всей выборки
+constexpr size_t EVALUATE_BATCH = 256;
+constexpr size_t EVALUATE_CHUNK = 4096;
+
+// Один шаг онлайн-обучения на образце row, как в исходном цикле
+// main.cpp: веса не трогаются, если ошибка уже пренебрежимо мала.
+// Ошибка - среднеквадратичная: знаковая сумма ошибок выходов может
+// обнулиться, когда сами ошибки велики.
+template<typename Scalar>
+void TrainSample(netz::BasicNetzwerk<Scalar>& netz,
+        const netz::BasicDataset<Scalar>& data, size_t row, double alpha,
+        bool accumulate) {
+    const netz::BasicMatrix<Scalar>& expected = data.expected;
+    const std::vector<Scalar> expected_values(expected.Row(row),
+        expected.Row(row) + expected.cols);
+
+    netz.SetInputs(data.inputs.Row(row));
+
+    const double error = netz::math::MeanSquaredError(expected_values,
+        netz.GetOuputs());
+
+    if (error <= ACCEPTABLE_ERROR * ACCEPTABLE_ERROR) return;
+
+    if (accumulate) {
+        netz.AccumulateGradients(expected_values);
+    } else {
+        netz.AdjustWeights(alpha, expected_values);
+    }
+}
+
+} // namespace
+
+template<typename Scalar>
+netz::BasicDataset<Scalar>::BasicDataset(size_t input_count,
+        size_t output_count)
+        : inputs(0, input_count), expected(0, output_count) {}
+
+template<typename Scalar>
+netz::BasicDataset<Scalar>& netz::BasicDataset<Scalar>::AddSample(
+        const Scalar *sample_inputs, const Scalar *sample_expected) {
+    inputs.data.insert(inputs.data.end(), sample_inputs,
+        sample_inputs + inputs.cols);
+    expected.data.insert(expected.data.end(), sample_expected,
+        sample_expected + expected.cols);
+    inputs.rows++;
+    expected.rows++;
+
+    return *this;
+}
+
+template<typename Scalar>
+size_t netz::BasicDataset<Scalar>::Size() const {
+    return inputs.rows;
+}
+
+template<typename Scalar>
+void netz::BasicDataset<Scalar>::Split(double validation_share, unsigned seed,
+        BasicDataset& train, BasicDataset& validation) const {
+    std::vector<size_t> order(Size());
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(seed));
+
+    const size_t validation_size = static_cast<size_t>(
+        std::clamp(validation_share, 0.0, 1.0) * Size());
+
+    train = BasicDataset(inputs.cols, expected.cols);
+    validation = BasicDataset(inputs.cols, expected.cols);
+
+    for (size_t i = 0; i < order.size(); i++) {
+        BasicDataset& part = i < validation_size ? validation : train;
+        part.AddSample(inputs.Row(order[i]), expected.Row(order[i]));
+    }
+}
+
+template<typename Scalar>
+netz::BasicDataset<Scalar>& netz::BasicDataset<Scalar>::Assign(
+        const dataset::MappedFile& file, size_t begin, size_t count) {
+    if (begin > file.Size() || count > file.Size() - begin) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_INDEX_OOB));
+    }
+
+    inputs.rows = expected.rows = count;
+    inputs.cols = file.InputCount();
+    expected.cols = file.ClassCount();
+    inputs.data.resize(count * inputs.cols);
+    expected.data.assign(count * expected.cols, Scalar(0));
+
+    for (size_t i = 0; i < count; i++) {
+        const size_t label = file.Label(begin + i);
+
+        if (label >= expected.cols) {
+            throw std::runtime_error(ErrMsg(ERR_MSG_DATASET_LABEL));
+        }
+
+        file.Unpack(begin + i, inputs.Row(i));
+        expected.Row(i)[label] = Scalar(1);
+    }
+
+    return *this;
+}
+
+template<typename Scalar>
+netz::Metrics netz::Evaluate(const BasicNetzwerk<Scalar>& netz,
+        const BasicDataset<Scalar>& data) {
+    Metrics metrics;
+
+    if (data.Size() == 0) return metrics;
+
+    const size_t cols = data.expected.cols;
+    BasicMatrix<Scalar> batch;
+    size_t correct = 0;
+
+    for (size_t begin = 0; begin < data.Size(); begin += EVALUATE_BATCH) {
+        const size_t end = std::min(begin + EVALUATE_BATCH, data.Size());
+
+        batch.rows = end - begin;
+        batch.cols = data.inputs.cols;
+        batch.data.assign(data.inputs.Row(begin), data.inputs.Row(begin)
+            + batch.rows * batch.cols);
+
+        const BasicMatrix<Scalar> outputs = netz.GetOutputsBatch(batch);
+
+        for (size_t m = 0; m < outputs.rows; m++) {
+            const Scalar *e = data.expected.Row(begin + m);
+            const std::vector<Scalar> expected(e, e + cols);
+            const std::vector<Scalar> output(outputs.Row(m),
+                outputs.Row(m) + cols);
+
+            metrics.mse += math::MeanSquaredError(expected, output);
+            metrics.cross_entropy += math::CrossEntropy(expected, output);
+
+            if (std::max_element(expected.begin(), expected.end())
+                    - expected.begin()
+                    == std::max_element(output.begin(), output.end())
+                    - output.begin()) {
+                correct++;
+            }
+        }
+    }
+
+    metrics.mse /= data.Size();
+    metrics.cross_entropy /= data.Size();
+    metrics.accuracy = double(correct) / data.Size();
+
+    return metrics;
+}
+
+template<typename Scalar>
+netz::Metrics netz::Evaluate(const BasicNetzwerk<Scalar>& netz,
+        const dataset::MappedFile& file, size_t begin, size_t end) {
+    if (begin > end || end > file.Size()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_INDEX_OOB));
+    }
+
+    Metrics metrics;
+    BasicDataset<Scalar> chunk;
+
+    if (begin == end) return metrics;
+
+    for (size_t first = begin; first < end; first += EVALUATE_CHUNK) {
+        const size_t count = std::min(EVALUATE_CHUNK, end - first);
+        const Metrics part = Evaluate(netz, chunk.Assign(file, first,
+            count));
+
+        metrics.mse += part.mse * count;
+        metrics.cross_entropy += part.cross_entropy * count;
+        metrics.accuracy += part.accuracy * count;
+    }
+
+    metrics.mse /= end - begin;
+    metrics.cross_entropy /= end - begin;
+    metrics.accuracy /= end - begin;
+
+    return metrics;
+}
+
+netz::EarlyStopping::EarlyStopping(size_t patience, double min_delta)
+        : patience__(patience), min_delta__(min_delta),
+          best_loss__(std::numeric_limits<double>::infinity()) {}
+
+// Лучшими считаются любые меньшие потери, а терпение сбрасывается только
+// на улучшении больше min_delta: медленный спуск по плато останавливает
+// обучение, но восстанавливаются все же самые лучшие веса.
+bool netz::EarlyStopping::Update(double loss) {
+    epochs__++;
+
+    if (loss < best_loss__ - min_delta__) {
+        improved_epoch__ = epochs__;
+    }
+
+    if (loss < best_loss__) {
+        best_loss__ = loss;
+        best_epoch__ = epochs__;
+        return true;
+    }
+
+    return false;
+}
+
+bool netz::EarlyStopping::ShouldStop() const {
+    return patience__ != 0 && epochs__ - improved_epoch__ >= patience__;
+}
+
+double netz::EarlyStopping::BestLoss() const {
+    return best_loss__;
+}
+
+size_t netz::EarlyStopping::BestEpoch() const {
+    return best_epoch__;
+}
+
+size_t netz::EarlyStopping::Epochs() const {
+    return epochs__;
+}
+
+netz::WorkerPool::WorkerPool(size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        threads__.emplace_back(&WorkerPool::WorkerLoop, this, i);
+    }
+}
+
+netz::WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex__);
+        stop__ = true;
+    }
+
+    start__.notify_all();
+
+    for (std::thread& t : threads__) {
+        t.join();
+    }
+}
+
+void netz::WorkerPool::Run(const std::function<void(size_t)>& task) {
+    std::unique_lock<std::mutex> lock(mutex__);
+
+    task__ = &task;
+    pending__ = threads__.size();
+    generation__++;
+    start__.notify_all();
+
+    done__.wait(lock, [this] { return pending__ == 0; });
+    task__ = nullptr;
+}
+
+size_t netz::WorkerPool::Size() const {
+    return threads__.size();
+}
+
+void netz::WorkerPool::WorkerLoop(size_t worker) {
+    size_t generation = 0;
+
+    while (true) {
+        const std::function<void(size_t)> *task;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex__);
+            start__.wait(lock, [&] {
+                return stop__ || generation__ != generation;
+            });
+
+            if (stop__) return;
+
+            generation = generation__;
+            task = task__;
+        }
+
+        (*task)(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex__);
+            if (--pending__ == 0) {
+                done__.notify_one();
+            }
+        }
+    }
+}
+
+template<typename Scalar>
+netz::BasicParallelTrainer<Scalar>::BasicParallelTrainer(Netzwerk& netz,
+        size_t threads, Mode mode)
+        : netz__(netz), mode__(mode) {
+    if (threads == 0) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_THREAD_COUNT));
+    }
+
+    if (threads > 1) {
+        replicas__.assign(threads, netz);
+        pool__ = std::make_unique<WorkerPool>(threads);
+    }
+}
+
+template<typename Scalar>
+netz::BasicParallelTrainer<Scalar>&
+netz::BasicParallelTrainer<Scalar>::SetBatchSize(size_t batch_size) {
+    if (batch_size == 0) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_BATCH_SIZE));
+    }
+
+    batch_size__ = batch_size;
+
+    return *this;
+}
+
+template<typename Scalar>
+size_t netz::BasicParallelTrainer<Scalar>::GetBatchSize() const {
+    return batch_size__;
+}
+
+template<typename Scalar>
+netz::BasicParallelTrainer<Scalar>&
+netz::BasicParallelTrainer<Scalar>::SetSyncInterval(size_t interval) {
+    if (interval == 0) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_SYNC_INTERVAL));
+    }
+
+    sync_interval__ = interval;
+
+    return *this;
+}
+
+template<typename Scalar>
+size_t netz::BasicParallelTrainer<Scalar>::GetSyncInterval() const {
+    return sync_interval__;
+}
+
+// Выборка обычно упорядочена по классам, а потоки и пакеты берут
+// соседние образцы, поэтому в параллельных режимах порядок образцов
+// перемешивается на каждой эпохе.
+template<typename Scalar>
+void netz::BasicParallelTrainer<Scalar>::Shuffle(size_t size) {
+    order__.resize(size);
+    std::iota(order__.begin(), order__.end(), 0);
+    std::shuffle(order__.begin(), order__.end(), shuffle_gen__);
+}
+
+template<typename Scalar>
+void netz::BasicParallelTrainer<Scalar>::TrainEpoch(const Dataset& data,
+        double alpha) {
+    if (!pool__) {
+        TrainSequential(data, alpha);
+    } else if (mode__ == Mode::SYNCHRONOUS) {
+        TrainSynchronous(data, alpha);
+    } else {
+        TrainAsynchronous(data, alpha);
+    }
+}
+
+template<typename Scalar>
+void netz::BasicParallelTrainer<Scalar>::TrainEpoch(
+        const dataset::MappedFile& file, size_t begin, size_t end,
+        double alpha) {
+    if (begin > end || end > file.Size()) {
+        throw std::invalid_argument(ErrMsg(ERR_MSG_INDEX_OOB));
+    }
+
+    chunks__.clear();
+    for (size_t chunk = begin; chunk < end; chunk += PACKED_CHUNK) {
+        chunks__.push_back(chunk);
+    }
+
+    std::shuffle(chunks__.begin(), chunks__.end(), shuffle_gen__);
+
+    for (size_t chunk : chunks__) {
+        chunk__.Assign(file, chunk, std::min(PACKED_CHUNK, end - chunk));
+        TrainEpoch(chunk__, alpha);
+    }
+}
+
+template<typename Scalar>
+void netz::BasicParallelTrainer<Scalar>::TrainSequential(const Dataset& data,
+        double alpha) {
+    for (size_t row = 0; row < data.Size(); row++) {
+        TrainSample(netz__, data, row, alpha, false);
+    }
+
+    netz__.ApplyGradients(alpha);
+}
+
+template<typename Scalar>
+void netz::BasicParallelTrainer<Scalar>::TrainSynchronous(
+        const Dataset& data, double alpha) {
+    const size_t workers = replicas__.size();
+
+    Shuffle(data.Size());
+
+    for (size_t begin = 0; begin < data.Size(); begin += batch_size__) {
+        const size_t end = std::min(begin + batch_size__, data.Size());
+
+        pool__->Run([&](size_t worker) {
+            Netzwerk& replica = replicas__[worker];
+            const size_t shard = end - begin;
+
+            replica.CopyWeights(netz__);
+
+            for (size_t row = begin + shard * worker / workers;
+                    row < begin + shard * (worker + 1) / workers; row++) {
+                TrainSample(replica, data, order__[row], alpha, true);
+            }
+        });
+
+        // Градиенты копий суммируются всегда в одном порядке, так что
+        // результат не зависит от того, какой поток закончил первым.
+        pool__->Run([&](size_t worker) {
+            ForEachRowSlice(worker, [&](size_t size, auto weights_of,
+                    auto gradients_of) {
+                Scalar *weights = weights_of(netz__);
+
+                for (Netzwerk& replica : replicas__) {
+                    Scalar *gradients = gradients_of(replica);
+
+                    math::simd::Axpy(static_cast<Scalar>(alpha), gradients,
+                        weights, size);
+                    std::fill(gradients, gradients + size, Scalar(0));
+                }
+            });
+        });
+    }
+
+    netz__.Invalidate();
+}
+
+template<typename Scalar>
+void netz::BasicParallelTrainer<Scalar>::TrainAsynchronous(
+        const Dataset& data, double alpha) {
+    const size_t workers = replicas__.size();
+    const size_t round = sync_interval__ * workers;
+    const Scalar scale = Scalar(1) / workers;
+
+    for (Netzwerk& replica : replicas__) {
+        replica.SetBatchSize(1);
+    }
+
+    Shuffle(data.Size());
+
+    for (size_t begin = 0; begin < data.Size(); begin += round) {
+        const size_t end = std::min(begin + round, data.Size());
+
+        pool__->Run([&](size_t worker) {
+            Netzwerk& replica = replicas__[worker];
+            const size_t shard = end - begin;
+
+            replica.CopyWeights(netz__);
+
+            for (size_t row = begin + shard * worker / workers;
+                    row < begin + shard * (worker + 1) / workers; row++) {
+                TrainSample(replica, data, order__[row], alpha, false);
+            }
+        });
+
+        pool__->Run([&](size_t worker) {
+            ForEachRowSlice(worker, [&](size_t size, auto weights_of,
+                    auto) {
+                Scalar *weights = weights_of(netz__);
+
+                std::fill(weights, weights + size, Scalar(0));
+
+                for (Netzwerk& replica : replicas__) {
+                    math::simd::Axpy(scale, weights_of(replica), weights,
+                        size);
+                }
+            });
+        });
+    }
+
+    netz__.Invalidate();
+}
+
+template struct netz::BasicDataset<float>;
+template struct netz::BasicDataset<double>;
+template class netz::BasicParallelTrainer<float>;
+template class netz::BasicParallelTrainer<double>;
+template netz::Metrics netz::Evaluate(const BasicNetzwerk<float>&,
+    const BasicDataset<float>&);
+template netz::Metrics netz::Evaluate(const BasicNetzwerk<double>&,
+    const BasicDataset<double>&);
+template netz::Metrics netz::Evaluate(const BasicNetzwerk<float>&,
+    const dataset::MappedFile&, size_t, size_t);
+template netz::Metrics netz::Evaluate(const BasicNetzwerk<double>&,
+    const dataset::MappedFile&, size_t, size_t);
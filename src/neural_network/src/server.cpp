@@ -0,0 +1,263 @@
+#include "server.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include "netz_binary.hpp"
+#include "netz_compiled.hpp"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t READ_SIZE = 64 * 1024;
+constexpr char ERROR_RESPONSE[] = "error invalid record\n";
+
+std::runtime_error SystemError(const char *what) {
+    return std::runtime_error(std::string(what) + ": "
+        + std::strerror(errno));
+}
+
+// false, если получатель закрыл соединение
+bool WriteAll(int fd, const std::string& data) {
+    size_t written = 0;
+
+    while (written < data.size()) {
+        const ssize_t n = write(fd, data.data() + written,
+            data.size() - written);
+
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+
+        written += n;
+    }
+
+    return true;
+}
+
+// Одно соединение: строки читаются из in_fd, ответы пишутся в out_fd.
+// Образцы текущего пакета лежат в batch__, а records__ хранит для каждой
+// строки, был ли это образец, чтобы ответы шли в порядке строк.
+template<typename Scalar, typename Model>
+class Session {
+public:
+    using Matrix    = netz::BasicMatrix<Scalar>;
+    using Context   = netz::BasicInferenceContext<Scalar>;
+
+    Session(const Model& model, int in_fd, int out_fd,
+            const server::Options& options)
+            : model__(model), in_fd__(in_fd), out_fd__(out_fd),
+              options__(options), batch__(0, model.InputCount()) {}
+
+    void Run() {
+        std::vector<char> buffer;
+        size_t begin = 0;
+
+        while (true) {
+            // Разбираются все полные строки, что уже пришли
+            const char *first = buffer.data() + begin;
+            const char *last = buffer.data() + buffer.size();
+            const char *eol;
+
+            while ((eol = std::find(first, last, '\n')) != last) {
+                if (!AddLine(first, eol)) return;
+                first = eol + 1;
+            }
+
+            begin = first - buffer.data();
+
+            // Перед тем как ждать данных, отвечаем на все, что разобрано
+            if (!Flush()) return;
+
+            buffer.erase(buffer.begin(), buffer.begin() + begin);
+            begin = 0;
+
+            const size_t filled = buffer.size();
+            buffer.resize(filled + READ_SIZE);
+
+            ssize_t n;
+            do {
+                n = read(in_fd__, buffer.data() + filled, READ_SIZE);
+            } while (n < 0 && errno == EINTR);
+
+            buffer.resize(filled + std::max<ssize_t>(n, 0));
+
+            if (n <= 0) {
+                // Последняя строка может быть без перевода строки
+                if (!buffer.empty()) {
+                    AddLine(buffer.data(), buffer.data() + buffer.size());
+                }
+
+                Flush();
+                return;
+            }
+        }
+    }
+private:
+    bool AddLine(const char *first, const char *last) {
+        while (last != first && std::isspace(
+                static_cast<unsigned char>(last[-1]))) {
+            last--;
+        }
+
+        if (first == last) return true;
+
+        const size_t count = model__.InputCount();
+        bool valid = size_t(last - first) == count;
+
+        for (const char *c = first; valid && c != last; c++) {
+            valid = *c == '0' || *c == '1';
+        }
+
+        records__.push_back(valid);
+
+        if (valid) {
+            batch__.data.resize(batch__.data.size() + count);
+            Scalar *row = batch__.Row(batch__.rows++);
+
+            for (size_t i = 0; i < count; i++) {
+                row[i] = first[i] == '1' ? Scalar(1) : Scalar(0);
+            }
+        }
+
+        return batch__.rows < options__.batch_size || Flush();
+    }
+
+    bool Flush() {
+        if (records__.empty()) return true;
+
+        const Matrix *outputs = nullptr;
+
+        if (batch__.rows) {
+            outputs = &model__.GetOutputsBatch(batch__, context__);
+        }
+
+        response__.clear();
+
+        size_t m = 0;
+        for (bool valid : records__) {
+            if (!valid) {
+                response__ += ERROR_RESPONSE;
+                continue;
+            }
+
+            const Scalar *row = outputs->Row(m++);
+            const size_t best = std::max_element(row, row + outputs->cols)
+                - row;
+
+            response__ += best < options__.labels.size()
+                ? options__.labels[best] : std::to_string(best);
+
+            for (size_t i = 0; i < outputs->cols; i++) {
+                char number[32];
+                std::snprintf(number, sizeof(number), " %g",
+                    static_cast<double>(row[i]));
+                response__ += number;
+            }
+
+            response__ += '\n';
+        }
+
+        records__.clear();
+        batch__.rows = 0;
+        batch__.data.clear();
+
+        return WriteAll(out_fd__, response__);
+    }
+
+    const Model&            model__;
+    int                     in_fd__;
+    int                     out_fd__;
+    const server::Options&  options__;
+    Context                 context__;
+    Matrix                  batch__;
+    std::vector<bool>       records__;
+    std::string             response__;
+};
+
+} // namespace
+
+template<typename Scalar, typename Model>
+void server::ServeStream(const Model& model, int in_fd, int out_fd,
+        const Options& options) {
+    // Закрытый получатель - обычный конец сеанса, а не повод падать
+    std::signal(SIGPIPE, SIG_IGN);
+
+    Session<Scalar, Model>(model, in_fd, out_fd, options).Run();
+}
+
+template<typename Scalar, typename Model>
+void server::ServeSocket(const Model& model, const std::string& path,
+        const Options& options) {
+    std::signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un address = sockaddr_un();
+    address.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path is too long: " + path);
+    }
+
+    std::strcpy(address.sun_path, path.c_str());
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (listener < 0) {
+        throw SystemError("socket");
+    }
+
+    // Сокет, оставшийся от прошлого запуска, мешает bind. Удаляется
+    // только сокет, чтобы опечатка в пути не стоила чужого файла.
+    struct stat info;
+    if (lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(path.c_str());
+    }
+
+    if (bind(listener, reinterpret_cast<const sockaddr *>(&address),
+            sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0) {
+        const std::runtime_error error = SystemError(path.c_str());
+        close(listener);
+        throw error;
+    }
+
+    while (true) {
+        const int client = accept(listener, nullptr, nullptr);
+
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+
+            const std::runtime_error error = SystemError("accept");
+            close(listener);
+            throw error;
+        }
+
+        std::thread([&model, options, client] {
+            Session<Scalar, Model>(model, client, client, options).Run();
+            close(client);
+        }).detach();
+    }
+}
+
+template void server::ServeStream<float>(const netz::CompiledModelF&, int,
+    int, const Options&);
+template void server::ServeStream<double>(const netz::CompiledModel&, int,
+    int, const Options&);
+template void server::ServeStream<float>(const netz::MappedModelF&, int,
+    int, const Options&);
+template void server::ServeStream<double>(const netz::MappedModel&, int,
+    int, const Options&);
+template void server::ServeSocket<float>(const netz::CompiledModelF&,
+    const std::string&, const Options&);
+template void server::ServeSocket<double>(const netz::CompiledModel&,
+    const std::string&, const Options&);
+template void server::ServeSocket<float>(const netz::MappedModelF&,
+    const std::string&, const Options&);
+template void server::ServeSocket<double>(const netz::MappedModel&,
+    const std::string&, const Options&);
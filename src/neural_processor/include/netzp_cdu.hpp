@@ -7,38 +7,76 @@
 #include "netzp_mem.hpp"
 #include "netzp_utils.hpp"
 #include "sysc/kernel/sc_module_name.h"
+#include <deque>
+#include <utility>
+#include <vector>
 
 namespace netzp {
 
 class CentralDispatchUnit : public sc_core::sc_module {
 public:
-    static constexpr config_int_t CORE_COUNT  = CONFIG_COMP_CORE_COUNT;
     static constexpr config_int_t MAX_NEURONS = CONFIG_CDU_MAX_NEURONS_COUNT;
     static constexpr config_int_t MAX_OUTPUTS = CONFIG_NETZ_MAX_OUTPUTS;
     static constexpr config_int_t MASTER_ID   = 2;
 
-    using size_type = uchar;
+    using size_type = NeuronData::count_type;
 
 private:
-    ComputCore *compcore[CORE_COUNT];
+    const config_int_t core_count_;
 
-    sc_core::sc_signal<ComputationData> core_inputs_ [CORE_COUNT];
-    sc_core::sc_signal<ComputationData> core_outputs_[CORE_COUNT];
-    sc_core::sc_signal<bool>            core_ready_  [CORE_COUNT];
+    sc_core::sc_vector<ComputCore>                          compcore;
 
-    bool has_mem_reply_  = false;
+    sc_core::sc_vector<sc_core::sc_signal<ComputationData>> core_inputs_;
+    sc_core::sc_vector<sc_core::sc_signal<ComputationData>> core_outputs_;
+    sc_core::sc_vector<sc_core::sc_signal<bool>>            core_ready_;
 
-    std::array<fp_t, MAX_NEURONS>       inputs_;
-    std::array<fp_t, MAX_NEURONS>       outputs_;
-    std::array<bool, MAX_NEURONS>       outputs_ready_;
+    bool has_mem_reply_  = false;
 
-    std::array<NeuronData, CORE_COUNT>  neurons_;
-    std::array<bool, CORE_COUNT> core_cold_;
+    // Inputs of the current layer: the picture for the first layer, the
+    // outputs of the previous one for the rest
+    std::vector<fp_t>                   inputs_;
+    // Sized for the widest layer of the network
+    std::vector<fp_t>                   outputs_;
+    std::vector<bool>                   outputs_ready_;
+
+    // Neurons waiting for a free core, at most one per core
+    std::vector<NeuronData>             neurons_;
+
+    // Neurons fetched ahead with their weights, also at most one per
+    // core. Together with neurons_ it makes a double buffer: the next
+    // neurons are fetched while the current ones are being computed.
+    std::deque<NeuronData>              prefetched_;
+
+    // Prefetch state: neurons left to fetch, the offset of the next one,
+    // its header when already known, and the request in flight
+    size_t                              prefetch_left_ = 0;
+    offset_t                            prefetch_offset_;
+    NeuronData                          prefetch_header_;
+    bool                                has_prefetch_header_ = false;
+    bool                                prefetch_pending_    = false;
+    DataVector<MemRequest>              prefetch_request_;
+
+    // Clocks spent waiting for memory, the part of them when at least
+    // one core was computing, and the clocks the dispatch waited for the
+    // prefetch
+    size_t memory_cycles_         = 0;
+    size_t overlapped_cycles_     = 0;
+    size_t prefetch_stall_cycles_ = 0;
+
+    // A core is busy from the assignment until its output for exactly
+    // that neuron is collected. The ready signal alone is not enough: for
+    // a couple of cycles after an assignment it still shows the previous
+    // result.
+    std::vector<bool>                   core_busy_;
+    // (layer, neuron) assigned to every core
+    std::vector<std::pair<size_type, size_type>> core_neurons_;
 
     size_type inputs_size_;
     size_type outputs_size_;
     size_type neurons_size_;
 
+    const config_int_t input_count_;
+
 public:
     sc_core::sc_in<bool> clk;
     sc_core::sc_in<bool> rst;
@@ -55,13 +93,28 @@ private:
     void ResetOutputs();
     void ResetNeurons();
     void ResetCores();
+    bool IsCoreDone(config_int_t core) const;
+    bool IsAnyCoreBusy() const;
+    std::vector<uchar> FetchBytes(const DataVector<MemRequest>& request);
+    void CountMemoryCycle();
+    void PrefetchStep();
+    void Wait();
     void AddOutput(fp_t output, size_type index);
     void AddNeuron(const NeuronData& data);
     NeuronData PopNeuron();
     void AssignNeurons();
 
 public:
-    explicit CentralDispatchUnit(sc_core::sc_module_name const&);
+    // layer_size is the number of neurons in the widest layer
+    CentralDispatchUnit(sc_core::sc_module_name const&, config_int_t input_count,
+                        config_int_t core_count = CONFIG_COMP_CORE_COUNT,
+                        config_int_t layer_size = MAX_NEURONS);
+
+    config_int_t CoreCount() const;
+
+    size_t MemoryCycles() const;
+    size_t OverlappedMemoryCycles() const;
+    size_t PrefetchStallCycles() const;
 
     void MainProcess();
     void AtCoreReady();
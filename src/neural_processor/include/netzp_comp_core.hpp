@@ -70,10 +70,16 @@ private:
     sc_core::sc_signal<fp_t> activator_out_;
     sc_core::sc_signal<fp_t> accumulator_out_;
 
+    // Cycles from an input to the result: accumulator, activator and the
+    // output register
+    static constexpr int LATENCY = 3;
+
     ComputationData output_data_next_;
     ComputationData compdata_current_;
 
-    bool ready_next_;
+    bool ready_next_ = false;
+    bool busy_       = false;
+    int  stage_      = 0;
 public:
     sc_core::sc_in<bool> clk;
     sc_core::sc_in<bool> rst;
@@ -89,7 +95,6 @@ public:
 
     void AtClk();
     void AtInputData();
-    void AtOutputReady();
     void AtAccumulatorReady();
 
     ~ComputCore();
@@ -31,11 +31,28 @@ using config_int_t = unsigned int;
 
 // CONFIGURATION CONSTANTS
 constexpr config_int_t CONFIG_MEMORY_CONTROLLER_MAX_CONNECTIONS = 2;
+// Default number of memory banks. The real count is an elaboration
+// parameter of the memory controller, the testbench takes it from --banks.
+constexpr config_int_t CONFIG_MEMORY_BANK_COUNT = 1;
+constexpr config_int_t CONFIG_MEMORY_MAX_BANK_COUNT = 64;
+// Longest burst in memory words. Longer spans are split into several
+// bursts so that one master cannot hold the bus for too long.
+constexpr config_int_t CONFIG_MEMORY_MAX_BURST_LENGTH = 256;
+// Width of a memory word in bytes: 1, 2, 4, 8 or 16. The bus moves one
+// word per clock, so a wider word means fewer clocks per burst.
+#ifndef NETZP_MEMORY_WORD_SIZE
+#define NETZP_MEMORY_WORD_SIZE 4
+#endif
+constexpr config_int_t CONFIG_MEMORY_WORD_SIZE = NETZP_MEMORY_WORD_SIZE;
 constexpr config_int_t CONFIG_IO_RSVD_MEMORY_SIZE = 1026;
 constexpr config_int_t CONFIG_IO_RSVD_MEMORY_BASE_ADDR = 0x00;
+// Resolution used when the network dump does not declare its input count.
+// The real input count is taken from the dump at run time.
 constexpr config_int_t CONFIG_INPUT_PICTURE_WIDTH = 7;
 constexpr config_int_t CONFIG_INPUT_PICTURE_HEIGHT = 7;
 constexpr config_int_t CONFIG_INPUT_DATA_OFFSET = CONFIG_IO_RSVD_MEMORY_BASE_ADDR + CONFIG_IO_RSVD_MEMORY_SIZE;
+// Default number of computational cores. The real count is an elaboration
+// parameter of the CDU, the testbench takes it from --cores.
 constexpr config_int_t CONFIG_COMP_CORE_COUNT = 1;
 constexpr config_int_t CONFIG_CDU_MAX_NEURONS_COUNT = 255;
 constexpr config_int_t CONFIG_NETZ_MAX_OUTPUTS = 3;
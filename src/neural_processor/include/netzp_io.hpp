@@ -9,8 +9,12 @@
 
 namespace netzp {
 
+// Counts are 16-bit, so a neuron may have up to 65535 weights (a 255x255
+// picture). They are serialized little-endian, like the weights.
 struct NeuronData {
-    using count_type = uchar;
+    using count_type = uint16_t;
+
+    static constexpr size_t STATIC_SIZE = sizeof(count_type) * 3;
 
     count_type layer         = 0;
     count_type neuron        = 0;
@@ -32,7 +36,7 @@ struct NeuronData {
 std::ostream& operator<<(std::ostream& out, const NeuronData& neuron_data);
 
 struct NetzwerkData {
-    uchar neurons_count = 0;
+    NeuronData::count_type neurons_count = 0;
     std::vector<NeuronData> neurons;
 
     NetzwerkData() = default;
@@ -56,11 +60,10 @@ private:
     DataVector<MemRequest>   input_data_requests_;
     DataVector<MemRequest>   netz_data_requests_;
 
+    config_int_t             input_count_;
+
 public:
-    static constexpr config_int_t INPUT_COUNT          = CONFIG_INPUT_PICTURE_HEIGHT
-                                                       * CONFIG_INPUT_PICTURE_WIDTH;
     static constexpr config_int_t INPUTS_OFFSET        = CONFIG_INPUT_DATA_OFFSET;
-    static constexpr config_int_t NETZ_DATA_OFFSET     = INPUTS_OFFSET + INPUT_COUNT;
     static constexpr config_int_t MASTER_ID            = 1;
     static constexpr config_int_t IO_BASE_ADDR         = CONFIG_IO_RSVD_MEMORY_BASE_ADDR;
     static constexpr config_int_t IO_SIZE              = CONFIG_IO_RSVD_MEMORY_SIZE;
@@ -72,8 +75,8 @@ public:
     sc_core::sc_in<bool> clk;
     sc_core::sc_in<bool> rst;
 
-    // User side
-    sc_core::sc_in<bool>            data_inputs[INPUT_COUNT];
+    // User side, one port per input pixel
+    sc_core::sc_vector<sc_core::sc_in<bool>> data_inputs;
     sc_signal_port_in<NetzwerkData> netz_data;
 
     sc_signal_port_out<DataVector<MemRequest>> requests;
@@ -85,11 +88,15 @@ public:
     sc_signal_port_out<DataVector<fp_t>> outputs;
 
 
-private:
-    std::vector<MemRequest> BytesToRequests(const std::vector<uchar>& bytes, offset_t offset) const;
-
 public:
-    explicit InOutController(sc_core::sc_module_name const&);
+    InOutController(sc_core::sc_module_name const&, config_int_t input_count);
+
+    // Network data is placed right after the input pixels, one byte each
+    static offset_t NetzDataOffset(config_int_t input_count) {
+        return INPUTS_OFFSET + input_count;
+    }
+
+    config_int_t InputCount() const;
 
     void SendInputDataAtClk();
 
@@ -5,6 +5,8 @@
 #include "netzp_utils.hpp"
 #include <deque>
 #include <systemc>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace netzp {
@@ -14,9 +16,25 @@ constexpr unsigned int KBYTE = BYTE  * 1024;
 constexpr unsigned int MBYTE = KBYTE * 1024;
 constexpr unsigned int GBYTE = MBYTE * 1024;
 
-using mem_data_t = sc_dt::sc_uint<8>;
-using mem_addr_t = sc_dt::sc_uint<16>;
+constexpr config_int_t MEM_WORD_SIZE = CONFIG_MEMORY_WORD_SIZE;
+constexpr int          MEM_WORD_BITS = 8 * MEM_WORD_SIZE;
+
+static_assert(MEM_WORD_SIZE == 1 || MEM_WORD_SIZE == 2 || MEM_WORD_SIZE == 4
+              || MEM_WORD_SIZE == 8 || MEM_WORD_SIZE == 16,
+              "The memory word must be 1, 2, 4, 8 or 16 bytes wide");
+
+// sc_uint is limited to 64 bits
+using mem_data_t = std::conditional_t<(MEM_WORD_BITS <= 64),
+                                      sc_dt::sc_uint<MEM_WORD_BITS>,
+                                      sc_dt::sc_biguint<MEM_WORD_BITS>>;
+// One bit per byte lane of a word: the lanes a burst actually reads or
+// writes. Only the first and the last words of a span can be partial.
+using mem_byte_en_t = sc_dt::sc_uint<MEM_WORD_SIZE>;
+// 32-bit addresses: the weights of a 64x64 input layer alone do not fit
+// into 64 KB. Masters address bytes, the bus and the memory address words.
+using mem_addr_t = sc_dt::sc_uint<32>;
 using mem_master_id_t = sc_dt::sc_uint<8>;
+using mem_len_t = sc_dt::sc_uint<16>;
 
 enum class MemOperationType {
     WRITE,
@@ -30,11 +48,16 @@ enum class MemOperationStatus {
     NONE
 };
 
+// A burst of `length` memory words at consecutive word addresses
+// starting at addr. byte_en holds the enabled lanes of every word, a
+// write carries the data of every word in data_wr.
 struct MemRequest {
-    mem_master_id_t  master_id;
-    MemOperationType op_type;
-    mem_addr_t       addr;
-    mem_data_t       data_wr;
+    mem_master_id_t            master_id;
+    MemOperationType           op_type;
+    mem_addr_t                 addr;
+    mem_len_t                  length;
+    std::vector<mem_byte_en_t> byte_en;
+    std::vector<mem_data_t>    data_wr;
 
     MemRequest();
 
@@ -45,12 +68,15 @@ struct MemRequest {
 
 std::ostream& operator << (std::ostream& out, const MemRequest& req);
 
+// The reply to a whole burst: the words read (or written), in address
+// order, with the byte enables of the request
 struct MemReply {
-    mem_master_id_t    master_id;
-    MemOperationType   op_type;
-    MemOperationStatus status;
-    mem_data_t         data;
-    mem_addr_t         addr;
+    mem_master_id_t            master_id;
+    MemOperationType           op_type;
+    MemOperationStatus         status;
+    std::vector<mem_byte_en_t> byte_en;
+    std::vector<mem_data_t>    data;
+    mem_addr_t                 addr;
 
     MemReply();
 
@@ -61,8 +87,15 @@ struct MemReply {
 
 std::ostream& operator << (std::ostream& out, const MemReply& reply);
 
+// Byte `lane` of a word is the byte at address word * MEM_WORD_SIZE + lane
+uchar WordByte(const mem_data_t& word, size_t lane);
+void SetWordByte(mem_data_t& word, size_t lane, uchar byte);
+
+// The enabled bytes of the replies, in address order
 std::vector<uchar> RepliesToBytes(const std::vector<MemReply>& replies);
 
+// Both take a byte span and cover it with bursts of at most
+// MAX_BURST_LENGTH words. The span does not have to be word aligned.
 std::vector<MemRequest> ReadMemorySpanRequests(mem_addr_t base_addr, size_t size,
                                                mem_master_id_t master_id);
 
@@ -72,16 +105,19 @@ std::vector<MemRequest> BytesToWriteRequests(mem_addr_t base_addr,
 
 std::vector<fp_t> BytesToFloatingPoints(const std::vector<uchar>& bytes);
 
+constexpr config_int_t MAX_BURST_LENGTH = CONFIG_MEMORY_MAX_BURST_LENGTH;
+
+// Synchronous memory bank: an access presented on one clock edge is done on
+// the next one, and ack_out tells that data_rd holds the word read (or
+// that the word was written). A new access may be presented on every
+// clock, so a burst streams one word per cycle. A write changes only the
+// lanes enabled in byte_en.
 class Mem : public sc_core::sc_module {
 private:
     static constexpr unsigned int MEMSIZE = 64 * KBYTE;
-    mem_data_t               data_rd_next_;
-    bool                     ack_next_;
     std::vector<mem_data_t>  mem_;
 
     void AtClk();
-    void AtAck();
-    void MemAccess();
 
 public:
     // I/O
@@ -89,49 +125,74 @@ public:
     sc_core::sc_in<bool>          rst;
 
     sc_core::sc_in<mem_data_t>    data_wr;
+    sc_core::sc_in<mem_byte_en_t> byte_en;
     sc_core::sc_in<mem_addr_t>    addr;
     sc_core::sc_in<bool>          w_en;
     sc_core::sc_in<bool>          r_en;
-    sc_core::sc_in<bool>          ack_in;
 
     sc_core::sc_out<bool>         ack_out;
     sc_core::sc_out<mem_data_t>   data_rd;
 
-    void Dump(std::ostream& out) const;
+    // Prints the contents of the banks as one memory, in the order of the
+    // byte addresses seen by the masters
+    static void Dump(std::ostream& out, const sc_core::sc_vector<Mem>& banks);
 
+    // memsize is in bytes, rounded up to whole words
     explicit Mem(sc_core::sc_module_name const&, int memsize = MEMSIZE);
 };
 
+// Crossbar between the masters and the memory banks. Consecutive words
+// are interleaved over the banks: word addr lives in bank
+// addr % bank_count at index addr / bank_count. Every master has its own
+// burst in progress and presents at most one word per clock, so the
+// masters proceed in parallel while they hit different banks. When two
+// of them want the same bank on the same clock, the one with priority
+// gets it and the others wait. The priority rotates every clock.
 class MemController : public sc_core::sc_module {
 private:
     static constexpr long unsigned int MAX_CONNECTIONS = CONFIG_MEMORY_CONTROLLER_MAX_CONNECTIONS;
 
-    mem_data_t data_wr_next_;
-    mem_addr_t addr_next_;
-    bool       w_en_next_;
-    bool       r_en_next_;
-    bool       ack_out_next_;
+    struct Burst {
+        bool       busy = false;
+        MemRequest request;
+        MemReply   reply;
+        size_t     issued = 0;
+        size_t     acked  = 0;
+    };
+
+    const config_int_t bank_count_;
+
+    // The last request served for every master. A master repeats its
+    // request until it gets the reply, so only a different one is new.
+    MemRequest served_[MAX_CONNECTIONS];
+    Burst      bursts_[MAX_CONNECTIONS];
 
-    bool       access_granted_next_[MAX_CONNECTIONS];
-    MemRequest request_;
-    MemReply   reply_next_;
+    // Accesses presented to every bank and not acknowledged yet: the
+    // master and the index of the word in its burst. A bank acknowledges
+    // its accesses in order.
+    std::vector<std::deque<std::pair<size_t, size_t>>> in_flight_;
 
-    sc_dt::sc_uint<8>                     current_access_next_;
-    sc_core::sc_signal<sc_dt::sc_uint<8>> current_access_;
+    size_t priority_        = 0;
+    size_t bank_conflicts_  = 0;
+
+    void StartBurst(size_t master);
+    void CollectAcks();
+    void IssueWords();
+    void FinishBursts();
 
 public:
     sc_core::sc_in<bool>           clk;
     sc_core::sc_in<bool>           rst;
 
-    // Memory side
-    sc_core::sc_out<mem_data_t>    data_wr;
-    sc_core::sc_out<mem_addr_t>    addr;
-    sc_core::sc_out<bool>          w_en;
-    sc_core::sc_out<bool>          r_en;
-    sc_core::sc_out<bool>          ack_out;
+    // Memory side, one port of every kind per bank
+    sc_core::sc_vector<sc_core::sc_out<mem_data_t>>    data_wr;
+    sc_core::sc_vector<sc_core::sc_out<mem_byte_en_t>> byte_en;
+    sc_core::sc_vector<sc_core::sc_out<mem_addr_t>>    addr;
+    sc_core::sc_vector<sc_core::sc_out<bool>>          w_en;
+    sc_core::sc_vector<sc_core::sc_out<bool>>          r_en;
 
-    sc_core::sc_in<bool>           ack_in;
-    sc_core::sc_in<mem_data_t>     data_rd;
+    sc_core::sc_vector<sc_core::sc_in<bool>>           ack_in;
+    sc_core::sc_vector<sc_core::sc_in<mem_data_t>>     data_rd;
 
     // Masters side
     sc_core::sc_in<bool>           access_request[MAX_CONNECTIONS];
@@ -140,13 +201,15 @@ public:
     sc_signal_port_out<MemReply>   replies_out[MAX_CONNECTIONS];
 
 public:
-    explicit MemController(sc_core::sc_module_name const&);
+    explicit MemController(sc_core::sc_module_name const&,
+                           config_int_t bank_count = CONFIG_MEMORY_BANK_COUNT);
+
+    config_int_t BankCount() const;
+
+    // Clocks a master waited because its bank was taken by another one
+    size_t BankConflicts() const;
 
     void AtClk();
-    void AtRequest();
-    void AtAccessRequest();
-    void AtAck();
-    void AtCounter();
 };
 
 class MemIO : public sc_core::sc_module {
@@ -35,4 +35,11 @@ std::vector<uchar> ToBytesVector(PrimitiveType value) {
     return result;
 }
 
+template <typename PrimitiveType>
+PrimitiveType FromBytes(const uchar *bytes) {
+    PrimitiveType value;
+    memcpy(&value, bytes, sizeof(PrimitiveType));
+    return value;
+}
+
 #endif // _NETZP_UTILS_H_
\ No newline at end of file
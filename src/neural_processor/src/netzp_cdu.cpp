@@ -6,6 +6,7 @@
 #include "netzp_utils.hpp"
 #include "sysc/kernel/sc_module.h"
 #include "sysc/kernel/sc_wait.h"
+#include <algorithm>
 #include <stdexcept>
 #include <string>
 
@@ -18,16 +19,28 @@ void CentralDispatchUnit::AtMemReply() {
     has_mem_reply_ = true;
 }
 
+bool CentralDispatchUnit::IsCoreDone(config_int_t core) const {
+    if (!core_busy_[core] || !core_ready_[core].read()) {
+        return false;
+    }
+
+    const auto& data = core_outputs_[core].read().data;
+
+    return data.layer == core_neurons_[core].first
+        && data.neuron == core_neurons_[core].second;
+}
+
 void CentralDispatchUnit::CheckAllCoreOutputs() {
-    for (int i = 0; i < CORE_COUNT; i++) {
+    for (config_int_t i = 0; i < core_count_; i++) {
+        if (!IsCoreDone(i)) {
+            continue;
+        }
+
         const auto& core_output = core_outputs_[i].read();
-        const auto neuron = core_output.data.neuron;
 
-        if (outputs_ready_[neuron] == false && core_ready_[i].read() == true && !core_cold_[i]) {
-            DEBUG_OUT_MODULE(1) << "Got output " << core_output << " from core " << i << std::endl;
-            AddOutput(core_output.output, neuron);
-            core_cold_[i] = true;
-        }
+        DEBUG_OUT_MODULE(1) << "Got output " << core_output << " from core " << i << std::endl;
+        AddOutput(core_output.output, core_output.data.neuron);
+        core_busy_[i] = false;
     }
 }
 
@@ -43,10 +56,8 @@ bool CentralDispatchUnit::IsAllReady() const {
 }
 
 void CentralDispatchUnit::ResetOutputs() {
-    for (int i = 0; i < outputs_.max_size(); i++) {
-        outputs_[i] = 0;
-        outputs_ready_[i] = false;
-    }
+    std::fill(outputs_.begin(), outputs_.end(), 0);
+    std::fill(outputs_ready_.begin(), outputs_ready_.end(), false);
 
     outputs_size_ = 0;
 }
@@ -56,7 +67,7 @@ void CentralDispatchUnit::ResetNeurons() {
 }
 
 void CentralDispatchUnit::AddNeuron(const NeuronData& data) {
-    if (neurons_size_ >= neurons_.max_size()) {
+    if (neurons_size_ >= neurons_.size()) {
         throw std::invalid_argument("neurons size exceeded");
     }
 
@@ -72,7 +83,7 @@ NeuronData CentralDispatchUnit::PopNeuron() {
 }
 
 void CentralDispatchUnit::AddOutput(fp_t value, CentralDispatchUnit::size_type index) {
-    if (index >= outputs_.max_size())
+    if (index >= outputs_.size())
         throw std::invalid_argument("Index " + std::to_string(index) + " out of bounds");
 
     outputs_[index] = value;
@@ -80,43 +91,137 @@ void CentralDispatchUnit::AddOutput(fp_t value, CentralDispatchUnit::size_type i
 }
 
 void CentralDispatchUnit::AssignNeurons() {
-    for (int i = 0; i < CORE_COUNT; i++) {
-        const auto& core_output = core_outputs_[i].read();
-        const auto neuron = core_output.data.neuron;
-        const bool core_ready = core_ready_[i].read();
+    for (config_int_t i = 0; i < core_count_ && neurons_size_ != 0; i++) {
+        if (core_busy_[i]) {
+            continue;
+        }
+
+        ComputationData cdata;
+        cdata.data = PopNeuron();
+        cdata.inputs = std::vector(inputs_.begin(), inputs_.begin() + inputs_size_);
 
-        if ((core_ready || core_cold_[i]) && (neurons_size_ != 0)) {
-            NeuronData ndata = PopNeuron();
+        core_inputs_[i].write(cdata);
+        core_busy_[i] = true;
+        core_neurons_[i] = { cdata.data.layer, cdata.data.neuron };
+
+        DEBUG_OUT_MODULE(1) << "ASSIGNED " << cdata.data << " to core " << i << std::endl;
+    }
+}
+
+void CentralDispatchUnit::ResetCores() {
+    std::fill(core_busy_.begin(), core_busy_.end(), false);
+}
+
+bool CentralDispatchUnit::IsAnyCoreBusy() const {
+    return std::find(core_busy_.begin(), core_busy_.end(), true) != core_busy_.end();
+}
 
-            ComputationData cdata;
-            cdata.data = std::move(ndata);
-            cdata.inputs = std::vector(inputs_.begin(), inputs_.begin() + inputs_size_);
+void CentralDispatchUnit::CountMemoryCycle() {
+    memory_cycles_++;
+    if (IsAnyCoreBusy()) {
+        overlapped_cycles_++;
+    }
+}
 
-            core_inputs_[i].write(cdata);
-            core_cold_[i] = false;
+// Blocking fetch, used while nothing else is going on
+std::vector<uchar> CentralDispatchUnit::FetchBytes(const DataVector<MemRequest>& request) {
+    while (true) {
+        sc_core::wait();
+        mem_requests->write(request);
+        CountMemoryCycle();
 
-            DEBUG_OUT_MODULE(1) << "ASSIGNED " << ndata << " to core " << i << std::endl;
+        if (has_mem_reply_) {
+            has_mem_reply_ = false;
+            return RepliesToBytes(mem_replies->read().data);
         }
     }
 }
 
-void CentralDispatchUnit::ResetCores() {
-    for (int i = 0; i < CORE_COUNT; i++) {
-        core_cold_[i] = true;
+// One clock of the prefetch. Neurons are fetched one after another while
+// prefetched_ has room. The weights of a neuron and the header of the
+// next one are adjacent in memory, so both come with one request, and
+// only the first header is fetched on its own.
+void CentralDispatchUnit::PrefetchStep() {
+    using count_type = NeuronData::count_type;
+
+    const size_t   neuron_static_size            = NeuronData::STATIC_SIZE;
+    const offset_t neuron_data_layer_off         = 0;
+    const offset_t neuron_data_neuron_off        = sizeof(count_type);
+    const offset_t neuron_data_weights_count_off = sizeof(count_type) * 2;
+    const offset_t neuron_data_weights_off       = NeuronData::STATIC_SIZE;
+
+    if (!prefetch_pending_ && prefetch_left_ > 0) {
+        if (!has_prefetch_header_) {
+            prefetch_request_.data = ReadMemorySpanRequests(prefetch_offset_, neuron_static_size,
+                                                            MASTER_ID);
+            prefetch_pending_ = true;
+        } else if (prefetched_.size() < core_count_) {
+            const size_t weights_size = prefetch_header_.weights_count * sizeof(fp_t);
+            const size_t next_size    = prefetch_left_ > 1 ? neuron_static_size : 0;
+
+            prefetch_request_.data = ReadMemorySpanRequests(prefetch_offset_ + neuron_data_weights_off,
+                                                            weights_size + next_size,
+                                                            MASTER_ID);
+            prefetch_pending_ = true;
+        }
+    }
+
+    if (!prefetch_pending_) {
+        return;
     }
+
+    mem_requests->write(prefetch_request_);
+    CountMemoryCycle();
+
+    if (!has_mem_reply_) {
+        return;
+    }
+
+    has_mem_reply_    = false;
+    prefetch_pending_ = false;
+
+    const auto bytes = RepliesToBytes(mem_replies->read().data);
+    size_t header_off = 0;
+
+    if (has_prefetch_header_) {
+        const size_t weights_size = prefetch_header_.weights_count * sizeof(fp_t);
+
+        prefetch_header_.weights = BytesToFloatingPoints(
+            std::vector<uchar>(bytes.begin(), bytes.begin() + weights_size));
+        prefetched_.push_back(prefetch_header_);
+
+        prefetch_offset_ += prefetch_header_.SizeInBytes();
+        prefetch_left_--;
+
+        has_prefetch_header_ = false;
+        header_off           = weights_size;
+    }
+
+    if (prefetch_left_ > 0) {
+        prefetch_header_               = NeuronData();
+        prefetch_header_.layer         = FromBytes<count_type>(&bytes.at(header_off + neuron_data_layer_off));
+        prefetch_header_.neuron        = FromBytes<count_type>(&bytes.at(header_off + neuron_data_neuron_off));
+        prefetch_header_.weights_count = FromBytes<count_type>(
+            &bytes.at(header_off + neuron_data_weights_count_off));
+        has_prefetch_header_           = true;
+    }
+}
+
+// Waits for the next clock while the neurons are being dispatched, so
+// that the prefetch goes on in the meantime
+void CentralDispatchUnit::Wait() {
+    sc_core::wait();
+    PrefetchStep();
 }
 
 void CentralDispatchUnit::MainProcess() {
-    const offset_t neurons_off                   = InOutController::NETZ_DATA_OFFSET + 1;
-    const size_t   neuron_static_size            = sizeof(NeuronData::count_type) * 3;
-    const offset_t neuron_data_layer_off         = 0;
-    const offset_t neuron_data_neuron_off        = 1;
-    const offset_t neuron_data_weights_count_off = 2;
-    const offset_t neuron_data_weights_off       = 3;
+    using count_type = NeuronData::count_type;
+
+    const offset_t netz_data_off = InOutController::NetzDataOffset(input_count_);
+    const offset_t neurons_off   = netz_data_off + sizeof(count_type);
 
     DataVector<MemRequest> ready_byte_reqs;
     ready_byte_reqs.data.emplace_back();
-    ready_byte_reqs.data.back().data_wr   = 0x00;
     ready_byte_reqs.data.back().addr      = InOutController::IO_FLAGS_ADDR;
     ready_byte_reqs.data.back().master_id = MASTER_ID;
     ready_byte_reqs.data.back().op_type   = MemOperationType::READ;
@@ -134,6 +239,15 @@ void CentralDispatchUnit::MainProcess() {
             ResetCores();
             ResetOutputs();
             ResetNeurons();
+
+            prefetched_.clear();
+            prefetch_left_        = 0;
+            has_prefetch_header_  = false;
+            prefetch_pending_     = false;
+
+            memory_cycles_         = 0;
+            overlapped_cycles_     = 0;
+            prefetch_stall_cycles_ = 0;
             continue;
         }
 
@@ -144,89 +258,71 @@ void CentralDispatchUnit::MainProcess() {
         // fetch inputs
         DataVector<MemRequest> input_req;
         input_req.data = ReadMemorySpanRequests(InOutController::INPUTS_OFFSET,
-                                                InOutController::INPUT_COUNT,
+                                                input_count_,
                                                 MASTER_ID);
-        while (true) {
-            sc_core::wait();
-            mem_requests->write(input_req);
-            if (has_mem_reply_) {
-                const auto bytes = RepliesToBytes(mem_replies->read().data);
-
-                for (int i = 0; i < InOutController::INPUT_COUNT; i++) {
-                    inputs_[i] = bytes[i];
-                }
+        {
+            const auto bytes = FetchBytes(input_req);
 
-                inputs_size_ = InOutController::INPUT_COUNT;
-                has_mem_reply_ = false;
-                break;
+            for (int i = 0; i < input_count_; i++) {
+                inputs_[i] = bytes[i];
             }
+
+            inputs_size_ = input_count_;
         }
 
         // fetch_neuron_count
         DEBUG_OUT(1) << "fetch" << std::endl;
-        uchar neuron_count = 0;
+        count_type neuron_count = 0;
 
         DataVector<MemRequest> netz_req;
-        netz_req.data = ReadMemorySpanRequests(InOutController::NETZ_DATA_OFFSET,
-                                                    sizeof(neuron_count), MASTER_ID);
-        while (true) {
-            sc_core::wait();
-            mem_requests->write(netz_req);
-            if (has_mem_reply_) {
-                auto bytes     = RepliesToBytes(mem_replies->read().data);
-                neuron_count   = *bytes.data();
-                has_mem_reply_ = false;
+        netz_req.data = ReadMemorySpanRequests(netz_data_off, sizeof(neuron_count),
+                                               MASTER_ID);
+        neuron_count = FromBytes<count_type>(FetchBytes(netz_req).data());
 
-                DEBUG_OUT(1) << +neuron_count << std::endl;
-                break;
-            }
-        }
+        DEBUG_OUT(1) << +neuron_count << std::endl;
 
         DEBUG_OUT(1) << "neuron fetch" << std::endl;
 
-        // And now we start fetching neurons one by one
+        // From now on the neurons are fetched ahead by PrefetchStep and
+        // taken from prefetched_ one by one
+        prefetch_left_   = neuron_count;
+        prefetch_offset_ = neurons_off;
+
         NeuronData ndata;
         ndata.neuron  = 0;
         ndata.layer   = 0;
         outputs_size_ = 0;
 
-        offset_t current_offset = neurons_off;
         for (int k = 0; k < neuron_count; k++) {
-            sc_core::wait();
+            Wait();
 
             DEBUG_OUT(1) << "neuron #" << k << std::endl;
 
-            // First, get static data
-            DataVector<MemRequest> neuron_req;
-            neuron_req.data = ReadMemorySpanRequests(current_offset, neuron_static_size,
-                                                     MASTER_ID);
-
-            NeuronData ndata_next;
-            while (true) {
-                sc_core::wait();
-                mem_requests->write(neuron_req);
-                if (has_mem_reply_) {
-                    const auto bytes         = RepliesToBytes(mem_replies->read().data);
-                    ndata_next.layer         = bytes.at(neuron_data_layer_off);
-                    ndata_next.neuron        = bytes.at(neuron_data_neuron_off);
-                    ndata_next.weights_count = bytes.at(neuron_data_weights_count_off);
-                    has_mem_reply_           = false;
-                    break;
-                }
+            // The cores keep getting neurons while the next one is not
+            // fetched yet
+            while (prefetched_.empty()) {
+                Wait();
+                prefetch_stall_cycles_++;
+
+                CheckAllCoreOutputs();
+                AssignNeurons();
             }
 
+            NeuronData ndata_next = prefetched_.front();
+            prefetched_.pop_front();
+
             DEBUG_OUT(1) << "check layer" << std::endl;
 
             // If suddenly the layer is now different, we first wait for the previous layer
             // to finish
             if (ndata_next.layer != ndata.layer) {
                 while (true) {
-                    sc_core::wait();
+                    Wait();
 
                     CheckAllCoreOutputs();
                     AssignNeurons();
 
-                    sc_core::wait();
+                    Wait();
 
                     // Check if all of them finished
                     bool all_ready = IsAllReady();
@@ -234,7 +330,8 @@ void CentralDispatchUnit::MainProcess() {
                     // If finished, get the results and put them into inputs array
                     // for the next layer
                     if (all_ready) {
-                        inputs_      = outputs_;
+                        std::copy(outputs_.begin(), outputs_.begin() + outputs_size_,
+                                  inputs_.begin());
                         inputs_size_ = outputs_size_;
 
                         ResetOutputs();
@@ -242,7 +339,7 @@ void CentralDispatchUnit::MainProcess() {
                         ResetNeurons();
 
                         DEBUG_OUT_MODULE(1) << "Outputs ready after reset:" << std::endl;
-                        for (int i = 0; i < 50; i++) {
+                        for (int i = 0; i < outputs_size_; i++) {
                             DEBUG_OUT_MODULE(1) << "outputs_ready_[" << i << "] = " << outputs_ready_[i] << std::endl;
                         }
 
@@ -254,46 +351,22 @@ void CentralDispatchUnit::MainProcess() {
 
             outputs_size_++;
 
-            DEBUG_OUT_MODULE(1) << "Get weights" << std::endl;
-
-            // Then get the weights
-            DataVector<MemRequest> weights_req;
-            weights_req.data = ReadMemorySpanRequests(current_offset + neuron_data_weights_off,
-                                                      ndata_next.weights_count * sizeof(fp_t),
-                                                      MASTER_ID);
-            std::vector<uchar> weights_bytes;
-
-            while (true) {
-                sc_core::wait();
-                mem_requests->write(weights_req);
-                if (has_mem_reply_) {
-                    weights_bytes  = RepliesToBytes(mem_replies->read().data);
-                    has_mem_reply_ = false;
-                    break;
-                }
-            }
-
-            ndata_next.weights = BytesToFloatingPoints(weights_bytes);
-
             // Finally, a neuron
             ndata = ndata_next;
 
             AddNeuron(ndata);
-            if (neurons_size_ == neurons_.max_size()) {
+            if (neurons_size_ == neurons_.size()) {
                 while (neurons_size_ > 0) {
-                    sc_core::wait();
+                    Wait();
                     CheckAllCoreOutputs();
                     AssignNeurons();
                 }
             }
 
             DEBUG_OUT_MODULE(1) << "Outputs ready:" << std::endl;
-            for (int i = 0; i < 50; i++) {
+            for (int i = 0; i < outputs_size_; i++) {
                 DEBUG_OUT_MODULE(1) << "outputs_ready_[" << i << "] = " << outputs_ready_[i] << std::endl;
             }
-
-            // move to the next
-            current_offset += ndata.SizeInBytes();
         }
 
         // this wait() call is necessary for the last layer of neurons to be
@@ -328,36 +401,68 @@ void CentralDispatchUnit::MainProcess() {
         output_req.data = BytesToWriteRequests(InOutController::IO_OUTPUTS_BASE_ADDR,
                                                output_bytes, MASTER_ID);
 
-        while (true) {
-            sc_core::wait();
-            mem_requests->write(output_req);
-
-            if (has_mem_reply_) {
-                finished->write(true);
-                has_mem_reply_ = false;
-                break;
-            }
-        }
+        FetchBytes(output_req);
+        finished->write(true);
     }
 }
 
-CentralDispatchUnit::CentralDispatchUnit(sc_core::sc_module_name const&) {
-    for (int i = 0; i < CORE_COUNT; i++) {
-        std::string name = "Compcore_" + std::to_string(i);
-        compcore[i] = new ComputCore(name.c_str());
+config_int_t CentralDispatchUnit::CoreCount() const {
+    return core_count_;
+}
+
+size_t CentralDispatchUnit::MemoryCycles() const {
+    return memory_cycles_;
+}
+
+size_t CentralDispatchUnit::OverlappedMemoryCycles() const {
+    return overlapped_cycles_;
+}
+
+size_t CentralDispatchUnit::PrefetchStallCycles() const {
+    return prefetch_stall_cycles_;
+}
+
+CentralDispatchUnit::CentralDispatchUnit(sc_core::sc_module_name const&,
+                                         config_int_t input_count,
+                                         config_int_t core_count,
+                                         config_int_t layer_size)
+    : core_count_(core_count)
+    , compcore("Compcore")
+    , core_inputs_("core_inputs")
+    , core_outputs_("core_outputs")
+    , core_ready_("core_ready")
+    , inputs_(std::max<config_int_t>(input_count, layer_size))
+    , outputs_(layer_size)
+    , outputs_ready_(layer_size)
+    , neurons_(core_count)
+    , core_busy_(core_count, false)
+    , core_neurons_(core_count)
+    , input_count_(input_count) {
+    // Cores beyond the widest layer would stay idle, and layers wider
+    // than MAX_NEURONS are rare, so the core count is capped by it
+    if (core_count == 0 || core_count > MAX_NEURONS) {
+        throw std::invalid_argument("Core count must be from 1 to "
+                                    + std::to_string(MAX_NEURONS));
+    }
 
-        compcore[i]->clk(clk);
-        compcore[i]->rst(rst);
-        compcore[i]->input_data(core_inputs_[i]);
-        compcore[i]->output_data(core_outputs_[i]);
-        compcore[i]->ready(core_ready_[i]);
+    compcore.init(core_count);
+    core_inputs_.init(core_count);
+    core_outputs_.init(core_count);
+    core_ready_.init(core_count);
+
+    for (config_int_t i = 0; i < core_count; i++) {
+        compcore[i].clk(clk);
+        compcore[i].rst(rst);
+        compcore[i].input_data(core_inputs_[i]);
+        compcore[i].output_data(core_outputs_[i]);
+        compcore[i].ready(core_ready_[i]);
     }
 
     SC_THREAD(MainProcess);
     sensitive << clk.pos();
 
     SC_METHOD(AtCoreReady);
-    for (int i = 0; i < CORE_COUNT; i++) sensitive << core_ready_[i];
+    for (auto& core_ready : core_ready_) sensitive << core_ready;
 
     SC_METHOD(AtMemReply);
     sensitive << mem_replies;
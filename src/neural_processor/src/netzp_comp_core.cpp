@@ -88,25 +88,35 @@ ActivationCore::ActivationCore(sc_core::sc_module_name const&) {
     sensitive << data;
 }
 
+// The result is taken a fixed number of cycles after the input instead
+// of on a change of the activator output: two neurons in a row with the
+// same output (e.g. both saturated at 1) would otherwise never become
+// ready.
 void ComputCore::AtClk() {
     if (rst->read()) {
         output_data->write(ComputationData());
+        ready->write(false);
+        ready_next_ = false;
+        busy_ = false;
     } else if (clk->read()) {
+        if (busy_ && ++stage_ == LATENCY) {
+            output_data_next_ = compdata_current_;
+            output_data_next_.output = activator_out_.read();
+            ready_next_ = true;
+            busy_ = false;
+            DEBUG_OUT_MODULE(1) << PRINTVAL(activator_out_) << std::endl;
+        }
+
         output_data->write(output_data_next_);
         ready->write(ready_next_);
     }
 }
 
-void ComputCore::AtOutputReady() {
-    output_data_next_ = compdata_current_;
-    output_data_next_.output = activator_out_.read();
-    ready_next_ = true;
-    DEBUG_OUT_MODULE(1) << PRINTVAL(activator_out_) << std::endl;
-}
-
 void ComputCore::AtInputData() {
     compdata_current_ = input_data->read();
     ready_next_ = false;
+    busy_ = true;
+    stage_ = 0;
 }
 
 void ComputCore::AtAccumulatorReady() {
@@ -131,9 +141,6 @@ ComputCore::ComputCore(sc_core::sc_module_name const &name) {
     SC_METHOD(AtClk);
     sensitive << clk.pos();
 
-    SC_METHOD(AtOutputReady);
-    sensitive << activator_out_;
-
     SC_METHOD(AtInputData);
     sensitive << input_data;
 
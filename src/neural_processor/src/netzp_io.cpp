@@ -13,14 +13,14 @@ constexpr char INVALID_BYTES[] = "Amount of bytes is not valid for this type";
 
 NeuronData NeuronData::Deserialize(const uchar *bytes) {
     const offset_t layer_off         = 0;
-    const offset_t neuron_off        = 1;
-    const offset_t weights_count_off = 2;
-    const offset_t weights_off       = 3;
+    const offset_t neuron_off        = sizeof(count_type);
+    const offset_t weights_count_off = sizeof(count_type) * 2;
+    const offset_t weights_off       = STATIC_SIZE;
 
     NeuronData data;
-    data.layer         = bytes[layer_off];
-    data.neuron        = bytes[neuron_off];
-    data.weights_count = bytes[weights_count_off];
+    data.layer         = FromBytes<count_type>(bytes + layer_off);
+    data.neuron        = FromBytes<count_type>(bytes + neuron_off);
+    data.weights_count = FromBytes<count_type>(bytes + weights_count_off);
 
     const size_t neuron_size = data.SizeInBytes();
 
@@ -34,7 +34,7 @@ NeuronData NeuronData::Deserialize(const uchar *bytes) {
 }
 
 size_t NeuronData::SizeInBytes() const {
-    return sizeof(count_type) * 3 + sizeof(fp_t) * weights_count;
+    return STATIC_SIZE + sizeof(fp_t) * weights_count;
 }
 
 bool NeuronData::operator==(const NeuronData& other) const {
@@ -47,9 +47,11 @@ bool NeuronData::operator==(const NeuronData& other) const {
 const std::vector<uchar> NeuronData::Serialize() const {
     std::vector<uchar> result;
 
-    result.push_back(layer);
-    result.push_back(neuron);
-    result.push_back(weights_count);
+    for (count_type count : { layer, neuron, weights_count }) {
+        for (uchar byte : ToBytesVector(count)) {
+            result.push_back(byte);
+        }
+    }
 
     for (float weight : weights) {
         for (uchar byte : ToBytesVector(weight)) {
@@ -86,13 +88,13 @@ bool NetzwerkData::operator==(const NetzwerkData& other) const {
 
 NetzwerkData NetzwerkData::Deserialize(const uchar *bytes) {
     const offset_t neurons_count_off = 0;
-    const offset_t neurons_off       = 1;
+    const offset_t neurons_off       = sizeof(NeuronData::count_type);
     NetzwerkData data;
 
-    data.neurons_count = bytes[neurons_count_off];
+    data.neurons_count = FromBytes<NeuronData::count_type>(bytes + neurons_count_off);
 
     offset_t current_offset = neurons_off;
-    for (uchar i = 0; i < data.neurons_count; i++){
+    for (size_t i = 0; i < data.neurons_count; i++){
         NeuronData n = NeuronData::Deserialize(bytes + current_offset);
 
         current_offset += n.SizeInBytes();
@@ -105,7 +107,10 @@ NetzwerkData NetzwerkData::Deserialize(const uchar *bytes) {
 const std::vector<uchar> NetzwerkData::Serialize() const {
     std::vector<uchar> result;
 
-    result.push_back(neurons_count);
+    for (uchar byte : ToBytesVector(neurons_count)) {
+        result.push_back(byte);
+    }
+
     for (const NeuronData& n : neurons) {
         for (const auto byte : n.Serialize()) {
             result.push_back(byte);
@@ -132,23 +137,6 @@ std::ostream& operator<<(std::ostream& out, const NetzwerkData& netz_data) {
     return out;
 }
 
-std::vector<MemRequest>
-InOutController::BytesToRequests(const std::vector<uchar>& bytes, offset_t offset) const {
-    std::vector<MemRequest> result;
-    for (const auto byte : bytes) {
-        result.emplace_back();
-        result.back().addr      = offset;
-        result.back().data_wr   = byte;
-        result.back().master_id = MASTER_ID;
-        result.back().op_type   = MemOperationType::WRITE;
-
-        offset++;
-    }
-
-    result.shrink_to_fit();
-    return result;
-}
-
 void InOutController::MainProcess() {
     static constexpr int DEBUG_MSG_LEVEL = 1;
 
@@ -181,16 +169,14 @@ void InOutController::MainProcess() {
         if (input_data_changed_) {
             DEBUG_OUT(DEBUG_MSG_LEVEL) << "Input data updated" << std::endl;
 
-            for (int i = 0; i < INPUT_COUNT; i++) {
-                input_data_requests.data.emplace_back();
-                input_data_requests.data.back().data_wr = data_inputs[i]->read() == true
-                                                        ? 0x01
-                                                        : 0x00;
-                input_data_requests.data.back().addr      = INPUTS_OFFSET + i;
-                input_data_requests.data.back().master_id = MASTER_ID;
-                input_data_requests.data.back().op_type   = MemOperationType::WRITE;
+            std::vector<uchar> pixels;
+            for (int i = 0; i < data_inputs.size(); i++) {
+                pixels.push_back(data_inputs[i]->read() == true ? 0x01 : 0x00);
             }
 
+            input_data_requests.data = BytesToWriteRequests(INPUTS_OFFSET, pixels,
+                                                            MASTER_ID);
+
             input_data_changed_ = false;
         }
 
@@ -198,8 +184,9 @@ void InOutController::MainProcess() {
         if (netz_data_changed_) {
             DEBUG_OUT(DEBUG_MSG_LEVEL) << "Netz data updated" << std::endl;
 
-            netz_data_requests.data = std::move(BytesToRequests(netz_data->read().Serialize(),
-                                                                NETZ_DATA_OFFSET));
+            netz_data_requests.data = BytesToWriteRequests(NetzDataOffset(input_count_),
+                                                           netz_data->read().Serialize(),
+                                                           MASTER_ID);
             netz_data_changed_ = false;
         }
 
@@ -240,7 +227,7 @@ void InOutController::MainProcess() {
                 requests->write(output_req);
                 if (new_reply_) {
                     const auto bytes = RepliesToBytes(replies->read().data);
-                    output_size = *(reinterpret_cast<const CentralDispatchUnit::size_type *>(bytes.data()));
+                    output_size = FromBytes<CentralDispatchUnit::size_type>(bytes.data());
                     new_reply_ = false;
                     break;
                 }
@@ -249,7 +236,7 @@ void InOutController::MainProcess() {
 
             output_req.data.clear();
 
-            output_req.data = ReadMemorySpanRequests(IO_OUTPUTS_BASE_ADDR + 1,
+            output_req.data = ReadMemorySpanRequests(IO_OUTPUTS_BASE_ADDR + sizeof(output_size),
                                                         sizeof(fp_t) * output_size,
                                                         MASTER_ID);
 
@@ -283,12 +270,18 @@ void InOutController::AtReply() {
     new_reply_ = true;
 }
 
-InOutController::InOutController(sc_core::sc_module_name const&) {
+config_int_t InOutController::InputCount() const {
+    return input_count_;
+}
+
+InOutController::InOutController(sc_core::sc_module_name const&, config_int_t input_count)
+    : input_count_(input_count)
+    , data_inputs("data_inputs", input_count) {
     SC_THREAD(MainProcess);
     sensitive << clk.pos();
 
     SC_METHOD(AtDataInputChange);
-    for (int i = 0; i < INPUT_COUNT; i++) sensitive << data_inputs[i];
+    for (const auto& input : data_inputs) sensitive << input;
 
     SC_METHOD(AtNetzDataChange);
     sensitive << netz_data;
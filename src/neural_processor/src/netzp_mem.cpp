@@ -8,6 +8,7 @@
 #include <iomanip>
 #include <ostream>
 #include <stdexcept>
+#include <string>
 
 namespace netzp {
 
@@ -17,18 +18,21 @@ MemReply::MemReply()
     : master_id(0)
     , op_type(MemOperationType::NONE)
     , status(MemOperationStatus::NONE)
-    , data(0) {}
+    , addr(0) {}
 
 MemReply::MemReply(const MemReply& other)
     : master_id(other.master_id)
     , op_type(other.op_type)
     , status(other.status)
-    , data(other.data) {}
+    , byte_en(other.byte_en)
+    , data(other.data)
+    , addr(other.addr) {}
 
 bool MemReply::operator == (const MemReply& other) const {
     return master_id == other.master_id
         && op_type   == other.op_type
         && status    == other.status
+        && byte_en   == other.byte_en
         && data      == other.data
         && addr      == other.addr;
 }
@@ -37,23 +41,40 @@ MemRequest::MemRequest()
     : master_id(0)
     , op_type(MemOperationType::NONE)
     , addr(0)
-    , data_wr(0) {}
+    , length(1) {}
 
 MemRequest::MemRequest(const MemRequest& other)
     : master_id(other.master_id)
     , op_type(other.op_type)
     , addr(other.addr)
+    , length(other.length)
+    , byte_en(other.byte_en)
     , data_wr(other.data_wr) {}
 
 bool MemRequest::operator == (const MemRequest& other) const {
     return master_id == other.master_id
         && op_type   == other.op_type
+        && length    == other.length
+        && byte_en   == other.byte_en
         && data_wr   == other.data_wr
         && addr      == other.addr;
 }
 
+template <typename Word>
+static std::ostream& PrintWords(std::ostream& out, const std::vector<Word>& words) {
+    out << "[";
+    for (size_t i = 0; i < words.size(); i++) {
+        out << (i ? " " : "") << words[i];
+    }
+
+    return out << "]";
+}
+
 std::ostream& operator << (std::ostream& out, const MemReply& reply) {
-    out << PRINTVAL(reply.data)      << std::endl
+    out << "reply.data = ";
+    PrintWords(out, reply.data)  << std::endl
+        << "reply.byte_en = ";
+    PrintWords(out, reply.byte_en) << std::endl
         << PRINTVAL(reply.addr)      << std::endl
         << PRINTVAL(reply.master_id) << std::endl
         << PRINTVAL(static_cast<int>(reply.op_type)) << std::endl
@@ -63,42 +84,93 @@ std::ostream& operator << (std::ostream& out, const MemReply& reply) {
 
 std::ostream& operator << (std::ostream& out, const MemRequest& req) {
     out << PRINTVAL(req.master_id) << std::endl
-        << PRINTVAL(req.data_wr)   << std::endl
+        << "req.data_wr = ";
+    PrintWords(out, req.data_wr) << std::endl
+        << "req.byte_en = ";
+    PrintWords(out, req.byte_en) << std::endl
         << PRINTVAL(req.addr)      << std::endl
+        << PRINTVAL(req.length)    << std::endl
         << PRINTVAL(static_cast<int>(req.op_type));
     return out;
 }
 
-std::vector<MemRequest> ReadMemorySpanRequests(mem_addr_t base_addr, size_t size,
-                                               mem_master_id_t master_id) {
+uchar WordByte(const mem_data_t& word, size_t lane) {
+    return static_cast<uchar>(word.range(8 * lane + 7, 8 * lane).to_uint());
+}
+
+void SetWordByte(mem_data_t& word, size_t lane, uchar byte) {
+    word.range(8 * lane + 7, 8 * lane) = static_cast<unsigned int>(byte);
+}
+
+// Lanes of the word at word_addr that fall into the byte span [base, end)
+static mem_byte_en_t SpanByteEnable(size_t word_addr, size_t base, size_t end) {
+    unsigned int byte_en = 0;
+    for (size_t lane = 0; lane < MEM_WORD_SIZE; lane++) {
+        const size_t byte_addr = word_addr * MEM_WORD_SIZE + lane;
+        if (byte_addr >= base && byte_addr < end) {
+            byte_en |= 1u << lane;
+        }
+    }
+
+    return byte_en;
+}
+
+// Covers the byte span [base, base + size) with bursts of whole words.
+// add_word(req, word_addr) is called for every word after its byte
+// enable is added.
+template <typename AddWord>
+static std::vector<MemRequest> SpanRequests(size_t base, size_t size,
+                                            mem_master_id_t master_id,
+                                            MemOperationType op_type,
+                                            AddWord add_word) {
+    const size_t end        = base + size;
+    const size_t first_word = base / MEM_WORD_SIZE;
+    const size_t end_word   = (end + MEM_WORD_SIZE - 1) / MEM_WORD_SIZE;
+
     std::vector<MemRequest> result;
-    for (mem_addr_t addr = base_addr; addr < (base_addr + size); addr++) {
+    for (size_t word = first_word; word < end_word; word += MAX_BURST_LENGTH) {
+        const size_t length = std::min<size_t>(end_word - word, MAX_BURST_LENGTH);
+
         auto& req     = result.emplace_back();
-        req.addr      = addr;
-        req.data_wr   = 0;
+        req.addr      = word;
+        req.length    = length;
         req.master_id = master_id;
-        req.op_type   = MemOperationType::READ;
+        req.op_type   = op_type;
+
+        for (size_t i = word; i < word + length; i++) {
+            req.byte_en.push_back(SpanByteEnable(i, base, end));
+            add_word(req, i);
+        }
     }
 
     result.shrink_to_fit();
     return result;
 }
 
+std::vector<MemRequest> ReadMemorySpanRequests(mem_addr_t base_addr, size_t size,
+                                               mem_master_id_t master_id) {
+    return SpanRequests(base_addr, size, master_id, MemOperationType::READ,
+                        [](MemRequest&, size_t) {});
+}
+
 std::vector<MemRequest> BytesToWriteRequests(mem_addr_t base_addr,
                                              const std::vector<uchar>& bytes,
                                              mem_master_id_t master_id) {
-    std::vector<MemRequest> result;
-    int i = 0;
-    for (mem_addr_t addr = base_addr; addr < (base_addr + bytes.size()); addr++, i++) {
-        auto &req     = result.emplace_back();
-        req.addr      = addr;
-        req.data_wr   = bytes[i];
-        req.master_id = master_id;
-        req.op_type   = MemOperationType::WRITE;
-    }
+    const size_t base = base_addr;
 
-    result.shrink_to_fit();
-    return result;
+    return SpanRequests(base, bytes.size(), master_id, MemOperationType::WRITE,
+                        [&](MemRequest& req, size_t word_addr) {
+        const unsigned int byte_en = req.byte_en.back().to_uint();
+
+        mem_data_t word = 0;
+        for (size_t lane = 0; lane < MEM_WORD_SIZE; lane++) {
+            if (byte_en & (1u << lane)) {
+                SetWordByte(word, lane, bytes[word_addr * MEM_WORD_SIZE + lane - base]);
+            }
+        }
+
+        req.data_wr.push_back(word);
+    });
 }
 
 std::vector<fp_t> BytesToFloatingPoints(const std::vector<uchar>& bytes) {
@@ -116,7 +188,15 @@ std::vector<fp_t> BytesToFloatingPoints(const std::vector<uchar>& bytes) {
 std::vector<uchar> RepliesToBytes(const std::vector<MemReply>& replies) {
     std::vector<uchar> bytes;
     for (const auto& reply : replies) {
-        bytes.push_back(static_cast<uchar>(reply.data.to_uint()));
+        for (size_t i = 0; i < reply.data.size(); i++) {
+            const unsigned int byte_en = reply.byte_en.at(i).to_uint();
+
+            for (size_t lane = 0; lane < MEM_WORD_SIZE; lane++) {
+                if (byte_en & (1u << lane)) {
+                    bytes.push_back(WordByte(reply.data[i], lane));
+                }
+            }
+        }
     }
 
     return bytes;
@@ -131,185 +211,244 @@ void Mem::AtClk() {
         ack_out->write(0);
         data_rd->write(0);
     } else if (clk.read()) {
-        if (r_en->read()) {
-            data_rd->write(data_rd_next_);
-        }
-        ack_out->write(ack_next_);
-    }
-}
+        const bool access = r_en->read() || w_en->read();
 
-void Mem::MemAccess() {
-    DEBUG_BEGIN_MODULE__;
-    data_rd_next_ = 0;
-    ack_next_     = 0;
-
-    if (addr.read() >= mem_.size()) {
-        throw std::invalid_argument(INDEX_OOB);
-    }
+        if (access && addr.read() >= mem_.size()) {
+            throw std::invalid_argument(INDEX_OOB);
+        }
 
-    if (r_en->read()) {
-        data_rd_next_ = mem_.at(addr->read());
-        ack_next_ = true;
-    } else if (w_en->read()) {
-        mem_[addr->read()] = data_wr;
-        ack_next_ = true;
-    }
-}
+        if (r_en->read()) {
+            data_rd->write(mem_[addr->read()]);
+        } else if (w_en->read()) {
+            const mem_data_t   word    = data_wr->read();
+            const unsigned int enabled = byte_en->read().to_uint();
+            mem_data_t&        target  = mem_[addr->read()];
+
+            for (size_t lane = 0; lane < MEM_WORD_SIZE; lane++) {
+                if (enabled & (1u << lane)) {
+                    SetWordByte(target, lane, WordByte(word, lane));
+                }
+            }
+        }
 
-void Mem::AtAck() {
-    DEBUG_BEGIN_MODULE__;
-    if (ack_in->read() == true) {
-        ack_next_ = false;
+        ack_out->write(access);
     }
 }
 
-void Mem::Dump(std::ostream& out) const {
-    DEBUG_BEGIN_MODULE__;
+void Mem::Dump(std::ostream& out, const sc_core::sc_vector<Mem>& banks) {
     int row_w = 32;
     int hex_group_w = 2;
 
-    for (int i = 0; i < mem_.size(); i += row_w) {
-        for (int j = 0; (j < row_w) && (i + j < mem_.size()); j += 1) {
+    size_t words = 0;
+    for (const Mem& bank : banks) {
+        words += bank.mem_.size();
+    }
+
+    const size_t bytes = words * MEM_WORD_SIZE;
+
+    for (size_t i = 0; i < bytes; i += row_w) {
+        for (size_t j = 0; (j < row_w) && (i + j < bytes); j += 1) {
             if (j % hex_group_w == 0 && j != 0) {
                 out << " ";
             }
+
+            const size_t byte_addr = i + j;
+            const size_t word_addr = byte_addr / MEM_WORD_SIZE;
+            const Mem&   bank      = banks[word_addr % banks.size()];
+
             out << std::hex << std::noshowbase << std::setfill('0') << std::setw(2)
-                << +static_cast<unsigned char>(mem_.at(i + j).to_uint());
+                << +WordByte(bank.mem_.at(word_addr / banks.size()), byte_addr % MEM_WORD_SIZE);
         }
         out << std::endl;
     }
 }
 
-Mem::Mem(sc_core::sc_module_name const &modname, int memsize) : mem_(memsize) {
+Mem::Mem(sc_core::sc_module_name const &modname, int memsize)
+    : mem_((memsize + MEM_WORD_SIZE - 1) / MEM_WORD_SIZE) {
     SC_METHOD(AtClk);
     sensitive << clk.pos();
+}
 
-    SC_METHOD(MemAccess);
-    sensitive << data_wr << addr << w_en << r_en;
+void MemController::StartBurst(size_t master) {
+    DEBUG_BEGIN_MODULE__;
+    static constexpr int DEBUG_MSG_LEVEL = 3;
+
+    Burst& burst  = bursts_[master];
+    burst.request = requests_in[master]->read();
+    served_[master] = burst.request;
+
+    DEBUG_OUT(DEBUG_MSG_LEVEL) << burst.request << std::endl;
 
-    SC_METHOD(AtAck);
-    sensitive << ack_in;
+    burst.reply           = MemReply();
+    burst.reply.addr      = burst.request.addr;
+    burst.reply.master_id = burst.request.master_id;
+    burst.reply.op_type   = burst.request.op_type;
+    burst.reply.byte_en   = burst.request.byte_en;
+    burst.reply.data.assign(burst.request.length, mem_data_t(0));
+
+    burst.issued = 0;
+    burst.acked  = 0;
+    burst.busy   = true;
 }
 
-void MemController::AtClk() {
-    if (rst->read()) {
-        for (int i = 0; i < MAX_CONNECTIONS; i++) {
-            access_granted[i]->write(false);
-            replies_out[i]->write(MemReply());
+// A bank acknowledges a word two clocks after it was presented, so the
+// next words are presented without waiting for the acknowledgements.
+void MemController::CollectAcks() {
+    for (size_t bank = 0; bank < bank_count_; bank++) {
+        if (!ack_in[bank]->read() || in_flight_[bank].empty()) {
+            continue;
         }
 
-        data_wr->write(0);
-        addr->write(0);
-        w_en->write(0);
-        r_en->write(0);
-        ack_out->write(0);
-    } else if (clk->read()) {
+        const auto [master, word] = in_flight_[bank].front();
+        in_flight_[bank].pop_front();
 
-        for (int i = 0; i < MAX_CONNECTIONS; i++) {
-            access_granted[i]->write(access_granted_next_[i]);
+        Burst& burst     = bursts_[master];
+        const bool read  = burst.request.op_type == MemOperationType::READ;
+
+        burst.reply.data.at(word) = read ? data_rd[bank]->read()
+                                         : burst.request.data_wr.at(word);
+        burst.acked++;
+    }
+}
+
+void MemController::IssueWords() {
+    std::vector<bool> taken(bank_count_, false);
+
+    for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+        const size_t master = (priority_ + i) % MAX_CONNECTIONS;
+        Burst&       burst  = bursts_[master];
+
+        if (!burst.busy || burst.issued == burst.request.length) {
+            continue;
+        }
+
+        const size_t word_addr = burst.request.addr + burst.issued;
+        const size_t bank      = word_addr % bank_count_;
+
+        if (taken[bank]) {
+            bank_conflicts_++;
+            continue;
         }
 
-        replies_out[current_access_.read()]->write(reply_next_);
+        const bool read = burst.request.op_type == MemOperationType::READ;
 
-        data_wr->write(data_wr_next_);
-        addr->write(addr_next_);
-        w_en->write(w_en_next_);
-        r_en->write(r_en_next_);
-        ack_out->write(ack_out_next_);
+        addr[bank]->write(word_addr / bank_count_);
+        data_wr[bank]->write(read ? mem_data_t(0) : burst.request.data_wr.at(burst.issued));
+        byte_en[bank]->write(burst.request.byte_en.at(burst.issued));
+        r_en[bank]->write(read);
+        w_en[bank]->write(!read);
 
-        // Internal counter
-        current_access_.write(current_access_next_);
+        in_flight_[bank].emplace_back(master, burst.issued);
+        burst.issued++;
+        taken[bank] = true;
     }
+
+    for (size_t bank = 0; bank < bank_count_; bank++) {
+        if (!taken[bank]) {
+            r_en[bank]->write(false);
+            w_en[bank]->write(false);
+        }
+    }
+
+    priority_ = (priority_ + 1) % MAX_CONNECTIONS;
 }
 
-void MemController::AtRequest() {
-    DEBUG_BEGIN_MODULE__;
+void MemController::FinishBursts() {
     static constexpr int DEBUG_MSG_LEVEL = 3;
 
-    addr_next_    = 0;
-    w_en_next_    = 0;
-    r_en_next_    = 0;
-    data_wr_next_ = 0;
-
-    if (access_granted[current_access_.read()]->read() == true) {
-        request_ = requests_in[current_access_.read()]->read();
-
-        DEBUG_OUT(DEBUG_MSG_LEVEL) << request_ << std::endl;
-        switch (request_.op_type) {
-            case netzp::MemOperationType::READ: {
-                addr_next_    = request_.addr;
-                w_en_next_    = 0;
-                r_en_next_    = 1;
-                data_wr_next_ = 0;
-                break;
-            }
-            case netzp::MemOperationType::WRITE: {
-                addr_next_    = request_.addr;
-                w_en_next_    = 1;
-                r_en_next_    = 0;
-                data_wr_next_ = request_.data_wr;
-                break;
-            }
-            case netzp::MemOperationType::NONE: {
-                /* nothing */
-            }
+    for (size_t master = 0; master < MAX_CONNECTIONS; master++) {
+        Burst& burst = bursts_[master];
+
+        if (burst.busy && burst.acked == burst.request.length) {
+            burst.reply.status = MemOperationStatus::OK;
+
+            DEBUG_OUT(DEBUG_MSG_LEVEL) << burst.reply << std::endl;
+
+            replies_out[master]->write(burst.reply);
+            burst.busy = false;
         }
     }
 }
 
-void MemController::AtAck() {
-    DEBUG_BEGIN_MODULE__;
-    static constexpr int DEBUG_MSG_LEVEL = 3;
+void MemController::AtClk() {
+    if (rst->read()) {
+        for (int i = 0; i < MAX_CONNECTIONS; i++) {
+            access_granted[i]->write(false);
+            replies_out[i]->write(MemReply());
+            served_[i] = MemRequest();
+            bursts_[i] = Burst();
+        }
 
-    if (ack_in->read() == true) {
-        if (request_.op_type == MemOperationType::READ) {
-            reply_next_.data = data_rd->read();
-        } else if (request_.op_type == MemOperationType::WRITE) {
-            reply_next_.data = request_.data_wr;
+        for (size_t bank = 0; bank < bank_count_; bank++) {
+            data_wr[bank]->write(0);
+            byte_en[bank]->write(0);
+            addr[bank]->write(0);
+            w_en[bank]->write(0);
+            r_en[bank]->write(0);
+            in_flight_[bank].clear();
         }
 
-        reply_next_.addr = request_.addr;
-        reply_next_.master_id = request_.master_id;
-        reply_next_.op_type = request_.op_type;
-        reply_next_.status = MemOperationStatus::OK;
+        priority_       = 0;
+        bank_conflicts_ = 0;
+    } else if (clk->read()) {
+        // Every master has its own path through the crossbar, so all
+        // the requesting ones are granted at once
+        for (int i = 0; i < MAX_CONNECTIONS; i++) {
+            access_granted[i]->write(access_request[i]->read());
+        }
 
-        DEBUG_OUT(DEBUG_MSG_LEVEL) << reply_next_ << std::endl;
+        for (int i = 0; i < MAX_CONNECTIONS; i++) {
+            if (bursts_[i].busy || !access_granted[i]->read()) {
+                continue;
+            }
 
-        ack_out_next_ = true;
-    } else if (ack_in.read() == false) {
-        ack_out_next_ = false;
-    }
-}
+            const MemRequest& request = requests_in[i]->read();
 
-void MemController::AtCounter() {
-    current_access_next_ = 0;
-
-    if (access_request[current_access_.read()]->read() == true) {
-        access_granted_next_[current_access_.read()] = true;
-    } else {
-        access_granted_next_[current_access_.read()] = false;
-        if (current_access_.read() == (MAX_CONNECTIONS - 1)) {
-            current_access_next_ = 0;
-        } else {
-            current_access_next_ = current_access_.read() + 1;
+            if (request.op_type != MemOperationType::NONE
+                    && !(request == served_[i])) {
+                StartBurst(i);
+            }
         }
+
+        CollectAcks();
+        IssueWords();
+        FinishBursts();
     }
 }
 
-MemController::MemController(sc_core::sc_module_name const&) {
-    SC_METHOD(AtClk);
-    sensitive << clk.pos();
+config_int_t MemController::BankCount() const {
+    return bank_count_;
+}
 
-    SC_METHOD(AtRequest);
-    for (const auto& request : requests_in) sensitive << request;
-    sensitive << current_access_;
+size_t MemController::BankConflicts() const {
+    return bank_conflicts_;
+}
 
-    SC_METHOD(AtAck);
-    sensitive << ack_in;
+MemController::MemController(sc_core::sc_module_name const&, config_int_t bank_count)
+    : bank_count_(bank_count)
+    , in_flight_(bank_count)
+    , data_wr("data_wr")
+    , byte_en("byte_en")
+    , addr("addr")
+    , w_en("w_en")
+    , r_en("r_en")
+    , ack_in("ack_in")
+    , data_rd("data_rd") {
+    if (bank_count == 0 || bank_count > CONFIG_MEMORY_MAX_BANK_COUNT) {
+        throw std::invalid_argument("Memory bank count must be from 1 to "
+            + std::to_string(CONFIG_MEMORY_MAX_BANK_COUNT));
+    }
 
-    SC_METHOD(AtCounter);
-    for (const auto& request : access_request) sensitive << request;
-    sensitive << current_access_;
+    data_wr.init(bank_count);
+    byte_en.init(bank_count);
+    addr.init(bank_count);
+    w_en.init(bank_count);
+    r_en.init(bank_count);
+    ack_in.init(bank_count);
+    data_rd.init(bank_count);
+
+    SC_METHOD(AtClk);
+    sensitive << clk.pos();
 }
 
 void MemIO::AtClk() {
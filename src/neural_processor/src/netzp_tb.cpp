@@ -1,8 +1,16 @@
 #include <algorithm>
+#include <cctype>
 #include <cstddef>
+#include <cerrno>
+#include <cstdlib>
 #include <fstream>
 #include <systemc>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include "netz_model_parser.hpp"
 #include "netzp_cdu.hpp"
 #include "netzp_config.hpp"
 #include "netzp_io.hpp"
@@ -27,73 +35,146 @@ void RunCycles(sc_core::sc_signal<bool>& clk, int cycles, sc_core::sc_time_unit
 enum {
     ARGV_IN_FILENAME = 1,
     ARGV_NETWORK_FILENAME = 2,
+    ARGV_OPTIONS = 3,
 };
 
-netzp::NetzwerkData ParseNetwork(std::istream& in) {
-    std::string line;
-    std::vector<std::vector<std::vector<double>>> weights;
-
-    int input_count = 0;
-    int layer = 0;
-    int neuron = 0;
-    while (std::getline(in, line)) {
-        if (line.empty()) continue; // Skip empty lines
-
-        if (line[0] == '>') {
-            std::string input_count_str = line.substr(1); // remove '>'
-            input_count = std::stoi(input_count_str);
-
-        } else if (line[0] == '@') {
-            // Parse the indices
-            std::string indices = line.substr(1); // Remove '@'
-            size_t delimiterPos = indices.find('/');
-            if (delimiterPos == std::string::npos) {
-                throw std::runtime_error("Invalid index format.");
-            }
+constexpr char OPT_CORES[] = "--cores";
+constexpr char OPT_BANKS[] = "--banks";
 
-            layer  = std::stoi(indices.substr(0, delimiterPos));
-            neuron = std::stoi(indices.substr(delimiterPos + 1));
+// Нейроны приходят в порядке файла и затем упорядочиваются по слоям и
+// номерам. Вычислительное ядро умеет только сигмоиду, так что строки с
+// другими функциями активации лишь отмечаются в отладочном выводе.
+// Число входов берется из дампа, а если его там нет - из конфигурации.
+struct NetworkCollector {
+    netzp::NetzwerkData netz_data;
+    size_t input_count = CONFIG_INPUT_PICTURE_WIDTH * CONFIG_INPUT_PICTURE_HEIGHT;
 
-            // Ensure the array is large enough
-            if (layer >= weights.size()) {
-                weights.resize(layer + 1);
-            }
+    void OnInputCount(size_t count) {
+        input_count = count;
+    }
 
-            if (neuron >= weights[layer].size()) {
-                weights[layer].resize(neuron + 1);
-            }
+    // Вычислительные ядра умеют только полносвязные слои
+    void OnConvolution(size_t layer, const netz::parser::Convolution&) {
+        throw std::runtime_error("Convolution layer " + std::to_string(layer)
+            + " is not supported by the processor.");
+    }
+
+    void OnActivation(size_t layer, std::string_view name) {
+        DEBUG_OUT(DEBUG_LEVEL_MSG) << "layer " << layer << " activation "
+            << name << " is not supported, sigma is used" << std::endl;
+    }
+
+    void OnNeuron(size_t layer, size_t neuron) {
+        auto& ndata = netz_data.neurons.emplace_back();
+        ndata.layer = layer;
+        ndata.neuron = neuron;
+    }
+
+    void OnWeight(double weight) {
+        auto& ndata = netz_data.neurons.back();
+        ndata.weights.push_back(static_cast<fp_t>(weight));
+        ndata.weights_count = ndata.weights.size();
+    }
+};
 
-        } else if (line[0] == '#') {
-            double value = std::stod(line.substr(1)); // Remove '#'
-            weights[layer][neuron].push_back(value);
+// widest_layer - число нейронов в самом широком слое, под него CDU
+// заводит буферы выходов
+netzp::NetzwerkData ParseNetwork(std::istream& in, size_t& input_count,
+                                 size_t& widest_layer) {
+    using count_type = netzp::NeuronData::count_type;
 
+    NetworkCollector collector;
+    netz::parser::ParseModel(in, collector);
+
+    netzp::NetzwerkData& netz_data = collector.netz_data;
+    input_count = collector.input_count;
+
+    // Счетчики в памяти процессора 16-битные
+    const size_t count_max = std::numeric_limits<count_type>::max();
+
+    if (netz_data.neurons.size() > count_max || input_count > count_max) {
+        throw std::runtime_error("Network is too large for the processor");
+    }
+
+    for (const auto& ndata : netz_data.neurons) {
+        if (ndata.weights.size() > count_max) {
+            throw std::runtime_error("Network is too large for the processor");
         }
     }
 
-    netzp::NetzwerkData netz_data;
+    std::stable_sort(netz_data.neurons.begin(), netz_data.neurons.end(),
+        [](const netzp::NeuronData& a, const netzp::NeuronData& b) {
+            return a.layer != b.layer ? a.layer < b.layer
+                                      : a.neuron < b.neuron;
+        });
+
+    netz_data.neurons_count = netz_data.neurons.size();
 
-    netz_data.neurons_count = 0;
-    for (const auto& l : weights) {
-        netz_data.neurons_count += l.size();
+    if (netz_data.neurons.empty()) {
+        throw std::runtime_error("The network has no neurons");
     }
 
-    for (layer = 0; layer < weights.size(); layer++) {
-        for (neuron = 0; neuron < weights.at(layer).size(); neuron++) {
-            auto& ndata = netz_data.neurons.emplace_back();
-            ndata.layer = layer;
-            ndata.neuron = neuron;
+    // Слои и нейроны в них идут без пропусков, у каждого нейрона по весу
+    // на выход предыдущего слоя: неполный (например, обрезанный) дамп не
+    // загружается
+    widest_layer = 0;
+    size_t layer = 0;
+    size_t layer_size = 0;
+    size_t previous_size = input_count;
+
+    for (size_t i = 0; i < netz_data.neurons.size(); i++) {
+        const netzp::NeuronData& ndata = netz_data.neurons[i];
+        const bool same_layer = i > 0
+            && ndata.layer == netz_data.neurons[i - 1].layer;
+
+        if (i > 0 && !same_layer) {
+            layer++;
+            previous_size = layer_size;
+        }
 
-            for (int weight = 0; weight < weights.at(layer).at(neuron).size(); weight++) {
-                ndata.weights.push_back(weights.at(layer).at(neuron).at(weight));
-            }
+        layer_size = same_layer ? layer_size + 1 : 1;
+        widest_layer = std::max(widest_layer, layer_size);
 
-            ndata.weights_count = ndata.weights.size();
+        if (ndata.layer != layer || ndata.neuron != layer_size - 1
+                || ndata.weights.size() != previous_size) {
+            throw std::runtime_error("The network is incomplete");
         }
     }
 
+    // Выходы сети CDU пишет в зарезервированную область памяти, за ней
+    // уже лежит картинка
+    using Io = netzp::InOutController;
+    const size_t max_outputs = (Io::IO_BASE_ADDR + Io::IO_SIZE
+        - Io::IO_OUTPUTS_BASE_ADDR - sizeof(count_type)) / sizeof(fp_t);
+
+    if (layer_size > max_outputs) {
+        throw std::runtime_error("The output layer has " + std::to_string(layer_size)
+            + " neurons, the processor supports at most " + std::to_string(max_outputs));
+    }
+
     return netz_data;
 }
 
+// Разбирает значение --cores/--banks: целое число от 1 до max_count.
+// Модули проверяют число сами, но их исключение при элаборации никто не
+// перехватывает, так что ошибка ловится здесь.
+bool ParseCount(const char *text, config_int_t max_count, config_int_t& count) {
+    if (!std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+
+    char *end = nullptr;
+    errno = 0;
+    const unsigned long value = std::strtoul(text, &end, 10);
+
+    if (errno != 0 || *end != '\0' || value == 0 || value > max_count) {
+        return false;
+    }
+
+    count = static_cast<config_int_t>(value);
+    return true;
+}
+
 int sc_main(int argc, char **argv) {
     using namespace sc_core;
     using namespace sc_dt;
@@ -102,10 +183,37 @@ int sc_main(int argc, char **argv) {
     const char *network_filename = argv[ARGV_NETWORK_FILENAME];
 
     if (argc < 3) {
-        std::cout << "Usage: ./netzp [input_file] [network_dump_file]" << std::endl;
+        std::cout << "Usage: ./netzp [input_file] [network_dump_file] "
+                     "[--cores count] [--banks count]" << std::endl;
         return 0;
     }
 
+    // Число вычислительных ядер и банков памяти задается при элаборации
+    config_int_t core_count = CONFIG_COMP_CORE_COUNT;
+    config_int_t bank_count = CONFIG_MEMORY_BANK_COUNT;
+
+    for (int i = ARGV_OPTIONS; i < argc; i++) {
+        using Cdu = netzp::CentralDispatchUnit;
+
+        if (std::string_view(argv[i]) == OPT_CORES && i + 1 < argc) {
+            if (!ParseCount(argv[++i], Cdu::MAX_NEURONS, core_count)) {
+                std::cout << "Core count must be from 1 to "
+                          << Cdu::MAX_NEURONS << ": " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (std::string_view(argv[i]) == OPT_BANKS && i + 1 < argc) {
+            if (!ParseCount(argv[++i], CONFIG_MEMORY_MAX_BANK_COUNT, bank_count)) {
+                std::cout << "Memory bank count must be from 1 to "
+                          << CONFIG_MEMORY_MAX_BANK_COUNT << ": " << argv[i]
+                          << std::endl;
+                return 1;
+            }
+        } else {
+            std::cout << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
     std::ifstream inputs_file(input_filename);
     if (!inputs_file) {
         std::cout << "No such file: " << input_filename << std::endl;
@@ -118,16 +226,24 @@ int sc_main(int argc, char **argv) {
         return 1;
     }
 
-    netzp::NetzwerkData nd = ParseNetwork(network_file);
+    size_t input_count = 0;
+    size_t widest_layer = 0;
+    netzp::NetzwerkData nd;
+
+    try {
+        nd = ParseNetwork(network_file, input_count, widest_layer);
+    } catch (const std::exception& e) {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+
     DEBUG_OUT(1) << nd << std::endl;
 
-    sc_signal<netzp::mem_data_t> data_rd(0);
-    sc_signal<netzp::mem_data_t> data_wr(0);
-    sc_signal<netzp::mem_addr_t> addr(0);
-    sc_signal<bool>              w_en(0);
-    sc_signal<bool>              r_en(0);
-    sc_signal<bool>              ack_mem_to_con(0);
-    sc_signal<bool>              ack_con_to_mem(0);
+    // Память вмещает зарезервированную область, картинку по байту на
+    // пиксель и сеть, с запасом до целого килобайта
+    const size_t memory_size = netzp::InOutController::NetzDataOffset(input_count)
+                             + nd.Serialize().size();
+    const size_t memory_kbytes = (memory_size + netzp::KBYTE - 1) / netzp::KBYTE;
 
     const size_t port_count = CONFIG_MEMORY_CONTROLLER_MAX_CONNECTIONS;
 
@@ -150,14 +266,20 @@ int sc_main(int argc, char **argv) {
 
 
     sc_signal<netzp::NetzwerkData> netz_data;
-    sc_vector<sc_signal<bool>> input_signals("inputs", netzp::InOutController::INPUT_COUNT);
-    for (int i = 0; i < input_signals.size() && !inputs_file.eof(); i++) {
-        char c;
-        inputs_file >> c;
-        input_signals[i].write((c == '1' ? true : false));
+    sc_vector<sc_signal<bool>> input_signals("inputs", input_count);
+    size_t pixels_read = 0;
+    for (char c; pixels_read < input_signals.size() && inputs_file >> c;) {
+        if (c == '0' || c == '1') {
+            input_signals[pixels_read++].write(c == '1');
+        }
+    }
+
+    if (pixels_read < input_count) {
+        std::cout << "Warning, input size is " << pixels_read << ", the network expects "
+                  << input_count << std::endl;
     }
 
-    netzp::CentralDispatchUnit cdu("cdu");
+    netzp::CentralDispatchUnit cdu("cdu", input_count, core_count, widest_layer);
 
     cdu.clk(clk);
     cdu.rst(rst);
@@ -166,20 +288,7 @@ int sc_main(int argc, char **argv) {
     cdu.start(cdu_start);
     cdu.finished(cdu_finished);
 
-    netzp::Mem memory("memory", 10 * netzp::KBYTE);
-
-    memory.clk(clk);
-    memory.rst(rst);
-
-    memory.ack_in(ack_con_to_mem);
-    memory.ack_out(ack_mem_to_con);
-    memory.data_rd(data_rd);
-    memory.data_wr(data_wr);
-    memory.addr(addr);
-    memory.w_en(w_en);
-    memory.r_en(r_en);
-
-    netzp::MemController bus("Membus");
+    netzp::MemController bus("Membus", bank_count);
 
     bus.clk(clk);
     bus.rst(rst);
@@ -191,13 +300,44 @@ int sc_main(int argc, char **argv) {
         bus.replies_out[i](reply[i]);
     }
 
-    bus.ack_in(ack_mem_to_con);
-    bus.ack_out(ack_con_to_mem);
-    bus.data_rd(data_rd);
-    bus.data_wr(data_wr);
-    bus.addr(addr);
-    bus.w_en(w_en);
-    bus.r_en(r_en);
+    // Слова памяти чередуются по банкам, каждому достается равная доля
+    const size_t memory_words = std::max<size_t>(memory_kbytes, 10) * netzp::KBYTE
+                              / netzp::MEM_WORD_SIZE;
+    const size_t bank_words = (memory_words + bank_count - 1) / bank_count;
+
+    sc_vector<sc_signal<netzp::mem_data_t>>    data_rd("data_rd", bank_count);
+    sc_vector<sc_signal<netzp::mem_data_t>>    data_wr("data_wr", bank_count);
+    sc_vector<sc_signal<netzp::mem_byte_en_t>> byte_en("byte_en", bank_count);
+    sc_vector<sc_signal<netzp::mem_addr_t>>    addr("addr", bank_count);
+    sc_vector<sc_signal<bool>>                 w_en("w_en", bank_count);
+    sc_vector<sc_signal<bool>>                 r_en("r_en", bank_count);
+    sc_vector<sc_signal<bool>>                 ack_mem_to_con("ack_mem_to_con", bank_count);
+
+    sc_vector<netzp::Mem> memory("memory");
+    memory.init(bank_count, [&](const char *name, size_t) {
+        return new netzp::Mem(name, bank_words * netzp::MEM_WORD_SIZE);
+    });
+
+    for (int i = 0; i < bank_count; i++) {
+        memory[i].clk(clk);
+        memory[i].rst(rst);
+
+        memory[i].ack_out(ack_mem_to_con[i]);
+        memory[i].data_rd(data_rd[i]);
+        memory[i].data_wr(data_wr[i]);
+        memory[i].byte_en(byte_en[i]);
+        memory[i].addr(addr[i]);
+        memory[i].w_en(w_en[i]);
+        memory[i].r_en(r_en[i]);
+
+        bus.ack_in[i](ack_mem_to_con[i]);
+        bus.data_rd[i](data_rd[i]);
+        bus.data_wr[i](data_wr[i]);
+        bus.byte_en[i](byte_en[i]);
+        bus.addr[i](addr[i]);
+        bus.w_en[i](w_en[i]);
+        bus.r_en[i](r_en[i]);
+    }
 
     netzp::MemIO iocon_memio("iocon_memio");
 
@@ -223,13 +363,13 @@ int sc_main(int argc, char **argv) {
     cdu_memio.access_request(access_request[1]);
     cdu_memio.access_granted(access_granted[1]);
 
-    netzp::InOutController iocon("iocon");
+    netzp::InOutController iocon("iocon", input_count);
 
     iocon.clk(clk);
     iocon.rst(rst);
 
     iocon.netz_data(netz_data);
-    for (int i = 0; i < netzp::InOutController::INPUT_COUNT; i++) {
+    for (int i = 0; i < input_count; i++) {
         iocon.data_inputs[i](input_signals[i]);
     }
 
@@ -251,18 +391,22 @@ int sc_main(int argc, char **argv) {
         RunCycles(clk, 1, SC_NS);
     }
 
+    const unsigned long long cdu_start_cycle = TOTAL_CYCLE_COUNT;
+
     cdu_start.write(true);
     while (cdu_finished.read() == false) {
         RunCycles(clk, 1, SC_NS);
     }
 
+    const unsigned long long cdu_cycles = TOTAL_CYCLE_COUNT - cdu_start_cycle;
+
     io_got_output.write(true);
     while (io_finished_reading.read() == false) {
         RunCycles(clk, 1, SC_NS);
     }
 
     DEBUG_OUT(1) << "Memory dump: " << std::endl;
-    memory.Dump(std::cout);
+    netzp::Mem::Dump(std::cout, memory);
 
     auto outputs = io_outputs.read().data;
 
@@ -275,6 +419,23 @@ int sc_main(int argc, char **argv) {
     if ((iter - outputs.begin()) == 1) std::cout << "It's a square" << std::endl;
     if ((iter - outputs.begin()) == 2) std::cout << "It's a triangle" << std::endl;
 
+    std::cout << "INPUT COUNT: " << std::dec << input_count << std::endl;
+    std::cout << "CORE COUNT: " << std::dec << cdu.CoreCount() << std::endl;
+    std::cout << "MEMORY WORD SIZE: " << netzp::MEM_WORD_SIZE << std::endl;
+    std::cout << "MEMORY BANKS: " << bus.BankCount() << std::endl;
+    std::cout << "MEMORY BANK CONFLICTS: " << bus.BankConflicts() << std::endl;
+
+    // Сколько тактов CDU ждал память и какую их часть ядра считали
+    // одновременно с этим
+    const size_t memory_cycles = cdu.MemoryCycles();
+    const size_t overlapped_cycles = cdu.OverlappedMemoryCycles();
+
+    std::cout << "CDU CLOCK CYCLES: " << cdu_cycles << std::endl;
+    std::cout << "CDU MEMORY CYCLES: " << memory_cycles << std::endl;
+    std::cout << "CDU MEMORY CYCLES OVERLAPPED WITH CORES: " << overlapped_cycles
+              << " (" << (memory_cycles ? 100 * overlapped_cycles / memory_cycles : 0)
+              << "%)" << std::endl;
+    std::cout << "CDU PREFETCH STALL CYCLES: " << cdu.PrefetchStallCycles() << std::endl;
     std::cout << "TOTAL CLOCK CYCLES: " << std::dec << TOTAL_CYCLE_COUNT << std::endl;
 
     return 0;
@@ -0,0 +1,60 @@
+#!/bin/sh
+# Runs the testbench with different numbers of computational cores and
+# prints the total clock cycles for every count. The outputs of every run
+# are compared with the single-core run, a mismatch means a dispatch bug.
+#
+# Usage: ./sweep_cores.sh [input_file] [network_dump_file]
+# The core counts are taken from CORES (1 2 4 8 16 32 64 by default),
+# the testbench binary from NETZP (./netzp by default).
+
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 [input_file] [network_dump_file]" >&2
+    exit 1
+fi
+
+NETZP=${NETZP:-./netzp}
+CORES=${CORES:-"1 2 4 8 16 32 64"}
+
+reference=""
+base_cores=""
+base_cycles=""
+status=0
+
+printf "%6s %12s %8s\n" "cores" "cycles" "speedup"
+
+for cores in $CORES; do
+    # A failing run is reported and skipped instead of silently ending
+    # the sweep through set -e
+    if log=$("$NETZP" "$1" "$2" --cores "$cores" 2>/dev/null); then
+        :
+    else
+        run_status=$?
+        printf "%6s %12s %8s  run failed (status %s)\n" "$cores" "-" "-" \
+            "$run_status"
+        printf "%s\n" "$log" | sed 's/^/       /'
+        status=1
+        continue
+    fi
+
+    cycles=$(printf "%s\n" "$log" | sed -n 's/^TOTAL CLOCK CYCLES: //p')
+    outputs=$(printf "%s\n" "$log" | grep '^outputs\[')
+
+    if [ -z "$reference" ]; then
+        reference=$outputs
+        base_cores=$cores
+        base_cycles=$cycles
+    fi
+
+    note=""
+    if [ "$outputs" != "$reference" ]; then
+        note="  outputs differ from the run with $base_cores core(s)"
+        status=1
+    fi
+
+    printf "%6s %12s %8s%s\n" "$cores" "$cycles" \
+        "$(awk "BEGIN { printf \"%.2f\", $base_cycles / $cycles }")" "$note"
+done
+
+exit $status